@@ -0,0 +1,400 @@
+//--------------------------------------------------------------------------------------------------------------------------//
+// Offline benchmark of the human detector (no windows).
+//
+// Build: g++ -O2 -std=c++11 Detector_benchmark.cpp -o Detector_benchmark `pkg-config --cflags --libs opencv`
+// Usage: ./Detector_benchmark [-json <results.json>] [-lut <file>] [-warmup <frames>] [-track <frames>[,<margin>]]
+//                             [-scale <factor>] [-recall <factor>,<factor>,...] [-integral] [-alloc] <inputs...>
+//
+// Inputs are image files, directories of images (e.g. ../../Test_images) or video files. Every frame goes through
+// HumanDetector::Detect; the time of every step (cvtColor, threshold, findContours, approxPolyDP, GetSkin) is
+// recorded per frame and reported as mean and percentiles, together with the frame rate. -json also writes the
+// results to a file, so that runs of different builds can be compared. -track runs HumanTracker instead (full scan
+// every <frames> frames, see Detector_tracker.h) and also reports how many frames took the fast path. -scale searches
+// the candidates on the downscaled frame (see HumanDetector::SetScale); -recall compares the given scales with full
+// resolution on the first frames: time per frame and how many of the full resolution detections are still found.
+// -integral takes the skin percentages of overlapping candidates from SkinIntegral (see Skin_integral.h).
+//
+// Heap allocations are counted by replacing operator new, so they include every std::vector and every other C++
+// allocation made by the detector and by OpenCV; OpenCV allocates Mat data with fastMalloc, which is not counted here.
+// -alloc compares a new detector per frame with one reused detector on the first frames.
+//--------------------------------------------------------------------------------------------------------------------------//
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "Human_detector.h"
+#include "Detector_tracker.h"
+
+using namespace std;
+using namespace cv;
+
+static atomic<long> allocations(0);
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: StepSamples
+//Input: Step name
+//Output: Per-frame times of one step, with mean and percentiles.
+//--------------------------------------------------------------------------------------------------------------------------//
+struct StepSamples {
+    explicit StepSamples(string const &name) : name(name) {}
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Percentile
+    //Input: 0-100
+    //Output: Milliseconds (nearest rank)
+    //----------------------------------------------------------------------------------------------------------------------//
+    double Percentile(double p) const {
+        if (sorted.empty())
+            return 0;
+        size_t rank = (size_t)(p/100*sorted.size() + 0.5);
+        return sorted[min(max(rank, (size_t)1), sorted.size()) - 1]*1e3;
+    }
+
+    double Mean() const {
+        double sum = 0;
+        for (size_t i = 0; i < sorted.size(); i++)
+            sum += sorted[i];
+        return sorted.empty() ? 0 : sum/sorted.size()*1e3;
+    }
+
+    void Sort() { sorted = seconds; sort(sorted.begin(), sorted.end()); }
+
+    string name;
+    vector<double> seconds, sorted;
+};
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: Inputs
+//Input: Command line inputs
+//Output: Image and video files; directories are replaced by their files (sorted).
+//--------------------------------------------------------------------------------------------------------------------------//
+vector<string> Inputs(vector<string> const &args) {
+    vector<string> files;
+    for (size_t a = 0; a < args.size(); a++) {
+        vector<string> found;
+        try {
+            glob(args[a] + "/*", found, false);
+        } catch (cv::Exception const &) { // not a directory
+            found.clear();
+        }
+        if (found.empty())
+            files.push_back(args[a]);
+        else {
+            sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        }
+    }
+    return files;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: ForEachFrame
+//Input: Files, f(frame, decode seconds) for every image and every frame of every video
+//Output: Number of frames (files that are neither are reported and skipped).
+//--------------------------------------------------------------------------------------------------------------------------//
+template<class F>
+int ForEachFrame(vector<string> const &files, F f) {
+    int frames = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        double t = (double)getTickCount();
+        Mat img = imread(files[i]);
+        if (!img.empty()) {
+            f(img, ((double)getTickCount() - t)/getTickFrequency());
+            frames++;
+            continue;
+        }
+        VideoCapture cap(files[i]);
+        int before = frames;
+        for (t = (double)getTickCount(); cap.isOpened() && cap.read(img) && !img.empty(); t = (double)getTickCount()) {
+            f(img, ((double)getTickCount() - t)/getTickFrequency());
+            frames++;
+        }
+        if (frames == before)
+            cerr << "Skipped " << files[i] << " (not an image or video)" << endl;
+    }
+    return frames;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: CompareAllocations
+//Input: Files
+//Output: Allocations and time per frame with a new detector per frame and with one detector, on up to 30 frames.
+//--------------------------------------------------------------------------------------------------------------------------//
+void CompareAllocations(vector<string> const &files) {
+    vector<Mat> frames;
+    ForEachFrame(files, [&](Mat const &frame, double) {
+        if (frames.size() < 30)
+            frames.push_back(frame.clone());
+    });
+    if (frames.empty())
+        return;
+    HumanDetector reused;
+    Mat debugMask;
+    for (int variant = 0; variant < 3; variant++) {
+        size_t found = 0;
+        long before = 0;
+        double t = 0;
+        for (int pass = 0; pass < 2; pass++) { // the first pass is the warm-up
+            before = allocations;
+            t = (double)getTickCount();
+            found = 0;
+            for (size_t f = 0; f < frames.size(); f++) {
+                if (variant == 0) {
+                    HumanDetector detector;
+                    found += detector.Detect(frames[f]).size();
+                }
+                else
+                    found += reused.Detect(frames[f], variant == 2 ? &debugMask : 0).size();
+            }
+        }
+        double ms = ((double)getTickCount() - t)*1000/getTickFrequency()/frames.size();
+        static const char *names[] = { "new HumanDetector every frame", "one HumanDetector", "one HumanDetector, debug mask" };
+        printf("%-32s %8.1f allocations/frame %8.2f ms/frame  (%d detections)\n", names[variant],
+               (double)(allocations - before)/frames.size(), ms, (int)found);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: CompareScales
+//Input: Files, search scales
+//Output: For every scale, on up to 30 frames: time per frame, speedup, recall (full resolution detections overlapped
+//        by a detection at that scale with intersection over union >= 0.5) and precision (the other way round).
+//--------------------------------------------------------------------------------------------------------------------------//
+void CompareScales(vector<string> const &files, vector<double> const &scales) {
+    vector<Mat> frames;
+    ForEachFrame(files, [&](Mat const &frame, double) {
+        if (frames.size() < 30)
+            frames.push_back(frame.clone());
+    });
+    if (frames.empty())
+        return;
+    vector<vector<Detection> > reference;
+    double referenceMs = 0;
+    printf("%-7s %10s %8s %8s %10s %11s\n", "scale", "ms/frame", "speedup", "recall", "precision", "detections");
+    for (int s = -1; s < (int)scales.size(); s++) {
+        double scale = s < 0 ? 1 : scales[s];
+        HumanDetector detector;
+        detector.SetScale(scale);
+        detector.Detect(frames[0]); // warm-up
+        double t = (double)getTickCount();
+        vector<vector<Detection> > found(frames.size());
+        for (size_t f = 0; f < frames.size(); f++)
+            found[f] = detector.Detect(frames[f]);
+        double ms = ((double)getTickCount() - t)*1000/getTickFrequency()/frames.size();
+        if (s < 0)
+            referenceMs = ms;
+        int total = 0, matched = 0, detections = 0, correct = 0;
+        for (size_t f = 0; f < frames.size(); f++) {
+            vector<Detection> const &a = s < 0 ? found[f] : reference[f], &b = found[f];
+            for (int pass = 0; pass < 2; pass++) {
+                vector<Detection> const &from = pass ? b : a, &to = pass ? a : b;
+                for (size_t i = 0; i < from.size(); i++) {
+                    bool hit = false;
+                    for (size_t j = 0; j < to.size() && !hit; j++) {
+                        double overlap = (from[i].rect & to[j].rect).area();
+                        hit = overlap >= 0.5*(from[i].rect.area() + to[j].rect.area() - overlap);
+                    }
+                    (pass ? correct : matched) += hit;
+                }
+                (pass ? detections : total) += (int)from.size();
+            }
+        }
+        printf("%-7.3g %10.2f %7.2fx %7.1f%% %9.1f%% %11d\n", scale, ms, referenceMs/ms,
+               total ? 100.0*matched/total : 100.0, detections ? 100.0*correct/detections : 100.0, detections);
+        if (s < 0)
+            reference.swap(found);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: JsonString
+//Input: Text
+//Output: Quoted JSON string
+//--------------------------------------------------------------------------------------------------------------------------//
+string JsonString(string const &s) {
+    string out = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = s[i];
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if ((unsigned char)c < 0x20) {
+            char buf[8];
+            sprintf(buf, "\\u%04x", (unsigned char)c);
+            out += buf;
+        }
+        else
+            out += c;
+    }
+    return out + "\"";
+}
+
+int main(int argc, const char * argv[]) {
+    string json;
+    int warmup = 1;
+    bool alloc = false, track = false, skinIntegral = false;
+    HumanTracker::Config trackConfig;
+    double scale = 1;
+    vector<double> recallScales;
+    vector<string> args;
+    for (int a = 1; a < argc; a++) {
+        string arg(argv[a]);
+        if (arg == "-json" && a + 1 < argc)
+            json = argv[++a];
+        else if (arg == "-lut" && a + 1 < argc) {
+            SkinLut &lut = SharedSkinLut();
+            if (!lut.Load(argv[++a])) {
+                SkinKernel kernel;
+                lut.Build(kernel);
+                lut.Save(argv[a]);
+            }
+        }
+        else if (arg == "-warmup" && a + 1 < argc)
+            warmup = atoi(argv[++a]);
+        else if (arg == "-track" && a + 1 < argc) {
+            sscanf(argv[++a], "%d,%d", &trackConfig.fullScanInterval, &trackConfig.searchMargin);
+            track = true;
+        }
+        else if (arg == "-scale" && a + 1 < argc)
+            scale = atof(argv[++a]);
+        else if (arg == "-recall" && a + 1 < argc) {
+            stringstream list(argv[++a]);
+            for (string item; getline(list, item, ',');)
+                recallScales.push_back(atof(item.c_str()));
+        }
+        else if (arg == "-integral")
+            skinIntegral = true;
+        else if (arg == "-alloc")
+            alloc = true;
+        else
+            args.push_back(arg);
+    }
+    vector<string> files = Inputs(args);
+    if (files.empty()) {
+        cout << "Usage: Detector_benchmark [-json <results.json>] [-lut <file>] [-warmup <frames>] "
+             << "[-track <frames>[,<margin>]] [-scale <factor>] [-recall <factor>,...] [-integral] [-alloc] "
+             << "<inputs...>"
+             << endl;
+        return 1;
+    }
+
+    vector<StepSamples> steps;
+    const char *names[] = { "decode", "resize", "cvtColor", "threshold", "findContours", "approxPolyDP", "GetSkin",
+                            "total" };
+    for (int s = 0; s < 8; s++)
+        steps.push_back(StepSamples(names[s]));
+    HumanDetector detector;
+    HumanTracker tracker(trackConfig);
+    detector.SetScale(scale);
+    tracker.Detector().SetScale(scale);
+    detector.UseSkinIntegral(skinIntegral);
+    tracker.Detector().UseSkinIntegral(skinIntegral);
+    long candidates = 0, detections = 0, steadyAllocations = 0;
+    double pixels = 0, detectSeconds = 0, wallSeconds = 0;
+    int measured = 0, seen = 0, fastFrames = 0;
+    ForEachFrame(files, [&](Mat const &frame, double decode) {
+        long before = allocations;
+        double t = (double)getTickCount();
+        size_t found = track ? tracker.Process(frame).size() : detector.Detect(frame).size();
+        double total = ((double)getTickCount() - t)/getTickFrequency();
+        if (seen++ < warmup)
+            return;
+        DetectorTimes const &times = track ? tracker.Times() : detector.Times();
+        double sample[] = { decode, times.resize, times.cvtColor, times.threshold, times.findContours, times.approxPolyDP,
+                            times.getSkin, total };
+        for (int s = 0; s < 8; s++)
+            steps[s].seconds.push_back(sample[s]);
+        steadyAllocations += allocations - before;
+        candidates += (track ? tracker.Detector() : detector).Candidates().size(); // of the last full scan when tracking
+        fastFrames += track && tracker.FastPath();
+        detections += found;
+        pixels += frame.total();
+        detectSeconds += total;
+        wallSeconds += decode + total;
+        measured++;
+    });
+    if (measured == 0) {
+        cout << "No frames after the " << warmup << " warm-up frame(s)" << endl;
+        return 1;
+    }
+
+    double fps = measured/detectSeconds;
+    printf("%d frames (%.2f Mpixel/frame) after %d warm-up, %.1f fps detection, %.1f fps with decoding\n", measured,
+           pixels/measured/1e6, warmup, fps, measured/wallSeconds);
+    printf("%.1f candidates, %.2f detections, %.1f allocations per frame; skin kernel %s%s\n",
+           (double)candidates/measured, (double)detections/measured, (double)steadyAllocations/measured,
+           SkinKernel::HaveAvx2() ? "AVX2" : "scalar", SharedSkinLut().Empty() ? "" : " + colour table");
+    if (scale < 1)
+        printf("Candidates searched at scale %g (%.2f Mpixel)\n", scale, pixels/measured/1e6*scale*scale);
+    if (skinIntegral) {
+        SkinIntegral const &integral = (track ? tracker.Detector() : detector).Integral();
+        printf("Skin integral image: %ld of %ld grouped ROIs answered without a pixel loop\n", integral.Constant(),
+               integral.Queries());
+    }
+    if (track)
+        printf("Tracking: full scan every %d frames, %d of %d frames (%.1f%%) by tracking only, %d tracks lost\n",
+               trackConfig.fullScanInterval, fastFrames, measured, 100.0*fastFrames/measured, tracker.LostTracks());
+    printf("%-13s %9s %9s %9s %9s %9s  (ms)\n", "step", "mean", "p50", "p90", "p99", "max");
+    for (size_t s = 0; s < steps.size(); s++) {
+        steps[s].Sort();
+        printf("%-13s %9.3f %9.3f %9.3f %9.3f %9.3f\n", steps[s].name.c_str(), steps[s].Mean(),
+               steps[s].Percentile(50), steps[s].Percentile(90), steps[s].Percentile(99), steps[s].Percentile(100));
+    }
+
+    if (!json.empty()) {
+        ofstream out(json.c_str());
+        time_t now = time(0);
+        char date[32];
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+        out << "{\n  \"date\": " << JsonString(date) << ",\n  \"build\": " << JsonString(__DATE__ " " __TIME__)
+            << ",\n  \"compiler\": " << JsonString(__VERSION__) << ",\n  \"opencv\": " << JsonString(CV_VERSION)
+            << ",\n  \"avx2\": " << (SkinKernel::HaveAvx2() ? "true" : "false")
+            << ",\n  \"skin_lut\": " << (SharedSkinLut().Empty() ? "false" : "true")
+            << ",\n  \"skin_integral\": " << (skinIntegral ? "true" : "false") << ",\n  \"inputs\": [";
+        for (size_t a = 0; a < args.size(); a++)
+            out << (a ? ", " : "") << JsonString(args[a]);
+        out << "],\n  \"frames\": " << measured << ",\n  \"warmup_frames\": " << warmup
+            << ",\n  \"megapixels_per_frame\": " << pixels/measured/1e6 << ",\n  \"fps\": " << fps
+            << ",\n  \"fps_with_decode\": " << measured/wallSeconds
+            << ",\n  \"candidates_per_frame\": " << (double)candidates/measured
+            << ",\n  \"detections_per_frame\": " << (double)detections/measured
+            << ",\n  \"allocations_per_frame\": " << (double)steadyAllocations/measured << ",\n  \"scale\": " << scale;
+        if (track)
+            out << ",\n  \"full_scan_interval\": " << trackConfig.fullScanInterval << ",\n  \"search_margin\": "
+                << trackConfig.searchMargin << ",\n  \"fast_path_frames\": " << fastFrames;
+        out << ",\n  \"steps_ms\": {";
+        for (size_t s = 0; s < steps.size(); s++)
+            out << (s ? "," : "") << "\n    " << JsonString(steps[s].name) << ": {\"mean\": " << steps[s].Mean()
+                << ", \"p50\": " << steps[s].Percentile(50) << ", \"p90\": " << steps[s].Percentile(90)
+                << ", \"p99\": " << steps[s].Percentile(99) << ", \"max\": " << steps[s].Percentile(100) << "}";
+        out << "\n  }\n}\n";
+        if (!out.flush()) {
+            cout << "Could not write " << json << endl;
+            return 1;
+        }
+        cout << "Results written to " << json << endl;
+    }
+
+    if (!recallScales.empty())
+        CompareScales(files, recallScales);
+    if (alloc)
+        CompareAllocations(files);
+    return 0;
+}
@@ -0,0 +1,314 @@
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "Human_detector.h"
+
+using namespace std;
+using namespace cv;
+
+//--------------------------------------------------------------------------------------------------------------------------//
+// Pipelined video processing for the human detector.
+//
+//   decode -> preprocess -> contours -> skin -> (caller, in frame order)
+//
+// Every stage runs on its own thread(s) and hands frames to the next one through a bounded queue, so a slow stage
+// makes the earlier ones wait instead of filling the memory with frames. Preprocess, contours and skin may have
+// several threads each (frames then overtake each other and are put back in order at the end); the skin stage
+// also checks the ROIs of one frame in parallel (SkinCheck, OpenCV's threads). Every stage counts frames, time spent
+// working and latency since decoding, see PrintStats.
+//--------------------------------------------------------------------------------------------------------------------------//
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: BoundedQueue
+//Input: Capacity
+//Output: Blocking FIFO between two stages. Close() ends it: Pop then fails once it is empty.
+//--------------------------------------------------------------------------------------------------------------------------//
+template<class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Push
+    //Input: Item
+    //Output: (true/false) whether the item was queued (waits while the queue is full, false once closed).
+    //----------------------------------------------------------------------------------------------------------------------//
+    bool Push(T const &item) {
+        unique_lock<mutex> lock(m);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+        items.push_back(item);
+        notEmpty.notify_one();
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Pop
+    //Input: Item output
+    //Output: (true/false) whether an item was taken (waits while the queue is empty, false once closed and empty).
+    //----------------------------------------------------------------------------------------------------------------------//
+    bool Pop(T &item) {
+        unique_lock<mutex> lock(m);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = items.front();
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Close
+    //Input: -
+    //Output: No more items are accepted; waiting threads wake up.
+    //----------------------------------------------------------------------------------------------------------------------//
+    void Close() {
+        lock_guard<mutex> lock(m);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    size_t capacity;
+    bool closed;
+    deque<T> items;
+    mutex m;
+    condition_variable notEmpty, notFull;
+};
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: StageStats
+//Input: Stage name
+//Output: Frame count, working time and latency of one stage (thread safe).
+//--------------------------------------------------------------------------------------------------------------------------//
+class StageStats {
+public:
+    explicit StageStats(string const &name) : name(name), frames(0), busy(0), maxBusy(0), latency(0), maxLatency(0) {}
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Add
+    //Input: Seconds spent working on a frame, seconds from decoding the frame to leaving this stage
+    //Output: -
+    //----------------------------------------------------------------------------------------------------------------------//
+    void Add(double seconds, double sinceDecode) {
+        lock_guard<mutex> lock(m);
+        frames++;
+        busy += seconds;
+        maxBusy = max(maxBusy, seconds);
+        latency += sinceDecode;
+        maxLatency = max(maxLatency, sinceDecode);
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Print
+    //Input: Wall clock seconds of the run
+    //Output: One line: frames, frames/s, mean/max work per frame, mean/max latency, thread utilisation.
+    //----------------------------------------------------------------------------------------------------------------------//
+    void Print(double wall, int threads) const {
+        lock_guard<mutex> lock(m);
+        double n = frames ? frames : 1;
+        printf("%-10s %6d frames %7.1f fps  work %7.2f ms (max %7.2f)  latency %7.2f ms (max %7.2f)  busy %3.0f%% of %d thread(s)\n",
+               name.c_str(), frames, frames/wall, busy/n*1e3, maxBusy*1e3, latency/n*1e3, maxLatency*1e3,
+               busy/(wall*threads)*100, threads);
+    }
+
+private:
+    string name;
+    int frames;
+    double busy, maxBusy, latency, maxLatency;
+    mutable mutex m;
+};
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: DetectedFrame
+//Input: -
+//Output: One frame going through the pipeline, with everything found in it.
+//--------------------------------------------------------------------------------------------------------------------------//
+struct DetectedFrame {
+    int index;               // frame number
+    double decoded;          // getTickCount() when read
+    Mat image;               // BGR frame
+    Mat binaryImg;           // Preprocess output (at the search scale)
+    vector<Rect> candidates; // FindCandidates output
+    vector<double> percent;  // SkinPercent of every candidate
+    vector<Detection> humans; // candidates with at least MinSkinPercent skin
+    Mat masked;              // ROI(): image where binaryImg is white (Config::masked only)
+};
+
+class DetectorPipeline {
+public:
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Config
+    //Input: -
+    //Output: Threads per stage, threads for the ROIs of one frame (0: OpenCV's default), queue length and scale of
+    //        the candidate search (1: full resolution, see HumanDetector::SetScale), SkinIntegral for overlapping ROIs,
+    //        DetectedFrame::masked wanted.
+    //----------------------------------------------------------------------------------------------------------------------//
+    struct Config {
+        Config() : preprocessThreads(1), contourThreads(1), skinThreads(1), roiThreads(0), queueSize(4), scale(1),
+                   skinIntegral(false), masked(false) {}
+        int preprocessThreads, contourThreads, skinThreads, roiThreads;
+        size_t queueSize;
+        double scale;
+        bool skinIntegral, masked;
+    };
+
+    explicit DetectorPipeline(Config const &config = Config())
+        : config(config), decodeStats("decode"), preprocessStats("preprocess"), contourStats("contours"),
+          skinStats("skin"), outputStats("output"), wall(0) {}
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Run
+    //Input: Opened video, sink(DetectedFrame &) called on this thread in frame order (return false to stop)
+    //Output: Number of frames passed to the sink.
+    //----------------------------------------------------------------------------------------------------------------------//
+    template<class Sink>
+    int Run(VideoCapture &cap, Sink sink) {
+        if (config.roiThreads > 0)
+            setNumThreads(config.roiThreads);
+        BoundedQueue<DetectedFrame> decoded(config.queueSize), preprocessed(config.queueSize),
+                                    contoured(config.queueSize), done(config.queueSize);
+        double start = (double)getTickCount();
+        vector<thread> threads;
+        threads.push_back(thread([&] {
+            for (int index = 0; ; index++) {
+                double t = (double)getTickCount();
+                DetectedFrame frame;
+                if (!cap.read(frame.image) || frame.image.empty())
+                    break;
+                frame.index = index;
+                frame.decoded = t;
+                decodeStats.Add(Seconds(t), Seconds(t));
+                if (!decoded.Push(frame))
+                    break;
+            }
+            decoded.Close();
+        }));
+        double scale = config.scale > 0 && config.scale < 1 ? config.scale : 1;
+        bool masked = config.masked;
+        Stage(threads, config.preprocessThreads, decoded, preprocessed, preprocessStats, [scale, masked](DetectedFrame &frame) {
+            if (scale < 1) {
+                static thread_local Mat small, fullBinary;
+                resize(frame.image, small, Size(), scale, scale, INTER_AREA);
+                Preprocess(small, frame.binaryImg);
+                if (masked) {
+                    resize(frame.binaryImg, fullBinary, frame.image.size(), 0, 0, INTER_NEAREST);
+                    MaskedCopy(frame.image, fullBinary, frame.masked);
+                }
+            }
+            else {
+                Preprocess(frame.image, frame.binaryImg);
+                if (masked)
+                    MaskedCopy(frame.image, frame.binaryImg, frame.masked);
+            }
+        });
+        Stage(threads, config.contourThreads, preprocessed, contoured, contourStats, [scale](DetectedFrame &frame) {
+            FindCandidates(frame.binaryImg, frame.candidates, scale);
+            for (size_t i = 0; i < frame.candidates.size(); i++)
+                frame.candidates[i] = ScaleUp(frame.candidates[i], scale, frame.image.size());
+        });
+        bool skinIntegral = config.skinIntegral;
+        Stage(threads, config.skinThreads, contoured, done, skinStats, [skinIntegral](DetectedFrame &frame) {
+            if (skinIntegral) {
+                static thread_local SkinIntegral integral;
+                static thread_local SkinKernel kernel;
+                integral.SkinPercents(frame.image, frame.candidates, frame.percent, kernel, &SharedSkinLut());
+            }
+            else
+                SkinCheck(frame.image, frame.candidates, frame.percent).Run();
+            for (size_t i = 0; i < frame.candidates.size(); i++)
+                if (frame.percent[i] >= MinSkinPercent) {
+                    Detection d = { frame.candidates[i], frame.percent[i] };
+                    frame.humans.push_back(d);
+                }
+        });
+
+        // Put the frames back in order
+        map<int, DetectedFrame> early;
+        DetectedFrame frame;
+        int next = 0;
+        bool stop = false;
+        while (!stop && done.Pop(frame)) {
+            early[frame.index] = frame;
+            for (map<int, DetectedFrame>::iterator it; !stop && (it = early.find(next)) != early.end(); next++) {
+                double t = (double)getTickCount();
+                stop = !sink(it->second);
+                outputStats.Add(Seconds(t), Seconds(it->second.decoded));
+                early.erase(it);
+            }
+        }
+        // Stopped early: let every stage run out
+        decoded.Close(); preprocessed.Close(); contoured.Close(); done.Close();
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+        wall = Seconds(start);
+        return next;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: PrintStats
+    //Input: -
+    //Output: Per-stage counters of the last Run, printed to stdout.
+    //----------------------------------------------------------------------------------------------------------------------//
+    void PrintStats() const {
+        double w = wall > 0 ? wall : 1;
+        decodeStats.Print(w, 1);
+        preprocessStats.Print(w, config.preprocessThreads);
+        contourStats.Print(w, config.contourThreads);
+        skinStats.Print(w, config.skinThreads);
+        outputStats.Print(w, 1);
+    }
+
+private:
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Seconds
+    //Input: getTickCount() at the start
+    //Output: Seconds since then.
+    //----------------------------------------------------------------------------------------------------------------------//
+    static double Seconds(double since) {
+        return ((double)getTickCount() - since)/getTickFrequency();
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Stage
+    //Input: Thread list, number of threads, input and output queue, counters, work(DetectedFrame &)
+    //Output: Threads started; the last one to finish closes the output queue.
+    //----------------------------------------------------------------------------------------------------------------------//
+    template<class Work>
+    void Stage(vector<thread> &threads, int count, BoundedQueue<DetectedFrame> &in, BoundedQueue<DetectedFrame> &out,
+               StageStats &stats, Work work) {
+        count = max(count, 1);
+        shared_ptr<int> running(new int(count));
+        shared_ptr<mutex> m(new mutex);
+        for (int i = 0; i < count; i++) {
+            threads.push_back(thread([&in, &out, &stats, work, running, m] {
+                DetectedFrame frame;
+                while (in.Pop(frame)) {
+                    double t = (double)getTickCount();
+                    work(frame);
+                    stats.Add(Seconds(t), Seconds(frame.decoded));
+                    if (!out.Push(frame))
+                        break;
+                }
+                lock_guard<mutex> lock(*m);
+                if (--*running == 0)
+                    out.Close();
+            }));
+        }
+    }
+
+    Config config;
+    StageStats decodeStats, preprocessStats, contourStats, skinStats, outputStats;
+    double wall;
+};
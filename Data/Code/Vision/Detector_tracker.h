@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdio>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "Human_detector.h"
+
+using namespace std;
+using namespace cv;
+
+//--------------------------------------------------------------------------------------------------------------------------//
+// Temporal mode of the human detector.
+//
+// A person in the water moves only a few pixels from one frame to the next, so once a ROI has been accepted it does
+// not have to be found again in the whole frame. HumanTracker keeps the accepted ROIs as tracks and, on the following
+// frames, runs the same steps (HSV, Otsu threshold, contours, skin) only in a window around every track. A full-frame
+// Detect is done every fullScanInterval frames, when there is nothing to track, and whenever a track is lost in its
+// window; new people therefore show up at the next full scan at the latest. Note that Otsu picks its threshold from
+// the window, not from the whole frame, so a tracked blob may be slightly larger or smaller than a full scan finds it.
+//--------------------------------------------------------------------------------------------------------------------------//
+class HumanTracker {
+public:
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Config
+    //Input: -
+    //Output: Frames between full scans (1: every frame, no tracking) and pixels searched around a track.
+    //----------------------------------------------------------------------------------------------------------------------//
+    struct Config {
+        Config() : fullScanInterval(10), searchMargin(32) {}
+        int fullScanInterval, searchMargin;
+    };
+
+    explicit HumanTracker(Config const &config = Config())
+        : config(config), sinceFullScan(0), frames(0), fastFrames(0), lostTracks(0), fastPath(false) {
+        ClearTimes();
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Process
+    //Input: Next BGR frame of the video
+    //Output: The tracked humans in this frame (valid until the next call).
+    //----------------------------------------------------------------------------------------------------------------------//
+    vector<Detection> const &Process(Mat const &frame) {
+        frames++;
+        ClearTimes();
+        fastPath = !tracks.empty() && sinceFullScan + 1 < config.fullScanInterval && TrackAll(frame);
+        if (fastPath) {
+            fastFrames++;
+            sinceFullScan++;
+            return tracks;
+        }
+        tracks = detector.Detect(frame);
+        AddTimes(detector.Times(), true);
+        sinceFullScan = 0;
+        return tracks;
+    }
+
+    bool FastPath() const { return fastPath; }                 // whether the last frame was done by tracking only
+    int Frames() const { return frames; }                      // frames processed
+    int FastFrames() const { return fastFrames; }              // frames without a full scan
+    int LostTracks() const { return lostTracks; }              // tracks that forced a full scan
+    DetectorTimes const &Times() const { return times; }       // of the last frame, summed over its windows
+    HumanDetector &Detector() { return detector; }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: PrintStats
+    //Input: -
+    //Output: Frames, fast path frames and lost tracks printed to stdout.
+    //----------------------------------------------------------------------------------------------------------------------//
+    void PrintStats() const {
+        printf("%d frames, %d (%.1f%%) by tracking only, %d full scans, %d tracks lost\n", frames, fastFrames,
+               frames ? 100.0*fastFrames/frames : 0.0, frames - fastFrames, lostTracks);
+    }
+
+private:
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: TrackAll
+    //Input: Frame
+    //Output: (true/false) whether every track was found again in its window (tracks are updated in place).
+    //----------------------------------------------------------------------------------------------------------------------//
+    bool TrackAll(Mat const &frame) {
+        Rect image(0, 0, frame.cols, frame.rows);
+        for (size_t i = 0; i < tracks.size(); i++) {
+            Rect &rect = tracks[i].rect;
+            int m = config.searchMargin;
+            Rect window = Rect(rect.x - m, rect.y - m, rect.width + 2*m, rect.height + 2*m) & image;
+            detector.Preprocess(frame(window), windowBinary);
+            detector.FindCandidates(windowBinary, windowCandidates);
+            AddTimes(detector.Times(), false);
+
+            // The candidate overlapping the track the most
+            int best = -1, bestOverlap = 0;
+            for (size_t c = 0; c < windowCandidates.size(); c++) {
+                Rect moved = windowCandidates[c] + window.tl();
+                int overlap = (moved & rect).area();
+                if (overlap > bestOverlap) {
+                    best = (int)c;
+                    bestOverlap = overlap;
+                }
+            }
+            double t = (double)getTickCount();
+            double percent = 0;
+            if (best >= 0) {
+                Rect moved = windowCandidates[best] + window.tl();
+                percent = detector.SkinPercent(frame(moved));
+                if (percent >= MinSkinPercent) {
+                    rect = moved;
+                    tracks[i].skinPercent = percent;
+                }
+            }
+            times.getSkin += ((double)getTickCount() - t)/getTickFrequency();
+            if (best < 0 || percent < MinSkinPercent) {
+                lostTracks++;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: AddTimes
+    //Input: Step times of the detector, whether they are of a Detect (only Detect sets resize and getSkin)
+    //Output: Added to the times of this frame.
+    //----------------------------------------------------------------------------------------------------------------------//
+    void AddTimes(DetectorTimes const &t, bool detect) {
+        if (detect)
+            times.resize += t.resize;
+        times.cvtColor += t.cvtColor;
+        times.threshold += t.threshold;
+        times.findContours += t.findContours;
+        times.approxPolyDP += t.approxPolyDP;
+        if (detect)
+            times.getSkin += t.getSkin;
+    }
+
+    void ClearTimes() {
+        DetectorTimes none = { 0, 0, 0, 0, 0, 0 };
+        times = none;
+    }
+
+    Config config;
+    HumanDetector detector;
+    vector<Detection> tracks;
+    Mat windowBinary;
+    vector<Rect> windowCandidates;
+    DetectorTimes times;
+    int sinceFullScan, frames, fastFrames, lostTracks;
+    bool fastPath;
+};
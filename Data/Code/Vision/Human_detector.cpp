@@ -1,113 +1,26 @@
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
 #include "opencv2/opencv.hpp"
+#include "Human_detector.h"
+#include "Detector_pipeline.h"
+#include "Detector_tracker.h"
+#include "Masked_copy.h"
 
 using namespace std;
 using namespace cv;
-//--------------------------------------------------------------------------------------------------------------------------//
-//Name: R1
-//Input: R,G,B values of Mat Image
-//Output: (true/false) whether the R,G,B values lies within the threshold.
-//--------------------------------------------------------------------------------------------------------------------------//
-bool R1(int R, int G, int B) {
-    bool e1 = (R>95) && (G>40) && (B>20) && ((max(R,max(G,B)) - min(R, min(G,B)))>15) && (abs(R-G)>15) && (R>G) && (R>B);
-    bool e2 = (R>220) && (G>210) && (B>170) && (abs(R-G)<=15) && (R>B) && (G>B);
-    return (e1||e2);
-}
-
-//--------------------------------------------------------------------------------------------------------------------------//
-//Name: R2
-//Input: Y,Cr,Cb values of Mat Image
-//Output: (true/false) whether the Y,Cr,Cb values lies within the threshold.
-//--------------------------------------------------------------------------------------------------------------------------//
-bool R2(float Y, float Cr, float Cb) {
-    bool e3 = Cr <= 1.5862*Cb+20;
-    bool e4 = Cr >= 0.3448*Cb+76.2069;
-    bool e5 = Cr >= -4.5652*Cb+234.5652;
-    bool e6 = Cr <= -1.15*Cb+301.75;
-    bool e7 = Cr <= -2.2857*Cb+432.85;
-    return e3 && e4 && e5 && e6 && e7;
-}
-
-//--------------------------------------------------------------------------------------------------------------------------//
-//Name: R3
-//Input: H,S,V values of Mat Image
-//Output: (true/false) whether the H,S,V values lies within the threshold.
-//--------------------------------------------------------------------------------------------------------------------------//
-bool R3(float H, float S, float V) {
-    return (H<25) || (H > 230);
-}
-
 
 //------------------------------------------------------------------------------------------------------------------------//
-//Name: GetSkin()
-//Input: ROIS at which blobs detected
+//Name: ReportSkin()
+//Input: Skin percentage of a ROI and its skin mask
 //Output: (true/false) whether a human is in the ROI.
 //------------------------------------------------------------------------------------------------------------------------//
-bool GetSkin(Mat const &src) {
-    // allocate the result matrix
-    Mat dst = src.clone();
-    
-    Vec3b cwhite = Vec3b::all(255);
-    Vec3b cblack = Vec3b::all(0);
-    
-    Mat src_ycrcb, src_hsv;
-    // OpenCV scales the YCrCb components, so that they
-    // cover the whole value range of [0,255], so there's
-    // no need to scale the values:
-    cvtColor(src, src_ycrcb, CV_BGR2YCrCb);
-    // OpenCV scales the Hue Channel to [0,180] for
-    // 8bit images, so make sure we are operating on
-    // the full spectrum from [0,360] by using floating
-    // point precision:
-    src.convertTo(src_hsv, CV_32FC3);
-    cvtColor(src_hsv, src_hsv, CV_BGR2HSV);
-    // Now scale the values between [0,255]:
-    normalize(src_hsv, src_hsv, 0.0, 255.0, NORM_MINMAX, CV_32FC3);
-    int WhiteCount = 0;
-    int blackCount = 0;
-    for(int i = 0; i < src.rows; i++) {
-        for(int j = 0; j < src.cols; j++) {
-            
-            Vec3b pix_bgr = src.ptr<Vec3b>(i)[j];
-            int B = pix_bgr.val[0];
-            int G = pix_bgr.val[1];
-            int R = pix_bgr.val[2];
-            // apply rgb rule
-            bool a = R1(R,G,B);
-            
-            Vec3b pix_ycrcb = src_ycrcb.ptr<Vec3b>(i)[j];
-            int Y = pix_ycrcb.val[0];
-            int Cr = pix_ycrcb.val[1];
-            int Cb = pix_ycrcb.val[2];
-            // apply ycrcb rule
-            bool b = R2(Y,Cr,Cb);
-            
-            Vec3f pix_hsv = src_hsv.ptr<Vec3f>(i)[j];
-            float H = pix_hsv.val[0];
-            float S = pix_hsv.val[1];
-            float V = pix_hsv.val[2];
-            // apply hsv rule
-            bool c = R3(H,S,V);
-            
-            if(!(a&&b&&c))
-            {
-                dst.ptr<Vec3b>(i)[j] = cblack;
-                blackCount++; // used to calc persentage
-            }
-            if (a&&b&&c)
-            {
-                dst.ptr<Vec3b>(i)[j] = cwhite;
-                WhiteCount++;  // used to calc persentage
-            }
-            
-        }
-    }
-    
+bool ReportSkin(double percent, Mat const &dst) {
     double image_size = dst.cols*dst.rows;
-    if((double) WhiteCount/image_size*100 < 1) // if White pixel is less than 15 % if the image then its not a human (value determined from test)
+    if(percent < MinSkinPercent) // if White pixel is less than 1 % if the image then its not a human (value determined from test)
     {
         cout << "rejected because: " << endl;
-        cout <<(double) WhiteCount/image_size*100 << " " <<(double)blackCount/image_size*100<< " " << image_size << endl;
+        cout << percent << " " << 100 - percent << " " << image_size << endl;
         
         imshow("This", dst);
         return false;
@@ -115,36 +28,21 @@ bool GetSkin(Mat const &src) {
     else
     {
         cout << "accepted because: "<< endl;
-        cout <<(double) WhiteCount/image_size*100 << " " <<(double)blackCount/image_size*100<< " " << image_size << endl;
+        cout << percent << " " << 100 - percent << " " << image_size << endl;
         
         imshow("This", dst);
         return true;
     }
 }
+
 //--------------------------------------------------------------------------------------------------------------------------//
 //Name: ROI
 //Input: BinaryImage and Original image.
 //Output: A Mat at which the BinaryImage is used as mask on the Original Image.
 //--------------------------------------------------------------------------------------------------------------------------//
 Mat ROI(Mat binaryImg, Mat originalImg){
-    
-    Mat channel[3];
-    split(originalImg, channel);
-    Mat originalImg2=originalImg.clone();
-    
-    //calcHistogram(binaryImg);
-    
-    for(int i=0; i<binaryImg.rows; i++){
-        for(int j=0; j<binaryImg.cols; j++){
-            if(binaryImg.at<double>(i,j)<250){
-                channel[0].at<double>(i,j)=0;
-                channel[1].at<double>(i,j)=0;
-                channel[2].at<double>(i,j)=0;
-            }
-        }
-    }
-    merge(channel, 3, originalImg2);
-    cvtColor(originalImg2, originalImg2, CV_BGR2RGB, 0 );
+    Mat originalImg2;
+    MaskedCopy(originalImg, binaryImg, originalImg2); // black where binaryImg < 250, see Masked_copy.h
     return originalImg2;
 }
 
@@ -155,35 +53,22 @@ Mat ROI(Mat binaryImg, Mat originalImg){
 //--------------------------------------------------------------------------------------------------------------------------//
 vector<Mat>  MarkCountours(Mat binaryImg, Mat originalImg) //Input binary image
 {
-    vector<vector<Point> > contours;
-    Mat test = binaryImg.clone();
     Mat test2 = originalImg.clone();
-    vector<Vec4i> hierarchy;
-    RNG rng(12345);
-    findContours( test, contours, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, Point(0, 0) ); // Findcontours based from the binary image
-    vector<vector<Point> > contours_poly( contours.size() );
-    vector<Rect> boundRect( contours.size() );
-    for( int i = 0; i < contours.size(); i++ )
-    {
-        approxPolyDP( Mat(contours[i]), contours_poly[i], 3, true );
-        boundRect[i] = boundingRect( Mat(contours_poly[i]) );
-        //Creating small initialize the ROI boundary
-    }
+    vector<Rect> boundRect;
+    FindCandidates(binaryImg, boundRect); // Findcontours based from the binary image, with approved Contour area
+    vector<double> percent;
+    vector<Mat> masks;
+    SkinCheck(test2, boundRect, percent, &masks).Run(); // skin percentage and mask of all ROIs, in parallel
     
     vector<Mat> subregions_normal;
-    vector<Mat> subregions_contour;
-    for (int i = 0; i< boundRect.size(); i++)
+    for (size_t i = 0; i< boundRect.size(); i++)
     {
-        if (contourArea(contours[i]) >= 1000 && contourArea(contours[i]) <= 1000000) //If the Area of contour
-        {
-            Mat roi_normal(test2,boundRect[i]); //Create ROI with approved Contour area;
-            if (GetSkin(roi_normal)) { // Check if ROI has approved skin color
-                subregions_normal.push_back(roi_normal); // Vector consiting of Detected humans
-                rectangle(originalImg, boundRect[i], Scalar(255,0,0)); // Rectangle showing on the original image where it is.
-                
-            }
+        Mat roi_normal(test2,boundRect[i]); //Create ROI with approved Contour area;
+        if (ReportSkin(percent[i], masks[i])) { // Check if ROI has approved skin color
+            subregions_normal.push_back(roi_normal); // Vector consiting of Detected humans
+            rectangle(originalImg, boundRect[i], Scalar(255,0,0)); // Rectangle showing on the original image where it is.
+            
         }
-        
     }
     
     return subregions_normal;
@@ -192,28 +77,39 @@ vector<Mat>  MarkCountours(Mat binaryImg, Mat originalImg) //Input binary image
 
 
 
-int main(int argc, const char * argv[]) {
-    Mat src, dst;
-    //Load image
-    //src = imread("/Users/keerthikanratnarajah/Desktop/Wave1.jpeg"); // Load image
-    //Load Video
-    VideoCapture cap("/Users/keerthikanratnarajah/SDU-UAS-15-Group1-Report/Test_images/Oceanvideo_whalerescue.mp4"); // load Video
-    while (1)
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: LoadSkinLut
+//Input: Filename of the R1/R2 colour table
+//Output: SharedSkinLut loaded, or built and saved if the file is missing.
+//--------------------------------------------------------------------------------------------------------------------------//
+void LoadSkinLut(string const &filename) {
+    SkinLut &lut = SharedSkinLut();
+    if (!lut.Load(filename)) {
+        SkinKernel kernel;
+        lut.Build(kernel);
+        if (!lut.Save(filename))
+            cout << "Could not save " << filename << endl;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: StepThrough
+//Input: Video
+//Output: The original one frame at a time loop: press 'y' to go through the ROIs with humans, any key for the next frame.
+//--------------------------------------------------------------------------------------------------------------------------//
+int StepThrough(VideoCapture &cap) {
+    Mat src;
+    while (cap.read(src))
     {
-        cap.read(src);
-        cvtColor(src, dst, CV_RGB2HSV, 0 );
-        Mat channel[3];
-        split(dst, channel);
-        
         //Binarize image
         Mat binaryImg;
-        threshold(channel[0], binaryImg, THRESH_BINARY, 255, THRESH_OTSU); // Preproccesing at which  the image rets binarizes.
+        Preprocess(src, binaryImg);
         vector<Mat> ROI = MarkCountours(binaryImg,src); // MarkCounter output ROI with detected Humans within.
         if (ROI.size() == 0) {
             cout << "No Humans detected" << endl;
             return 0;
         }
-        int i = 0;
+        size_t i = 0;
         while (i <  ROI.size())
         {
             if (waitKey(10) != 'y')
@@ -229,8 +125,120 @@ int main(int argc, const char * argv[]) {
         imshow("Image binary", binaryImg );
         imshow("SRC" , src);
         waitKey(0);
-        
-        
     }
     return 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: Track
+//Input: Video, tracker, headless (true/false)
+//Output: Frames processed with HumanTracker (full scan every few frames, local search around the humans in between).
+//--------------------------------------------------------------------------------------------------------------------------//
+int Track(VideoCapture &cap, HumanTracker &tracker, bool headless) {
+    Mat src;
+    double start = (double)getTickCount();
+    while (cap.read(src) && !src.empty())
+    {
+        vector<Detection> const &humans = tracker.Process(src);
+        cout << "Frame " << tracker.Frames() - 1 << ": " << humans.size() << " humans"
+             << (tracker.FastPath() ? " (tracked)" : " (full scan)") << endl;
+        if (headless) {
+            for (size_t i = 0; i < humans.size(); i++) {
+                Rect const &r = humans[i].rect;
+                cout << "  " << r.x << "," << r.y << " " << r.width << "x" << r.height << " skin "
+                     << humans[i].skinPercent << " %" << endl;
+            }
+            continue;
+        }
+        for (size_t i = 0; i < humans.size(); i++)
+            rectangle(src, humans[i].rect, Scalar(255,0,0)); // Rectangle showing on the original image where it is.
+        imshow("SRC" , src);
+        if (waitKey(1) == 27) // Esc stops
+            break;
+    }
+    double seconds = ((double)getTickCount() - start)/getTickFrequency();
+    tracker.PrintStats();
+    printf("%.1f fps\n", tracker.Frames()/(seconds > 0 ? seconds : 1));
+    return tracker.Frames();
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+// Usage: Human_detector [video] [-lut <file>] [-threads <preprocess>,<contours>,<skin>,<roi>] [-step] [-headless]
+//                       [-track <frames>[,<margin>]] [-scale <factor>] [-integral] [-masked]
+//  -lut      reject ROIs without R1/R2 colours by table lookups (the table is built and saved if the file is missing)
+//  -threads  threads of the pipeline stages and for the ROIs of one frame (default 1,1,1,0; 0 = OpenCV's default)
+//  -step     the original interactive loop instead of the pipeline
+//  -headless no windows: print the detections (rectangle and skin percentage) of every frame
+//  -track    full scan every <frames> frames only, in between search <margin> pixels (default 32) around the humans
+//  -scale    find the candidate blobs on the frame downscaled by <factor> (e.g. 0.5), check their skin at full size
+//  -integral skin percentage of overlapping blobs from one integral image per group of blobs (Skin_integral.h)
+//  -masked   also show the frame masked by the binary image (ROI())
+//--------------------------------------------------------------------------------------------------------------------------//
+int main(int argc, const char * argv[]) {
+    //Load Video
+    string video = "/Users/keerthikanratnarajah/SDU-UAS-15-Group1-Report/Test_images/Oceanvideo_whalerescue.mp4";
+    DetectorPipeline::Config config;
+    HumanTracker::Config trackConfig;
+    bool step = false, headless = false, track = false;
+    for (int a = 1; a < argc; a++) {
+        string arg(argv[a]);
+        if (arg == "-lut" && a + 1 < argc)
+            LoadSkinLut(argv[++a]);
+        else if (arg == "-threads" && a + 1 < argc)
+            sscanf(argv[++a], "%d,%d,%d,%d", &config.preprocessThreads, &config.contourThreads, &config.skinThreads,
+                   &config.roiThreads);
+        else if (arg == "-step")
+            step = true;
+        else if (arg == "-headless")
+            headless = true;
+        else if (arg == "-scale" && a + 1 < argc)
+            config.scale = atof(argv[++a]);
+        else if (arg == "-integral")
+            config.skinIntegral = true;
+        else if (arg == "-masked")
+            config.masked = true;
+        else if (arg == "-track" && a + 1 < argc) {
+            sscanf(argv[++a], "%d,%d", &trackConfig.fullScanInterval, &trackConfig.searchMargin);
+            track = true;
+        }
+        else
+            video = arg;
+    }
+    VideoCapture cap(video); // load Video
+    if (!cap.isOpened()) {
+        cout << "Could not open " << video << endl;
+        return 1;
+    }
+    if (step)
+        return StepThrough(cap);
+    if (track) {
+        HumanTracker tracker(trackConfig);
+        tracker.Detector().SetScale(config.scale);
+        tracker.Detector().UseSkinIntegral(config.skinIntegral);
+        Track(cap, tracker, headless);
+        return 0;
+    }
+
+    DetectorPipeline pipeline(config);
+    pipeline.Run(cap, [headless](DetectedFrame &frame) {
+        cout << "Frame " << frame.index << ": " << frame.humans.size() << " of " << frame.candidates.size()
+             << " blobs accepted" << endl;
+        if (headless) {
+            for (size_t i = 0; i < frame.humans.size(); i++) {
+                Rect const &r = frame.humans[i].rect;
+                cout << "  " << r.x << "," << r.y << " " << r.width << "x" << r.height << " skin "
+                     << frame.humans[i].skinPercent << " %" << endl;
+            }
+            return true;
+        }
+        for (size_t i = 0; i < frame.humans.size(); i++)
+            rectangle(frame.image, frame.humans[i].rect, Scalar(255,0,0)); // Rectangle showing on the original image where it is.
+        imshow("Image binary", frame.binaryImg );
+        if (!frame.masked.empty())
+            imshow("Masked", frame.masked);
+        imshow("SRC" , frame.image);
+        return waitKey(1) != 27; // Esc stops
+    });
+    pipeline.PrintStats();
+    return 0;
 }
\ No newline at end of file
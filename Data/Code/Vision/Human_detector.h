@@ -0,0 +1,314 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "Masked_copy.h"
+#include "Skin_kernel.h"
+#include "Skin_integral.h"
+#include "Skin_lut.h"
+
+using namespace std;
+using namespace cv;
+
+//--------------------------------------------------------------------------------------------------------------------------//
+// The detection steps of Human_detector.cpp without any window or console output, so that they can run on any thread:
+// Preprocess (HSV, Otsu threshold), FindCandidates (contours and their bounding rectangles) and SkinPercent, together
+// in HumanDetector::Detect.
+//
+// Coarse-to-fine search: with a scale below 1 the frame is downscaled (INTER_AREA) before Preprocess and
+// FindCandidates, the contour area limits are multiplied by scale^2, and the bounding rectangles are mapped back to
+// full resolution, where the skin test is done as before. Blobs near MinContourArea or thinner than a few pixels at
+// the reduced size may be lost, see Detector_benchmark -recall.
+//--------------------------------------------------------------------------------------------------------------------------//
+
+const double MinContourArea = 1000;    // contourArea limits of the candidate blobs (pixels)
+const double MaxContourArea = 1000000;
+const double MinSkinPercent = 1;       // a ROI with less skin than this is not a human (value determined from test)
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: SharedSkinLut
+//Input: -
+//Output: The optional R1/R2 colour table used by SkinPercent (Empty unless loaded or built by main).
+//--------------------------------------------------------------------------------------------------------------------------//
+inline SkinLut &SharedSkinLut() {
+    static SkinLut lut;
+    return lut;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: ScaleUp
+//Input: Rectangle in an image downscaled by scale (0 < scale <= 1), size of the full resolution image
+//Output: The rectangle covering the same pixels at full resolution (clipped to the image).
+//--------------------------------------------------------------------------------------------------------------------------//
+inline Rect ScaleUp(Rect const &r, double scale, Size const &full) {
+    if (scale >= 1)
+        return r;
+    int x0 = (int)floor(r.x/scale), y0 = (int)floor(r.y/scale);
+    int x1 = (int)ceil((r.x + r.width)/scale), y1 = (int)ceil((r.y + r.height)/scale);
+    return Rect(x0, y0, x1 - x0, y1 - y0) & Rect(0, 0, full.width, full.height);
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: Detection
+//Input: -
+//Output: A ROI accepted as human, with its score (percentage of skin pixels).
+//--------------------------------------------------------------------------------------------------------------------------//
+struct Detection {
+    Rect rect;
+    double skinPercent;
+};
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: DetectorTimes
+//Input: -
+//Output: Seconds spent in each step of the last HumanDetector::Detect.
+//--------------------------------------------------------------------------------------------------------------------------//
+struct DetectorTimes {
+    double resize;       // downscaling (coarse-to-fine search only)
+    double cvtColor;     // BGR -> HSV and taking the hue channel
+    double threshold;    // Otsu threshold
+    double findContours; // including the copy of its input
+    double approxPolyDP; // contourArea, approxPolyDP and boundingRect of every contour
+    double getSkin;      // skin percentage of every candidate (and SkinIntegral::Compute)
+};
+
+//--------------------------------------------------------------------------------------------------------------------------//
+// Headless detector. All images, contour lists and the skin kernel's scratch are members that keep their memory from
+// one frame to the next, so once the largest frame and ROI have been seen no buffer of the detector is allocated
+// again (findContours still uses OpenCV's internal storage). One detector per thread.
+//--------------------------------------------------------------------------------------------------------------------------//
+class HumanDetector {
+public:
+    HumanDetector() : lut(&SharedSkinLut()), scale(1), useIntegral(false) {
+        DetectorTimes none = { 0, 0, 0, 0, 0, 0 };
+        times = none;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Detect
+    //Input: BGR frame, optional debug mask output (CV_8UC1 frame size: white where skin in the candidate ROIs),
+    //       optional masked frame output (ROI(): the frame where the binary image is white, black elsewhere)
+    //Output: The candidates with at least MinSkinPercent skin (valid until the next call).
+    //----------------------------------------------------------------------------------------------------------------------//
+    vector<Detection> const &Detect(Mat const &frame, Mat *debugMask = 0, Mat *masked = 0) {
+        double t = (double)getTickCount();
+        if (scale < 1) {
+            resize(frame, small, Size(), scale, scale, INTER_AREA);
+            times.resize = Lap(t);
+            Preprocess(small, binaryImg);
+            FindCandidates(binaryImg, candidates, scale);
+            for (size_t i = 0; i < candidates.size(); i++)
+                candidates[i] = ScaleUp(candidates[i], scale, frame.size());
+        }
+        else {
+            times.resize = 0;
+            Preprocess(frame, binaryImg);
+            FindCandidates(binaryImg, candidates);
+        }
+        t = (double)getTickCount();
+        if (debugMask) {
+            debugMask->create(frame.rows, frame.cols, CV_8UC1);
+            debugMask->setTo(Scalar(0));
+        }
+        detections.clear();
+        bool fromIntegral = useIntegral && !debugMask; // the integral image has no mask
+        if (fromIntegral)
+            integral.SkinPercents(frame, candidates, percents, kernel, lut);
+        for (size_t i = 0; i < candidates.size(); i++) {
+            Mat roiMask;
+            if (debugMask)
+                roiMask = (*debugMask)(candidates[i]); // nested ROIs: the last one wins
+            double percent = fromIntegral ? percents[i] : SkinPercent(frame(candidates[i]), debugMask ? &roiMask : 0);
+            if (percent >= MinSkinPercent) {
+                Detection d = { candidates[i], percent };
+                detections.push_back(d);
+            }
+        }
+        times.getSkin = Lap(t);
+        if (masked) {
+            if (binaryImg.size() != frame.size()) { // coarse-to-fine search
+                resize(binaryImg, fullBinary, frame.size(), 0, 0, INTER_NEAREST);
+                MaskedCopy(frame, fullBinary, *masked);
+            }
+            else
+                MaskedCopy(frame, binaryImg, *masked);
+        }
+        return detections;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Preprocess
+    //Input: Frame
+    //Output: Binary image (Otsu threshold of the hue channel).
+    //----------------------------------------------------------------------------------------------------------------------//
+    void Preprocess(Mat const &src, Mat &binaryImg) {
+        double t = (double)getTickCount();
+        cvtColor(src, hsv, CV_RGB2HSV, 0 );
+        hue.create(hsv.rows, hsv.cols, CV_8UC1);
+        int fromTo[] = { 0, 0 };
+        mixChannels(&hsv, 1, &hue, 1, fromTo, 1);
+        times.cvtColor = Lap(t);
+        threshold(hue, binaryImg, THRESH_BINARY, 255, THRESH_OTSU); // Preproccesing at which  the image rets binarizes.
+        times.threshold = Lap(t);
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: FindCandidates
+    //Input: BinaryImage, scale of the binary image relative to the frame (area limits are multiplied by scale^2)
+    //Output: Bounding rectangles of the contours with an area between MinContourArea and MaxContourArea (in frame
+    //        pixels), in binary image coordinates.
+    //----------------------------------------------------------------------------------------------------------------------//
+    void FindCandidates(Mat const &binaryImg, vector<Rect> &candidates, double scale = 1) {
+        double t = (double)getTickCount();
+        binaryImg.copyTo(contourImg); // findContours modifies its input
+        findContours( contourImg, contours, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, Point(0, 0) );
+        times.findContours = Lap(t);
+        candidates.clear();
+        double minArea = MinContourArea*scale*scale, maxArea = MaxContourArea*scale*scale;
+        for( size_t i = 0; i < contours.size(); i++ )
+        {
+            double area = contourArea(contours[i]);
+            if (area >= minArea && area <= maxArea)
+            {
+                approxPolyDP( Mat(contours[i]), contour_poly, 3, true );
+                candidates.push_back(boundingRect( Mat(contour_poly) ));
+            }
+        }
+        times.approxPolyDP = Lap(t);
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: SkinPercent
+    //Input: ROI, optional mask output (white where skin; an existing header of the right size is written in place)
+    //Output: Percentage of the ROI's pixels passing R1, R2 and R3.
+    //----------------------------------------------------------------------------------------------------------------------//
+    double SkinPercent(Mat const &roi, Mat *mask = 0) {
+        int white = lut->Empty() ? kernel.Count(roi, mask) : lut->Count(roi, kernel, mask);
+        return (double)white/(roi.cols*roi.rows)*100;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: UseSkinLut
+    //Input: Colour table (not owned; an empty one is not used)
+    //Output: -
+    //----------------------------------------------------------------------------------------------------------------------//
+    void UseSkinLut(SkinLut const &table) { lut = &table; }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: UseSkinIntegral
+    //Input: (true/false) take the skin percentages of overlapping candidates from one SkinIntegral per group
+    //Output: -
+    //----------------------------------------------------------------------------------------------------------------------//
+    void UseSkinIntegral(bool on) { useIntegral = on; }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: SetScale
+    //Input: Scale of the candidate search in Detect (1: full resolution, 0.5: half width and height, ...)
+    //Output: -
+    //----------------------------------------------------------------------------------------------------------------------//
+    void SetScale(double s) { scale = s > 0 && s < 1 ? s : 1; }
+
+    Mat const &BinaryImage() const { return binaryImg; }          // of the last Detect (at the search scale)
+    vector<Rect> const &Candidates() const { return candidates; } // of the last Detect
+    DetectorTimes const &Times() const { return times; }          // of the last Detect
+    SkinIntegral const &Integral() const { return integral; }     // query counters of UseSkinIntegral
+
+private:
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Lap
+    //Input: getTickCount() at the start of a step, set to now
+    //Output: Seconds since then.
+    //----------------------------------------------------------------------------------------------------------------------//
+    static double Lap(double &t) {
+        double now = (double)getTickCount();
+        double seconds = (now - t)/getTickFrequency();
+        t = now;
+        return seconds;
+    }
+
+    Mat small, hsv, hue, binaryImg, contourImg, fullBinary;
+    vector<vector<Point> > contours;
+    vector<Vec4i> hierarchy;
+    vector<Point> contour_poly;
+    vector<Rect> candidates;
+    vector<Detection> detections;
+    vector<double> percents;
+    SkinKernel kernel;
+    SkinLut const *lut;
+    double scale;
+    SkinIntegral integral;
+    bool useIntegral;
+    DetectorTimes times;
+};
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: ThreadDetector
+//Input: -
+//Output: This thread's detector, for the functions below.
+//--------------------------------------------------------------------------------------------------------------------------//
+inline HumanDetector &ThreadDetector() {
+    static thread_local HumanDetector detector;
+    return detector;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: Preprocess
+//Input: Frame
+//Output: Binary image (Otsu threshold of the hue channel).
+//--------------------------------------------------------------------------------------------------------------------------//
+inline void Preprocess(Mat const &src, Mat &binaryImg) {
+    ThreadDetector().Preprocess(src, binaryImg);
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: FindCandidates
+//Input: BinaryImage, its scale relative to the frame
+//Output: Bounding rectangles of the contours with an area between MinContourArea and MaxContourArea (in frame pixels).
+//--------------------------------------------------------------------------------------------------------------------------//
+inline void FindCandidates(Mat const &binaryImg, vector<Rect> &candidates, double scale = 1) {
+    ThreadDetector().FindCandidates(binaryImg, candidates, scale);
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: SkinPercent
+//Input: ROI, optional mask output (white where skin)
+//Output: Percentage of the ROI's pixels passing R1, R2 and R3. Thread safe (one detector per thread).
+//--------------------------------------------------------------------------------------------------------------------------//
+inline double SkinPercent(Mat const &roi, Mat *mask = 0) {
+    return ThreadDetector().SkinPercent(roi, mask);
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: SkinCheck
+//Input: Frame, candidate rectangles
+//Output: SkinPercent of every candidate, computed in parallel with parallel_for_ (one ROI per task).
+//--------------------------------------------------------------------------------------------------------------------------//
+class SkinCheck : public ParallelLoopBody {
+public:
+    SkinCheck(Mat const &image, vector<Rect> const &rects, vector<double> &percent, vector<Mat> *masks = 0)
+        : image(image), rects(rects), percent(percent), masks(masks) {
+        percent.resize(rects.size());
+        if (masks)
+            masks->resize(rects.size());
+    }
+
+    virtual void operator()(const Range &range) const {
+        for (int i = range.start; i < range.end; i++)
+            percent[i] = SkinPercent(Mat(image, rects[i]), masks ? &(*masks)[i] : 0);
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Run
+    //Input: -
+    //Output: All percentages computed (ROIs spread over OpenCV's threads, see setNumThreads).
+    //----------------------------------------------------------------------------------------------------------------------//
+    void Run() const {
+        parallel_for_(Range(0, (int)rects.size()), *this);
+    }
+
+private:
+    Mat image;
+    vector<Rect> const &rects;
+    vector<double> &percent;
+    vector<Mat> *masks;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include "opencv2/opencv.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MASKED_COPY_HAVE_SSSE3 1
+#include <immintrin.h>
+#define MASKED_COPY_SSSE3 __attribute__((target("ssse3")))
+#else
+#define MASKED_COPY_HAVE_SSSE3 0
+#endif
+
+using namespace std;
+using namespace cv;
+
+//--------------------------------------------------------------------------------------------------------------------------//
+// Masked copy used by ROI().
+//
+// ROI() read the 8-bit binary image and the 8-bit channels with at<double> (reading and writing 8 pixels at a time,
+// past the end of every row), split and merged the frame and converted it to RGB. MaskedCopy gives the intended result,
+// the frame with every pixel where the binary image is below 250 set to black, in one pass over the interleaved BGR
+// data, and keeps it in BGR like every other image given to imshow. With SSSE3 (checked at run time) 16 mask bytes
+// are compared and shuffled to cover 48 BGR bytes at a time.
+//--------------------------------------------------------------------------------------------------------------------------//
+
+#if MASKED_COPY_HAVE_SSSE3
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: MaskedCopyRowSsse3
+//Input: BGR row, binary row, output row, number of pixels
+//Output: Number of pixels done (a multiple of 16), written as by MaskedCopyRow.
+//--------------------------------------------------------------------------------------------------------------------------//
+MASKED_COPY_SSSE3 inline int MaskedCopyRowSsse3(const uchar *src, const uchar *binary, uchar *dst, int cols) {
+    const __m128i e0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m128i e1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m128i e2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    const __m128i limit = _mm_set1_epi8((char)250);
+    int j = 0;
+    for (; j + 16 <= cols; j += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*)(binary + j));
+        __m128i m = _mm_cmpeq_epi8(_mm_max_epu8(b, limit), b); // b >= 250
+        const __m128i *s = (const __m128i*)(src + 3*j);
+        __m128i *d = (__m128i*)(dst + 3*j);
+        _mm_storeu_si128(d, _mm_and_si128(_mm_loadu_si128(s), _mm_shuffle_epi8(m, e0)));
+        _mm_storeu_si128(d + 1, _mm_and_si128(_mm_loadu_si128(s + 1), _mm_shuffle_epi8(m, e1)));
+        _mm_storeu_si128(d + 2, _mm_and_si128(_mm_loadu_si128(s + 2), _mm_shuffle_epi8(m, e2)));
+    }
+    return j;
+}
+#endif
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: MaskedCopyRow
+//Input: BGR row, binary row, output row, number of pixels, (true/false) use SSSE3
+//Output: Output row written: the BGR pixel where binary >= 250, black elsewhere.
+//--------------------------------------------------------------------------------------------------------------------------//
+inline void MaskedCopyRow(const uchar *src, const uchar *binary, uchar *dst, int cols, bool simd) {
+    int j = 0;
+#if MASKED_COPY_HAVE_SSSE3
+    if (simd)
+        j = MaskedCopyRowSsse3(src, binary, dst, cols);
+#endif
+    for (; j < cols; j++) {
+        uchar m = binary[j] >= 250 ? 255 : 0;
+        dst[3*j] = src[3*j] & m;
+        dst[3*j + 1] = src[3*j + 1] & m;
+        dst[3*j + 2] = src[3*j + 2] & m;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: HaveSsse3
+//Input: -
+//Output: (true/false) whether the SSSE3 code path can run on this CPU.
+//--------------------------------------------------------------------------------------------------------------------------//
+inline bool HaveSsse3() {
+#if MASKED_COPY_HAVE_SSSE3
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+    return ssse3;
+#else
+    return false;
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: MaskedCopy
+//Input: 8-bit BGR image, CV_8UC1 binary image of the same size, output, (true/false) allow SSSE3
+//Output: BGR image with the pixels where the binary image is below 250 set to black (dst may be src).
+//--------------------------------------------------------------------------------------------------------------------------//
+inline void MaskedCopy(Mat const &src, Mat const &binaryImg, Mat &dst, bool simd = true) {
+    CV_Assert(src.type() == CV_8UC3 && binaryImg.type() == CV_8UC1 && src.size() == binaryImg.size());
+    if (dst.data != src.data)
+        dst.create(src.rows, src.cols, CV_8UC3);
+    simd = simd && HaveSsse3();
+    for (int i = 0; i < src.rows; i++)
+        MaskedCopyRow(src.ptr<uchar>(i), binaryImg.ptr<uchar>(i), dst.ptr<uchar>(i), src.cols, simd);
+}
@@ -0,0 +1,178 @@
+//--------------------------------------------------------------------------------------------------------------------------//
+// Correctness test and micro-benchmark of MaskedCopy (the masked frame of ROI()).
+//
+// Build: g++ -O2 -std=c++11 Masked_copy_benchmark.cpp -o Masked_copy_benchmark `pkg-config --cflags --libs opencv`
+// Usage: ./Masked_copy_benchmark [image or video files...]
+//
+// The binary image of every given image (or of the first frames of the given videos) is computed as the detector does,
+// and MaskedCopy, scalar and SSSE3, in place and not, is compared pixel by pixel with a per-pixel reference and with
+// copyTo through a mask. The same is done with random binary images (every value around 250) on frames of odd widths,
+// then the split/merge loop of the old ROI(), copyTo through a mask and MaskedCopy are timed.
+//--------------------------------------------------------------------------------------------------------------------------//
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include "opencv2/opencv.hpp"
+#include "Human_detector.h"
+#include "Masked_copy.h"
+
+using namespace std;
+using namespace cv;
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: MaskedReference
+//Input: BGR image, binary image, output
+//Output: The BGR pixel where the binary image is >= 250, black elsewhere (one pixel at a time)
+//--------------------------------------------------------------------------------------------------------------------------//
+void MaskedReference(Mat const &src, Mat const &binaryImg, Mat &dst) {
+    dst.create(src.rows, src.cols, CV_8UC3);
+    for (int i = 0; i < src.rows; i++)
+        for (int j = 0; j < src.cols; j++)
+            dst.at<Vec3b>(i, j) = binaryImg.at<uchar>(i, j) >= 250 ? src.at<Vec3b>(i, j) : Vec3b(0, 0, 0);
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: SplitMergeROI
+//Input: Binary image, BGR image
+//Output: The old ROI() with its at<double> accesses made at<uchar>: split, per-pixel loop, merge (without the RGB swap)
+//--------------------------------------------------------------------------------------------------------------------------//
+Mat SplitMergeROI(Mat const &binaryImg, Mat const &originalImg) {
+    Mat channel[3];
+    split(originalImg, channel);
+    for (int i = 0; i < binaryImg.rows; i++)
+        for (int j = 0; j < binaryImg.cols; j++)
+            if (binaryImg.at<uchar>(i, j) < 250) {
+                channel[0].at<uchar>(i, j) = 0;
+                channel[1].at<uchar>(i, j) = 0;
+                channel[2].at<uchar>(i, j) = 0;
+            }
+    Mat originalImg2;
+    merge(channel, 3, originalImg2);
+    return originalImg2;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: CopyToMasked
+//Input: BGR image, binary image, mask buffer, output
+//Output: The same image as MaskedCopy through threshold, setTo and copyTo with a mask
+//--------------------------------------------------------------------------------------------------------------------------//
+void CopyToMasked(Mat const &src, Mat const &binaryImg, Mat &mask, Mat &dst) {
+    threshold(binaryImg, mask, 249, 255, THRESH_BINARY);
+    dst.create(src.rows, src.cols, CV_8UC3);
+    dst.setTo(Scalar(0, 0, 0));
+    src.copyTo(dst, mask);
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: Differences
+//Input: Two images of the same size and type
+//Output: Number of differing bytes
+//--------------------------------------------------------------------------------------------------------------------------//
+int Differences(Mat const &a, Mat const &b) {
+    int differences = 0;
+    for (int i = 0; i < a.rows; i++)
+        for (size_t j = 0; j < a.cols*a.elemSize(); j++)
+            differences += a.ptr<uchar>(i)[j] != b.ptr<uchar>(i)[j];
+    return differences;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: Check
+//Input: BGR image, binary image, name for the report
+//Output: Number of MaskedCopy variants differing from the reference (0 expected)
+//--------------------------------------------------------------------------------------------------------------------------//
+int Check(Mat const &src, Mat const &binaryImg, string const &name) {
+    Mat expected, actual, mask;
+    MaskedReference(src, binaryImg, expected);
+    int failures = 0;
+    for (int simd = 0; simd < 2; simd++) {
+        MaskedCopy(src, binaryImg, actual, simd != 0);
+        Mat inPlace = src.clone();
+        MaskedCopy(inPlace, binaryImg, inPlace, simd != 0);
+        int differences = Differences(expected, actual) + Differences(expected, inPlace);
+        if (differences) {
+            cout << name << (simd ? ", SSSE3" : ", scalar") << ": " << differences << " bytes differ" << endl;
+            failures++;
+        }
+    }
+    CopyToMasked(src, binaryImg, mask, actual);
+    if (Differences(expected, actual)) {
+        cout << name << ": copyTo with a mask differs" << endl;
+        failures++;
+    }
+    return failures;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: MillisecondsPerFrame
+//Input: Frames, binary images, function masking one frame
+//Output: Time per frame (best of 5 runs)
+//--------------------------------------------------------------------------------------------------------------------------//
+template<class F>
+double MillisecondsPerFrame(vector<Mat> const &frames, vector<Mat> const &binary, F mask) {
+    double best = 1e300;
+    for (int run = 0; run < 5; run++) {
+        double t = (double)getTickCount();
+        for (size_t f = 0; f < frames.size(); f++)
+            mask(frames[f], binary[f]);
+        best = min(best, ((double)getTickCount() - t)/getTickFrequency());
+    }
+    return best/frames.size()*1e3;
+}
+
+int main(int argc, const char * argv[]) {
+    cout << "SSSE3: " << (HaveSsse3() ? "yes" : "no") << endl;
+    vector<Mat> frames, binary;
+    for (int a = 1; a < argc; a++) {
+        Mat img = imread(argv[a]);
+        if (img.empty()) {
+            VideoCapture cap(argv[a]);
+            for (int f = 0; f < 10 && cap.read(img); f++)
+                frames.push_back(img.clone());
+        }
+        else
+            frames.push_back(img);
+    }
+    int failures = 0;
+    for (size_t f = 0; f < frames.size(); f++) {
+        binary.push_back(Mat());
+        Preprocess(frames[f], binary[f]);
+        failures += Check(frames[f], binary[f], "frame");
+    }
+
+    // Random frames and binary images, every width from 1 to 40 (the SSSE3 loop and its scalar tail) and odd sizes
+    srand(12345);
+    bool synthetic = frames.empty();
+    int sizes[][2] = { { 1, 1 }, { 333, 17 }, { 641, 479 }, { 1919, 1081 } };
+    for (int k = 0; k < 44; k++) {
+        int cols = k < 40 ? k + 1 : sizes[k - 40][0], rows = k < 40 ? 3 : sizes[k - 40][1];
+        Mat src(rows, cols, CV_8UC3), binaryImg(rows, cols, CV_8UC1);
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < 3*cols; j++)
+                src.ptr<uchar>(i)[j] = rand() & 255;
+            for (int j = 0; j < cols; j++)
+                binaryImg.ptr<uchar>(i)[j] = rand() % 2 ? 245 + rand() % 11 : rand() & 255;
+        }
+        failures += Check(src, binaryImg, "random");
+        if (synthetic && k >= 40) {
+            frames.push_back(src);
+            binary.push_back(binaryImg);
+        }
+    }
+    cout << (failures ? "FAILED" : "MaskedCopy identical to the per-pixel reference and to copyTo with a mask") << endl;
+
+    Mat out, mask;
+    double pixels = 0;
+    for (size_t f = 0; f < frames.size(); f++)
+        pixels += frames[f].total();
+    double reference = MillisecondsPerFrame(frames, binary, [&](Mat const &src, Mat const &b) { out = SplitMergeROI(b, src); });
+    double copyTo = MillisecondsPerFrame(frames, binary, [&](Mat const &src, Mat const &b) { CopyToMasked(src, b, mask, out); });
+    double scalar = MillisecondsPerFrame(frames, binary, [&](Mat const &src, Mat const &b) { MaskedCopy(src, b, out, false); });
+    double simd = MillisecondsPerFrame(frames, binary, [&](Mat const &src, Mat const &b) { MaskedCopy(src, b, out); });
+    printf("Times per frame of %.1f Mpixel:\n", pixels/frames.size()/1e6);
+    printf("split/merge ROI() loop      %8.2f ms\n", reference);
+    printf("threshold + copyTo mask     %8.2f ms (%.1fx)\n", copyTo, reference/copyTo);
+    printf("MaskedCopy scalar           %8.2f ms (%.1fx)\n", scalar, reference/scalar);
+    printf("MaskedCopy SSSE3            %8.2f ms (%.1fx)\n", simd, reference/simd);
+    return failures ? 1 : 0;
+}
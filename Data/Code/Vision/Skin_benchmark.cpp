@@ -0,0 +1,269 @@
+//--------------------------------------------------------------------------------------------------------------------------//
+// Correctness test and micro-benchmark of SkinKernel, SkinLut and SkinIntegral against the original per-pixel GetSkin
+// loop.
+//
+// Build: g++ -O2 -std=c++11 Skin_benchmark.cpp -o Skin_benchmark `pkg-config --cflags --libs opencv`
+// Usage: ./Skin_benchmark [image or video files...]
+//
+// Every 24-bit colour is checked once (a 4096x4096 image holding all of them), then random ROIs of the given
+// images (or of the first frames of the given videos) are checked and timed. Last, the random ROIs and ROIs nested in
+// them (as CV_RETR_TREE gives) are counted from one SkinIntegral per frame and compared with GetSkin.
+//--------------------------------------------------------------------------------------------------------------------------//
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include "opencv2/opencv.hpp"
+#include "Skin_integral.h"
+#include "Skin_kernel.h"
+#include "Skin_lut.h"
+
+using namespace std;
+using namespace cv;
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: GetSkinReference
+//Input: ROI, mask output
+//Output: White pixel count of the original GetSkin (cvtColor, float HSV, NORM_MINMAX and R1/R2/R3 per pixel)
+//--------------------------------------------------------------------------------------------------------------------------//
+int GetSkinReference(Mat const &src, Mat &mask) {
+    mask.create(src.rows, src.cols, CV_8UC1);
+    Mat src_ycrcb, src_hsv;
+    cvtColor(src, src_ycrcb, CV_BGR2YCrCb);
+    src.convertTo(src_hsv, CV_32FC3);
+    cvtColor(src_hsv, src_hsv, CV_BGR2HSV);
+    normalize(src_hsv, src_hsv, 0.0, 255.0, NORM_MINMAX, CV_32FC3);
+    int WhiteCount = 0;
+    for(int i = 0; i < src.rows; i++) {
+        for(int j = 0; j < src.cols; j++) {
+            Vec3b pix_bgr = src.ptr<Vec3b>(i)[j];
+            Vec3b pix_ycrcb = src_ycrcb.ptr<Vec3b>(i)[j];
+            Vec3f pix_hsv = src_hsv.ptr<Vec3f>(i)[j];
+            bool a = R1(pix_bgr.val[2], pix_bgr.val[1], pix_bgr.val[0]);
+            bool b = R2(pix_ycrcb.val[0], pix_ycrcb.val[1], pix_ycrcb.val[2]);
+            bool c = R3(pix_hsv.val[0], pix_hsv.val[1], pix_hsv.val[2]);
+            mask.ptr<uchar>(i)[j] = (a&&b&&c) ? 255 : 0;
+            WhiteCount += a&&b&&c;
+        }
+    }
+    return WhiteCount;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: Compare
+//Input: ROI, name for the report, function count(roi, &mask) under test
+//Output: Number of pixels where its mask differs from the reference mask (0 expected)
+//--------------------------------------------------------------------------------------------------------------------------//
+template<class F>
+int Compare(Mat const &roi, string const &name, F count) {
+    Mat expected, actual;
+    int reference = GetSkinReference(roi, expected);
+    int white = count(roi, &actual);
+    int differences = 0;
+    for(int i = 0; i < roi.rows; i++)
+        for(int j = 0; j < roi.cols; j++)
+            differences += expected.ptr<uchar>(i)[j] != actual.ptr<uchar>(i)[j];
+    if (differences || white != reference)
+        cout << name << ": count " << white << ", reference " << reference << ", " << differences << " pixels differ" << endl;
+    return differences + (white != reference);
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: MegapixelsPerSecond
+//Input: ROIs, function counting skin pixels of one ROI
+//Output: Throughput over all ROIs (best of 5 runs)
+//--------------------------------------------------------------------------------------------------------------------------//
+template<class F>
+double MegapixelsPerSecond(vector<Mat> const &rois, F count) {
+    double pixels = 0, best = 1e300;
+    for (size_t k = 0; k < rois.size(); k++)
+        pixels += rois[k].total();
+    for (int run = 0; run < 5; run++) {
+        double t = (double)getTickCount();
+        volatile int white = 0;
+        for (size_t k = 0; k < rois.size(); k++)
+            white += count(rois[k]);
+        best = min(best, ((double)getTickCount() - t)/getTickFrequency());
+    }
+    return pixels/best/1e6;
+}
+
+int main(int argc, const char * argv[]) {
+    SkinKernel kernel;
+    int failures = 0;
+    cout << "AVX2: " << (SkinKernel::HaveAvx2() ? "yes" : "no") << endl;
+    SkinLut lut;
+    double start = (double)getTickCount();
+    lut.Build(kernel);
+    printf("SkinLut built in %.1f ms, %d kB\n", ((double)getTickCount() - start)*1000/getTickFrequency(), SkinLut::Bytes/1024);
+    auto kernelCount = [&](Mat const &roi, Mat *mask) { return kernel.Count(roi, mask); };
+    auto lutCount = [&](Mat const &roi, Mat *mask) { return lut.Count(roi, kernel, mask); };
+
+    // Every colour once, then the same image as 64 tiles (different NORM_MINMAX ranges)
+    Mat all(4096, 4096, CV_8UC3);
+    for (int c = 0; c < (1 << 24); c++) {
+        uchar *p = all.ptr<uchar>(c >> 12) + 3*(c & 4095);
+        p[0] = c & 255; p[1] = (c >> 8) & 255; p[2] = c >> 16;
+    }
+    vector<Mat> rois;
+    for (int t = 0; t < 64; t++)
+        rois.push_back(all(Rect((t % 8)*512, (t / 8)*512, 512, 512)));
+    for (int simd = 0; simd < 2; simd++) {
+        kernel.useSimd = simd != 0;
+        failures += Compare(all, "all colours", kernelCount);
+        for (size_t t = 0; t < rois.size(); t++)
+            failures += Compare(rois[t], "all colours tile", kernelCount);
+    }
+    failures += Compare(all, "all colours, table", lutCount);
+    Mat ycrcb;
+    cvtColor(all, ycrcb, CV_BGR2YCrCb);
+    for (int i = 0; i < all.rows; i++)
+        for (int j = 0; j < all.cols; j++) {
+            Vec3b bgr = all.ptr<Vec3b>(i)[j], yuv = ycrcb.ptr<Vec3b>(i)[j];
+            if (lut.Lookup(bgr[0], bgr[1], bgr[2]) != (R1(bgr[2], bgr[1], bgr[0]) && R2(yuv[0], yuv[1], yuv[2]))) {
+                cout << "table differs from R1 && R2 at colour " << (int)bgr[0] << "," << (int)bgr[1] << "," << (int)bgr[2] << endl;
+                failures++;
+            }
+        }
+
+    // Random ROIs of the given images/videos
+    vector<Mat> frames;
+    for (int a = 1; a < argc; a++) {
+        Mat img = imread(argv[a]);
+        if (img.empty()) {
+            VideoCapture cap(argv[a]);
+            for (int f = 0; f < 10 && cap.read(img); f++)
+                frames.push_back(img.clone());
+        }
+        else
+            frames.push_back(img);
+    }
+    if (!frames.empty())
+        rois.clear();
+    srand(12345);
+    vector<vector<Rect> > frameRects(frames.size());
+    for (size_t f = 0; f < frames.size(); f++) {
+        Mat &frame = frames[f];
+        rois.push_back(frame);
+        for (int k = 0; k < 50; k++) {
+            int w = 1 + rand() % min(frame.cols, 400), h = 1 + rand() % min(frame.rows, 400);
+            Rect rect(rand() % (frame.cols - w + 1), rand() % (frame.rows - h + 1), w, h);
+            rois.push_back(frame(rect));
+            frameRects[f].push_back(rect);
+            for (int n = 0; n < 2; n++) { // nested ROIs
+                int x = rect.x + rand() % (rect.width/2 + 1), y = rect.y + rand() % (rect.height/2 + 1);
+                rect = Rect(x, y, 1 + rand() % (rect.x + rect.width - x), 1 + rand() % (rect.y + rect.height - y));
+                frameRects[f].push_back(rect);
+            }
+        }
+    }
+    for (int simd = 0; simd < 2; simd++) {
+        kernel.useSimd = simd != 0;
+        for (size_t k = 0; k < rois.size(); k++) {
+            failures += Compare(rois[k], "roi", kernelCount);
+            failures += Compare(rois[k], "roi, table", lutCount);
+        }
+    }
+
+    // One SkinIntegral per frame for all ROIs of the frame, then one per ROI and its nested ROIs
+    SkinIntegral integral;
+    for (size_t f = 0; f < frames.size(); f++) {
+        for (int part = 0; part < 2; part++) {
+            if (part == 0)
+                integral.Compute(frames[f], kernel, frameRects[f]);
+            for (size_t k = 0; k < frameRects[f].size(); k++) {
+                Mat expected;
+                Rect const &rect = frameRects[f][k];
+                if (part == 1 && k % 3 == 0)
+                    integral.Compute(frames[f], kernel, vector<Rect>(frameRects[f].begin() + k,
+                                     frameRects[f].begin() + min(k + 3, frameRects[f].size())));
+                int reference = GetSkinReference(frames[f](rect), expected);
+                int white = integral.Count(rect, kernel);
+                if (white != reference) {
+                    cout << "SkinIntegral: count " << white << ", reference " << reference << " in ROI " << rect.x
+                         << "," << rect.y << " " << rect.width << "x" << rect.height << endl;
+                    failures++;
+                }
+            }
+        }
+        vector<double> percent;
+        integral.SkinPercents(frames[f], frameRects[f], percent, kernel);
+        for (size_t k = 0; k < frameRects[f].size(); k++) {
+            Mat roi = frames[f](frameRects[f][k]), expected;
+            if (percent[k] != (double)GetSkinReference(roi, expected)/(roi.cols*roi.rows)*100) {
+                cout << "SkinPercents differs from GetSkin in ROI " << k << endl;
+                failures++;
+            }
+        }
+    }
+    cout << (failures ? "FAILED" : "Masks and counts identical to the original GetSkin") << endl;
+
+    Mat mask;
+    double reference = MegapixelsPerSecond(rois, [&](Mat const &roi) { return GetSkinReference(roi, mask); });
+    kernel.useSimd = false;
+    double scalar = MegapixelsPerSecond(rois, [&](Mat const &roi) { return kernel.Count(roi); });
+    double table = MegapixelsPerSecond(rois, [&](Mat const &roi) { return lut.Count(roi, kernel); });
+    kernel.useSimd = true;
+    double simd = MegapixelsPerSecond(rois, [&](Mat const &roi) { return kernel.Count(roi); });
+    double tableSimd = MegapixelsPerSecond(rois, [&](Mat const &roi) { return lut.Count(roi, kernel); });
+    double candidates = MegapixelsPerSecond(rois, [&](Mat const &roi) { return lut.Candidates(roi); });
+    int rejected = 0;
+    double pixels = 0;
+    for (size_t k = 0; k < rois.size(); k++) {
+        rejected += lut.Candidates(rois[k]) == 0;
+        pixels += rois[k].total();
+    }
+    double frameCount = frames.empty() ? 1 : frames.size();
+    printf("%d of %d ROIs have no R1 && R2 pixel; times per frame of %.1f Mpixel:\n", rejected, (int)rois.size(), pixels/frameCount/1e6);
+    printf("original GetSkin loop       %8.1f Mpixel/s %8.2f ms\n", reference, pixels/frameCount/reference/1e3);
+    printf("SkinKernel scalar           %8.1f Mpixel/s %8.2f ms (%.1fx)\n", scalar, pixels/frameCount/scalar/1e3, scalar/reference);
+    printf("SkinKernel AVX2             %8.1f Mpixel/s %8.2f ms (%.1fx)\n", simd, pixels/frameCount/simd/1e3, simd/reference);
+    printf("SkinLut + kernel scalar     %8.1f Mpixel/s %8.2f ms (%.1fx)\n", table, pixels/frameCount/table/1e3, table/reference);
+    printf("SkinLut + kernel AVX2       %8.1f Mpixel/s %8.2f ms (%.1fx)\n", tableSimd, pixels/frameCount/tableSimd/1e3, tableSimd/reference);
+    printf("SkinLut lookups only        %8.1f Mpixel/s %8.2f ms (%.1fx)\n", candidates, pixels/frameCount/candidates/1e3, candidates/reference);
+
+    // All ROIs of a frame: one kernel pass per ROI against SkinIntegral::SkinPercents, for the random ROIs and for
+    // deeply nested ones (10 blobs of 10 levels each, as CV_RETR_TREE gives for rings around a person)
+    vector<vector<Rect> > nestedRects(frames.size());
+    for (size_t f = 0; f < frames.size(); f++)
+        for (int b = 0; b < 10; b++) {
+            Rect rect(rand() % max(frames[f].cols - 300, 1), rand() % max(frames[f].rows - 300, 1), 300, 300);
+            for (int level = 0; level < 10; level++, rect = Rect(rect.x + 10, rect.y + 10, rect.width - 20, rect.height - 20))
+                nestedRects[f].push_back(rect & Rect(0, 0, frames[f].cols, frames[f].rows));
+        }
+    kernel.useSimd = true;
+    for (int set = 0; set < 2 && !frames.empty(); set++) {
+        vector<vector<Rect> > const &frameSet = set ? nestedRects : frameRects;
+        double perRoi = 1e300, grouped = 1e300, rectPixels = 0, framePixels = 0;
+        size_t rects = 0;
+        for (size_t f = 0; f < frames.size(); f++) {
+            framePixels += frames[f].total();
+            rects += frameSet[f].size();
+            for (size_t k = 0; k < frameSet[f].size(); k++)
+                rectPixels += frameSet[f][k].area();
+        }
+        long queries = integral.Queries(), constant = integral.Constant();
+        vector<double> percent;
+        for (int run = 0; run < 5; run++) {
+            volatile int white = 0;
+            double t = (double)getTickCount();
+            for (size_t f = 0; f < frames.size(); f++)
+                for (size_t k = 0; k < frameSet[f].size(); k++)
+                    white += kernel.Count(frames[f](frameSet[f][k]));
+            double t1 = (double)getTickCount();
+            for (size_t f = 0; f < frames.size(); f++)
+                integral.SkinPercents(frames[f], frameSet[f], percent, kernel);
+            double t2 = (double)getTickCount();
+            perRoi = min(perRoi, (t1 - t)/getTickFrequency());
+            grouped = min(grouped, (t2 - t1)/getTickFrequency());
+        }
+        queries = integral.Queries() - queries;
+        constant = integral.Constant() - constant;
+        double n = frames.size();
+        printf("%s: %d ROIs per frame covering %.2fx the frame, %.1f%% of the grouped ones without a pixel loop\n",
+               set ? "Nested ROIs" : "Random ROIs", (int)(rects/n), rectPixels/framePixels,
+               queries ? 100.0*constant/queries : 0.0);
+        printf("SkinKernel AVX2 per ROI     %8.2f ms per frame\n", perRoi/n*1e3);
+        printf("SkinIntegral::SkinPercents  %8.2f ms per frame (%.1fx)\n", grouped/n*1e3, perRoi/grouped);
+    }
+    return failures ? 1 : 0;
+}
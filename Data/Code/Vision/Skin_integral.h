@@ -0,0 +1,281 @@
+#pragma once
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "Skin_kernel.h"
+#include "Skin_lut.h"
+
+using namespace std;
+using namespace cv;
+
+const float SkinTopHue = 350;     // a ROI whose H,S,V maximum is at least this is answered from the counts alone
+const double SkinHueMargin = 1e-3; // margin of the R3 bounds for the float rounding of normalize and convertTo
+const double SkinOverlap = 1.5;    // ROI area per covered pixel from which SkinPercents answers a group from Compute
+
+//--------------------------------------------------------------------------------------------------------------------------//
+// Skin percentage of many overlapping ROIs of one frame.
+//
+// With CV_RETR_TREE the candidate ROIs are nested and overlap, and GetSkin scanned the same pixels once per ROI.
+// SkinIntegral runs the expensive first pass of SkinKernel (R1, R2 and the float hue) once for every pixel covered by
+// a group of ROIs, and keeps the hues. The group is cut into a grid by the edges of its ROIs, so every ROI is a block
+// of grid cells, and every cell keeps the min/max of H, S and V (the NORM_MINMAX range of a ROI is the min/max of its
+// cells) and a summed-area table of three counts:
+//  - candidate: R1 && R2 (a pure function of the colour),
+//  - sure:      candidate that passes R3 for every normalization range possible when the maximum is >= SkinTopHue,
+//  - unsure:    candidate for which R3 depends on the exact range.
+// The minimum of a ROI is always in [0;1] (S <= 1) and the maximum is below 360, so with a maximum >= SkinTopHue the
+// range is in [0;1]..[SkinTopHue;360), and most hues are decided for the whole of that range. A ROI without candidates
+// has no skin, and one with such a maximum and without unsure pixels has exactly `sure` skin pixels: neither depends
+// on the ROI size. Every other ROI gets the second pass of SkinKernel (normalization and R3) over the kept hues with
+// its exact range, so the result is always the same as GetSkin's.
+//--------------------------------------------------------------------------------------------------------------------------//
+class SkinIntegral {
+public:
+    SkinIntegral() : queries(0), constant(0) {}
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Compute
+    //Input: 8-bit BGR frame, kernel, ROIs that will be queried
+    //Output: Hues of the pixels covered by the ROIs, and the range and counts of every cell of the grid of their edges.
+    //----------------------------------------------------------------------------------------------------------------------//
+    void Compute(Mat const &src, SkinKernel const &kernel, vector<Rect> const &rects) {
+        CV_Assert(src.type() == CV_8UC3);
+        Cuts(rects, true, xs);
+        Cuts(rects, false, ys);
+        size_t nx = xs.size(), ny = ys.size();
+        xIndex.assign(xs.empty() ? 0 : xs.back() - xs.front() + 1, -1);
+        yIndex.assign(ys.empty() ? 0 : ys.back() - ys.front() + 1, -1);
+        for (size_t i = 0; i < nx; i++)
+            xIndex[xs[i] - xs[0]] = (int)i;
+        for (size_t i = 0; i < ny; i++)
+            yIndex[ys[i] - ys[0]] = (int)i;
+        sums.assign(3*nx*ny, 0);
+        if (nx < 2 || ny < 2)
+            return;
+
+        // Cells covered by a ROI: +1/-1 at the corners of every ROI, then prefix sums
+        covered.assign(nx*ny, 0);
+        for (size_t k = 0; k < rects.size(); k++) {
+            if (rects[k].area() <= 0)
+                continue;
+            size_t x0 = Index(rects[k].x, xs, xIndex), x1 = Index(rects[k].x + rects[k].width, xs, xIndex);
+            size_t y0 = Index(rects[k].y, ys, yIndex), y1 = Index(rects[k].y + rects[k].height, ys, yIndex);
+            covered[y0*nx + x0]++;
+            covered[y0*nx + x1]--;
+            covered[y1*nx + x0]--;
+            covered[y1*nx + x1]++;
+        }
+        for (size_t cy = 0; cy < ny; cy++)
+            for (size_t cx = 0; cx < nx; cx++)
+                covered[cy*nx + cx] += (cx ? covered[cy*nx + cx - 1] : 0) + (cy ? covered[(cy - 1)*nx + cx] : 0)
+                                       - (cx && cy ? covered[(cy - 1)*nx + cx - 1] : 0);
+
+        // Hues, range and counts of every covered cell; sums row cy + 1, column cx + 1 holds cell cy, cx
+        width = xs.back() - xs.front();
+        hues.resize((size_t)width*(ys.back() - ys.front()));
+        lows.assign(nx*ny, numeric_limits<float>::infinity());
+        highs.assign(nx*ny, -numeric_limits<float>::infinity());
+        for (size_t cy = 0; cy + 1 < ny; cy++)
+            for (int y = ys[cy]; y < ys[cy + 1]; y++) {
+                const uchar *row = src.ptr<uchar>(y);
+                float *h = &hues[(size_t)(y - ys[0])*width] - xs[0];
+                for (size_t cx = 0; cx + 1 < nx; cx++) {
+                    size_t c = cy*nx + cx;
+                    if (!covered[c])
+                        continue;
+                    kernel.Hues(row + 3*xs[cx], xs[cx + 1] - xs[cx], h + xs[cx], lows[c], highs[c]);
+                    kernel.Tally(h + xs[cx], xs[cx + 1] - xs[cx], Limits(), &sums[3*(c + nx + 1)]);
+                }
+            }
+        for (size_t cy = 1; cy < ny; cy++)
+            for (size_t cx = 1; cx < nx; cx++)
+                for (int k = 0; k < 3; k++)
+                    sums[3*(cy*nx + cx) + k] += sums[3*((cy - 1)*nx + cx) + k] + sums[3*(cy*nx + cx - 1) + k]
+                                                - sums[3*((cy - 1)*nx + cx - 1) + k];
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Count
+    //Input: One of the ROIs of Compute, kernel for the second pass
+    //Output: Number of pixels passing R1, R2 and R3 in the rectangle, as counted by GetSkin on that ROI.
+    //----------------------------------------------------------------------------------------------------------------------//
+    int Count(Rect const &r, SkinKernel const &kernel) {
+        queries++;
+        size_t nx = xs.size();
+        size_t x0 = Index(r.x, xs, xIndex), x1 = Index(r.x + r.width, xs, xIndex);
+        size_t y0 = Index(r.y, ys, yIndex), y1 = Index(r.y + r.height, ys, yIndex);
+        int count[3];
+        for (int k = 0; k < 3; k++)
+            count[k] = sums[3*(y1*nx + x1) + k] - sums[3*(y0*nx + x1) + k] - sums[3*(y1*nx + x0) + k]
+                       + sums[3*(y0*nx + x0) + k];
+        if (count[0] == 0) {
+            constant++;
+            return 0;
+        }
+        float lo = numeric_limits<float>::infinity(), hi = -lo;
+        for (size_t cy = y0; cy < y1; cy++)
+            for (size_t cx = x0; cx < x1; cx++) {
+                lo = min(lo, lows[cy*nx + cx]);
+                hi = max(hi, highs[cy*nx + cx]);
+            }
+        if (hi >= SkinTopHue && count[2] == 0) {
+            constant++;
+            return count[1];
+        }
+        float scale, shift;
+        SkinKernel::Normalization(lo, hi, scale, shift);
+        int white = 0;
+        for (int y = r.y; y < r.y + r.height; y++)
+            white += kernel.Skin(&hues[(size_t)(y - ys[0])*width + (r.x - xs[0])], r.width, scale, shift);
+        return white;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: SkinPercent
+    //Input: One of the ROIs of Compute, kernel (see Count)
+    //Output: Percentage of the rectangle's pixels passing R1, R2 and R3.
+    //----------------------------------------------------------------------------------------------------------------------//
+    double SkinPercent(Rect const &r, SkinKernel const &kernel) {
+        return (double)Count(r, kernel)/(r.width*r.height)*100;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: SkinPercents
+    //Input: Frame, ROIs, output percentages, kernel and optional table
+    //Output: SkinPercent of every ROI. Overlapping ROIs are grouped; a group whose ROIs cover its pixels SkinOverlap
+    //        times or more is answered from one Compute over the group, the ROIs of any other group are counted
+    //        directly by the table and kernel.
+    //----------------------------------------------------------------------------------------------------------------------//
+    void SkinPercents(Mat const &src, vector<Rect> const &rects, vector<double> &percent, SkinKernel &kernel,
+                      SkinLut const *lut = 0) {
+        size_t n = rects.size();
+        percent.resize(n);
+        group.resize(n);
+        for (size_t i = 0; i < n; i++)
+            group[i] = (int)i;
+        for (size_t i = 0; i < n; i++)
+            for (size_t j = i + 1; j < n; j++)
+                if ((rects[i] & rects[j]).area() > 0)
+                    group[Root((int)j)] = Root((int)i);
+        for (size_t g = 0; g < n; g++) {
+            if (Root((int)g) != (int)g)
+                continue;
+            members.clear();
+            for (size_t i = 0; i < n; i++)
+                if (Root((int)i) == (int)g)
+                    members.push_back(rects[i]);
+            if (!Overlapping(members)) {
+                for (size_t i = 0; i < n; i++)
+                    if (Root((int)i) == (int)g) {
+                        Mat roi = src(rects[i]);
+                        int white = lut && !lut->Empty() ? lut->Count(roi, kernel) : kernel.Count(roi);
+                        percent[i] = (double)white/(roi.cols*roi.rows)*100;
+                    }
+                continue;
+            }
+            Compute(src, kernel, members);
+            for (size_t i = 0; i < n; i++)
+                if (Root((int)i) == (int)g)
+                    percent[i] = SkinPercent(rects[i], kernel);
+        }
+    }
+
+    long Queries() const { return queries; }   // Count calls
+    long Constant() const { return constant; } // of which answered from the counts alone, without a pixel loop
+
+private:
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Root
+    //Input: ROI index
+    //Output: First ROI of its group of overlapping ROIs (union-find with path halving).
+    //----------------------------------------------------------------------------------------------------------------------//
+    int Root(int i) {
+        while (group[i] != i)
+            i = group[i] = group[group[i]];
+        return i;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Overlapping
+    //Input: ROIs of one group
+    //Output: (true/false) their areas add up to SkinOverlap times their bounding box or more. Compute and the
+    //        second pass cost more than one SkinKernel::Count per pixel, so a group only pays off when the ROIs
+    //        share most of their pixels, as the nested contours of CV_RETR_TREE do.
+    //----------------------------------------------------------------------------------------------------------------------//
+    static bool Overlapping(vector<Rect> const &rects) {
+        if (rects.size() < 2)
+            return false;
+        Rect box = rects[0];
+        double area = 0;
+        for (size_t k = 0; k < rects.size(); k++) {
+            box |= rects[k];
+            area += rects[k].area();
+        }
+        return area >= SkinOverlap*box.area();
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Cuts
+    //Input: ROIs, (true/false) x or y edges, output
+    //Output: Sorted distinct left and right (or top and bottom) edges of the ROIs.
+    //----------------------------------------------------------------------------------------------------------------------//
+    static void Cuts(vector<Rect> const &rects, bool x, vector<int> &cuts) {
+        cuts.clear();
+        for (size_t k = 0; k < rects.size(); k++) {
+            if (rects[k].area() <= 0)
+                continue;
+            cuts.push_back(x ? rects[k].x : rects[k].y);
+            cuts.push_back(x ? rects[k].x + rects[k].width : rects[k].y + rects[k].height);
+        }
+        sort(cuts.begin(), cuts.end());
+        cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Index
+    //Input: Edge coordinate, cuts and their index table
+    //Output: Index of the edge in the cuts (it must be one of them).
+    //----------------------------------------------------------------------------------------------------------------------//
+    static size_t Index(int v, vector<int> const &cuts, vector<int> const &index) {
+        CV_Assert(!cuts.empty() && v >= cuts.front() && v <= cuts.back() && index[v - cuts.front()] >= 0);
+        return index[v - cuts.front()];
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Limits
+    //Input: -
+    //Output: Hue limits of SkinKernel::Tally for a ROI whose maximum is >= SkinTopHue: below sure-below or above
+    //        sure-above R3 holds for every normalization range, between none-above and none-below it never holds.
+    //----------------------------------------------------------------------------------------------------------------------//
+    static float const *Limits() {
+        // The normalized hue t = (h - lo)*255/(hi - lo) decreases with lo in [0;min(1,h)] and hi in [SkinTopHue;360]:
+        // its largest value is h*255/SkinTopHue, its smallest (h - 1)*255/359 (0 below h = 1). R3 is t < 25 || t > 230.
+        // The float limits are rounded inwards of the sure and none ranges.
+        static const float limits[4] = {
+            Below((25 - SkinHueMargin)*SkinTopHue/255), Above((230 + SkinHueMargin)*359/255 + 1),
+            Above((25 + SkinHueMargin)*359/255 + 1), Below((230 - SkinHueMargin)*SkinTopHue/255) };
+        return limits;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Below, Above
+    //Input: Limit
+    //Output: Largest float not above it, smallest float not below it.
+    //----------------------------------------------------------------------------------------------------------------------//
+    static float Below(double x) { float f = (float)x; return f > x ? nextafterf(f, -FLT_MAX) : f; }
+    static float Above(double x) { float f = (float)x; return f < x ? nextafterf(f, FLT_MAX) : f; }
+
+    vector<int> xs, ys;         // edges of the ROIs of Compute
+    vector<int> xIndex, yIndex; // index of every edge in xs/ys, by coordinate from the first one (-1 for no edge)
+    vector<int> covered;        // number of ROIs covering every cell of the grid
+    vector<int> sums;           // candidate, sure and unsure counts above and left of every grid point
+    vector<float> lows, highs;  // min/max of H,S,V of every cell
+    vector<float> hues;         // SkinKernel::Hues of the covered cells, rows of `width` from xs[0], ys[0]
+    int width;
+    vector<Rect> members;       // ROIs of one group of SkinPercents
+    vector<int> group;
+    long queries, constant;
+};
@@ -0,0 +1,407 @@
+#pragma once
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "opencv2/opencv.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SKIN_HAVE_AVX2 1
+#include <immintrin.h>
+#define SKIN_AVX2 __attribute__((target("avx2,popcnt")))
+#else
+#define SKIN_HAVE_AVX2 0
+#endif
+
+using namespace std;
+using namespace cv;
+
+//--------------------------------------------------------------------------------------------------------------------------//
+// Skin classification kernel used by GetSkin.
+//
+// GetSkin used to convert every ROI to YCrCb and to float HSV, normalize the HSV image and then test R1/R2/R3 per pixel.
+// SkinKernel gives exactly the same white pixel count (and mask) from the 8-bit BGR data in one pass:
+//  - R1 is integer math on B,G,R.
+//  - Cr and Cb are computed with the fixed point formula of cvtColor(CV_BGR2YCrCb). R2 only depends on (Cr,Cb) and
+//    its five half planes always intersect in a Cr interval, so R2 becomes a table of [low;high] Cr per Cb, built
+//    from R2 itself.
+//  - Hue, saturation and value are computed with the float formula of cvtColor(CV_BGR2HSV). R3 is applied to the
+//    hue after NORM_MINMAX over all three channels of the ROI, so the min/max are accumulated during the pass and
+//    the hue of the pixels that pass R1 and R2 is kept in a scratch row; a short second sweep over that scratch
+//    applies the normalization and R3.
+// On x86 CPUs with AVX2 (checked at run time) 8 pixels are processed at a time without branches.
+//--------------------------------------------------------------------------------------------------------------------------//
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: R1
+//Input: R,G,B values of Mat Image
+//Output: (true/false) whether the R,G,B values lies within the threshold.
+//--------------------------------------------------------------------------------------------------------------------------//
+inline bool R1(int R, int G, int B) {
+    bool e1 = (R>95) && (G>40) && (B>20) && ((max(R,max(G,B)) - min(R, min(G,B)))>15) && (abs(R-G)>15) && (R>G) && (R>B);
+    bool e2 = (R>220) && (G>210) && (B>170) && (abs(R-G)<=15) && (R>B) && (G>B);
+    return (e1||e2);
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: R2
+//Input: Y,Cr,Cb values of Mat Image
+//Output: (true/false) whether the Y,Cr,Cb values lies within the threshold.
+//--------------------------------------------------------------------------------------------------------------------------//
+inline bool R2(float Y, float Cr, float Cb) {
+    bool e3 = Cr <= 1.5862*Cb+20;
+    bool e4 = Cr >= 0.3448*Cb+76.2069;
+    bool e5 = Cr >= -4.5652*Cb+234.5652;
+    bool e6 = Cr <= -1.15*Cb+301.75;
+    bool e7 = Cr <= -2.2857*Cb+432.85;
+    return e3 && e4 && e5 && e6 && e7;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------//
+//Name: R3
+//Input: H,S,V values of Mat Image
+//Output: (true/false) whether the H,S,V values lies within the threshold.
+//--------------------------------------------------------------------------------------------------------------------------//
+inline bool R3(float H, float S, float V) {
+    return (H<25) || (H > 230);
+}
+
+class SkinKernel {
+public:
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: SkinKernel
+    //Input: -
+    //Output: Kernel with the R2 and hue tables built. Use one kernel per thread (the hue scratch is reused).
+    //----------------------------------------------------------------------------------------------------------------------//
+    SkinKernel() : useSimd(true) {
+        for (int cb = 0; cb < 256; cb++) {
+            int low = 256, high = 0;
+            for (int cr = 0; cr < 256; cr++) {
+                if (R2(0, cr, cb)) {
+                    low = min(low, cr);
+                    high = max(high, cr);
+                }
+            }
+            crRange[cb] = low | (high << 16);
+        }
+        for (int d = 0; d < 256; d++)
+            hueScale[d] = (float)(60./((float)d + FLT_EPSILON)); // same expression as cvtColor(CV_BGR2HSV) for floats
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Count
+    //Input: 8-bit BGR image (may be a ROI), optional mask output (CV_8UC1, 255 for skin, 0 otherwise).
+    //Output: Number of pixels passing R1, R2 and R3, as counted by the original GetSkin.
+    //----------------------------------------------------------------------------------------------------------------------//
+    int Count(Mat const &src, Mat *mask = 0) {
+        CV_Assert(src.type() == CV_8UC3);
+        if (mask)
+            mask->create(src.rows, src.cols, CV_8UC1);
+        return Count(src.data, src.step, src.rows, src.cols, mask ? mask->data : 0, mask ? mask->step : 0);
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Count
+    //Input: Interleaved BGR rows, optional mask rows.
+    //Output: Number of pixels passing R1, R2 and R3.
+    //----------------------------------------------------------------------------------------------------------------------//
+    int Count(const uchar *bgr, size_t step, int rows, int cols, uchar *mask = 0, size_t maskStep = 0) {
+        size_t n = (size_t)rows*cols;
+        if (n == 0)
+            return 0;
+        if (hue.size() < n)
+            hue.resize(n);
+        float lo = numeric_limits<float>::infinity(), hi = -lo;
+        for (int i = 0; i < rows; i++)
+            Hues(bgr + i*step, cols, &hue[(size_t)i*cols], lo, hi);
+        float scale, shift;
+        Normalization(lo, hi, scale, shift);
+        int white = 0;
+        for (int i = 0; i < rows; i++)
+            white += Skin(&hue[(size_t)i*cols], cols, scale, shift, mask ? mask + i*maskStep : 0);
+        return white;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Hues
+    //Input: BGR row, number of pixels, hue output, running min/max of H,S,V
+    //Output: Hue of the pixels passing R1 and R2, NaN for the rest (the first pass of Count).
+    //----------------------------------------------------------------------------------------------------------------------//
+    void Hues(const uchar *row, int cols, float *h, float &lo, float &hi) const {
+        int j = 0;
+#if SKIN_HAVE_AVX2
+        if (useSimd && HaveAvx2())
+            j = Avx2Rules(row, cols, h, lo, hi);
+#endif
+        for (; j < cols; j++)
+            h[j] = Rules(row + 3*j, lo, hi);
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Normalization
+    //Input: Min/max of H,S,V over a ROI, scale and shift output
+    //Output: normalize(..., 0, 255, NORM_MINMAX, CV_32FC3) followed by convertTo, as float math.
+    //----------------------------------------------------------------------------------------------------------------------//
+    static void Normalization(float lo, float hi, float &scale, float &shift) {
+        double s = 255.*((double)hi - lo > DBL_EPSILON ? 1./((double)hi - lo) : 0);
+        scale = (float)s;
+        shift = (float)(0 - lo*s);
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Skin
+    //Input: Hue row from Hues, normalization of the ROI, optional mask row
+    //Output: Number of pixels passing R3 on the normalized hue (the second pass of Count); mask written.
+    //----------------------------------------------------------------------------------------------------------------------//
+    int Skin(const float *h, int cols, float scale, float shift, uchar *mask = 0) const {
+        int white = 0, j = 0;
+#if SKIN_HAVE_AVX2
+        if (useSimd && HaveAvx2())
+            j = Avx2Normalized(h, cols, scale, shift, mask, white);
+#endif
+        for (; j < cols; j++) {
+            bool skin = Normalized(h[j], scale, shift); // false for NaN
+            white += skin;
+            if (mask)
+                mask[j] = skin ? 255 : 0;
+        }
+        return white;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Tally
+    //Input: Hue row from Hues, hue limits {sure below, sure above, none above, none below}, counts to increase
+    //Output: Counts of the pixels passing R1 and R2, of those with a hue below/above the sure limits, and of those
+    //        with a hue neither sure nor inside the open range of the none limits.
+    //----------------------------------------------------------------------------------------------------------------------//
+    void Tally(const float *h, int cols, float const limits[4], int count[3]) const {
+        int j = 0;
+#if SKIN_HAVE_AVX2
+        if (useSimd && HaveAvx2())
+            j = Avx2Tally(h, cols, limits, count);
+#endif
+        for (; j < cols; j++) {
+            bool candidate = h[j] == h[j]; // not NaN
+            bool sure = h[j] < limits[0] || h[j] > limits[1], none = h[j] > limits[2] && h[j] < limits[3];
+            count[0] += candidate;
+            count[1] += sure;
+            count[2] += candidate && !sure && !none;
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: R1R2
+    //Input: B,G,R values of one pixel
+    //Output: (true/false) whether R1 and R2 (on the 8-bit YCrCb of cvtColor) hold. Pure function of the colour.
+    //----------------------------------------------------------------------------------------------------------------------//
+    bool R1R2(int B, int G, int R) const {
+        int Y = (B*1868 + G*9617 + R*4899 + (1 << 13)) >> 14;
+        int Cr = min(max(((R - Y)*11682 + (128 << 14) + (1 << 13)) >> 14, 0), 255);
+        int Cb = min(max(((B - Y)*9241 + (128 << 14) + (1 << 13)) >> 14, 0), 255);
+        return R1(R, G, B) && Cr >= (crRange[Cb] & 0xffff) && Cr <= (crRange[Cb] >> 16);
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Hue
+    //Input: B,G,R values of one pixel
+    //Output: Hue (0-360) as computed by cvtColor(CV_BGR2HSV) on CV_32FC3.
+    //----------------------------------------------------------------------------------------------------------------------//
+    float Hue(int B, int G, int R) const {
+        int V = max(R, max(G, B)), Vmin = min(R, min(G, B));
+        float scale = hueScale[V - Vmin];
+        float h;
+        if (V == R)
+            h = (float)(G - B)*scale;
+        else if (V == G)
+            h = (float)(B - R)*scale + 120.f;
+        else
+            h = (float)(R - G)*scale + 240.f;
+        if (h < 0)
+            h += 360.f;
+        return h;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: HaveAvx2
+    //Input: -
+    //Output: (true/false) whether the AVX2 code path can run on this CPU.
+    //----------------------------------------------------------------------------------------------------------------------//
+    static bool HaveAvx2() {
+#if SKIN_HAVE_AVX2
+        static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+        return avx2;
+#else
+        return false;
+#endif
+    }
+
+    bool useSimd; // false forces the scalar code (for benchmarks)
+
+private:
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Rules
+    //Input: One BGR pixel, running min/max of H,S,V over the ROI.
+    //Output: Hue (0-360) if the pixel passes R1 and R2, NaN otherwise.
+    //----------------------------------------------------------------------------------------------------------------------//
+    float Rules(const uchar *p, float &lo, float &hi) const {
+        int B = p[0], G = p[1], R = p[2];
+        bool skin = R1R2(B, G, R);
+
+        int V = max(R, max(G, B)), Vmin = min(R, min(G, B));
+        float v = V, diff = (float)(V - Vmin);
+        float s = diff/(v + FLT_EPSILON);
+        float h = Hue(B, G, R);
+        lo = min(lo, min(h, min(s, v)));
+        hi = max(hi, max(h, max(s, v)));
+        return skin ? h : numeric_limits<float>::quiet_NaN();
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Normalized
+    //Input: Hue, normalization scale and shift.
+    //Output: (true/false) R3 on the normalized hue.
+    //----------------------------------------------------------------------------------------------------------------------//
+    static bool Normalized(float h, float scale, float shift) {
+        float t = h*scale; // two statements, so that it is not contracted into an FMA (convertTo does not fuse)
+        t += shift;
+        return R3(t, 0, 0);
+    }
+
+#if SKIN_HAVE_AVX2
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Avx2Rules
+    //Input: BGR row, number of pixels, hue output, running min/max.
+    //Output: Number of pixels done (a multiple of 8); hue or NaN like Rules.
+    //----------------------------------------------------------------------------------------------------------------------//
+    SKIN_AVX2 int Avx2Rules(const uchar *row, int cols, float *hueOut, float &lo, float &hi) const {
+        // Byte shuffles gathering B, G and R of 8 pixels from bytes 0-15 and 16-23
+        const __m128i b0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i b1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i g0 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i g1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i r0 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i r1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m256 nan = _mm256_set1_ps(numeric_limits<float>::quiet_NaN());
+        __m256 vlo = _mm256_set1_ps(lo), vhi = _mm256_set1_ps(hi);
+        int j = 0;
+        for (; j + 8 <= cols; j += 8) {
+            const uchar *p = row + 3*j;
+            __m128i lo16 = _mm_loadu_si128((const __m128i*)p);
+            __m128i hi8 = _mm_loadl_epi64((const __m128i*)(p + 16));
+            __m256i B = _mm256_cvtepu8_epi32(_mm_or_si128(_mm_shuffle_epi8(lo16, b0), _mm_shuffle_epi8(hi8, b1)));
+            __m256i G = _mm256_cvtepu8_epi32(_mm_or_si128(_mm_shuffle_epi8(lo16, g0), _mm_shuffle_epi8(hi8, g1)));
+            __m256i R = _mm256_cvtepu8_epi32(_mm_or_si128(_mm_shuffle_epi8(lo16, r0), _mm_shuffle_epi8(hi8, r1)));
+
+            // R1
+            __m256i V = _mm256_max_epi32(R, _mm256_max_epi32(G, B));
+            __m256i Vmin = _mm256_min_epi32(R, _mm256_min_epi32(G, B));
+            __m256i diff = _mm256_sub_epi32(V, Vmin);
+            __m256i rgFar = _mm256_cmpgt_epi32(_mm256_abs_epi32(_mm256_sub_epi32(R, G)), _mm256_set1_epi32(15));
+            __m256i rOverB = _mm256_cmpgt_epi32(R, B);
+            __m256i e1 = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(R, _mm256_set1_epi32(95)),
+                                                           _mm256_cmpgt_epi32(G, _mm256_set1_epi32(40))),
+                                          _mm256_and_si256(_mm256_cmpgt_epi32(B, _mm256_set1_epi32(20)),
+                                                           _mm256_cmpgt_epi32(diff, _mm256_set1_epi32(15))));
+            e1 = _mm256_and_si256(e1, _mm256_and_si256(_mm256_and_si256(rgFar, rOverB), _mm256_cmpgt_epi32(R, G)));
+            __m256i e2 = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(R, _mm256_set1_epi32(220)),
+                                                           _mm256_cmpgt_epi32(G, _mm256_set1_epi32(210))),
+                                          _mm256_and_si256(_mm256_cmpgt_epi32(B, _mm256_set1_epi32(170)),
+                                                           _mm256_cmpgt_epi32(G, B)));
+            e2 = _mm256_and_si256(e2, _mm256_andnot_si256(rgFar, rOverB));
+            __m256i skin = _mm256_or_si256(e1, e2);
+
+            // R2 on the 8-bit Cr, Cb of cvtColor
+            __m256i round = _mm256_set1_epi32(1 << 13), delta = _mm256_set1_epi32((128 << 14) + (1 << 13));
+            __m256i Y = _mm256_mullo_epi32(B, _mm256_set1_epi32(1868));
+            Y = _mm256_add_epi32(Y, _mm256_mullo_epi32(G, _mm256_set1_epi32(9617)));
+            Y = _mm256_add_epi32(Y, _mm256_mullo_epi32(R, _mm256_set1_epi32(4899)));
+            Y = _mm256_srli_epi32(_mm256_add_epi32(Y, round), 14);
+            __m256i Cr = _mm256_mullo_epi32(_mm256_sub_epi32(R, Y), _mm256_set1_epi32(11682));
+            Cr = _mm256_srai_epi32(_mm256_add_epi32(Cr, delta), 14);
+            __m256i Cb = _mm256_mullo_epi32(_mm256_sub_epi32(B, Y), _mm256_set1_epi32(9241));
+            Cb = _mm256_srai_epi32(_mm256_add_epi32(Cb, delta), 14);
+            __m256i zero = _mm256_setzero_si256(), top = _mm256_set1_epi32(255);
+            Cr = _mm256_min_epi32(_mm256_max_epi32(Cr, zero), top);
+            Cb = _mm256_min_epi32(_mm256_max_epi32(Cb, zero), top);
+            __m256i range = _mm256_i32gather_epi32(crRange, Cb, 4);
+            __m256i low = _mm256_and_si256(range, _mm256_set1_epi32(0xffff));
+            __m256i high = _mm256_srli_epi32(range, 16);
+            __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(low, Cr), _mm256_cmpgt_epi32(Cr, high));
+            skin = _mm256_andnot_si256(outside, skin);
+
+            // Float HSV, as cvtColor(CV_BGR2HSV) on CV_32FC3
+            __m256 b = _mm256_cvtepi32_ps(B), g = _mm256_cvtepi32_ps(G), r = _mm256_cvtepi32_ps(R);
+            __m256 v = _mm256_cvtepi32_ps(V);
+            __m256 s = _mm256_div_ps(_mm256_cvtepi32_ps(diff), _mm256_add_ps(v, _mm256_set1_ps(FLT_EPSILON)));
+            __m256 scale = _mm256_i32gather_ps(hueScale, diff, 4);
+            __m256 hr = _mm256_mul_ps(_mm256_sub_ps(g, b), scale);
+            __m256 hg = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(b, r), scale), _mm256_set1_ps(120.f));
+            __m256 hb = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(r, g), scale), _mm256_set1_ps(240.f));
+            __m256 isR = _mm256_castsi256_ps(_mm256_cmpeq_epi32(V, R));
+            __m256 isG = _mm256_castsi256_ps(_mm256_cmpeq_epi32(V, G));
+            __m256 h = _mm256_blendv_ps(_mm256_blendv_ps(hb, hg, isG), hr, isR);
+            __m256 negative = _mm256_cmp_ps(h, _mm256_setzero_ps(), _CMP_LT_OQ);
+            h = _mm256_add_ps(h, _mm256_and_ps(negative, _mm256_set1_ps(360.f)));
+            vlo = _mm256_min_ps(vlo, _mm256_min_ps(h, _mm256_min_ps(s, v)));
+            vhi = _mm256_max_ps(vhi, _mm256_max_ps(h, _mm256_max_ps(s, v)));
+            _mm256_storeu_ps(hueOut + j, _mm256_blendv_ps(nan, h, _mm256_castsi256_ps(skin)));
+        }
+        float l[8], u[8];
+        _mm256_storeu_ps(l, vlo);
+        _mm256_storeu_ps(u, vhi);
+        for (int k = 0; k < 8; k++) {
+            lo = min(lo, l[k]);
+            hi = max(hi, u[k]);
+        }
+        return j;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Avx2Normalized
+    //Input: Hue row from Avx2Rules/Rules, normalization scale and shift, optional mask row, white count.
+    //Output: Number of pixels done (a multiple of 8); white count increased, mask written.
+    //----------------------------------------------------------------------------------------------------------------------//
+    SKIN_AVX2 static int Avx2Normalized(const float *h, int cols, float scale, float shift, uchar *mask, int &white) {
+        const __m256 vscale = _mm256_set1_ps(scale), vshift = _mm256_set1_ps(shift);
+        const __m256 below = _mm256_set1_ps(25.f), above = _mm256_set1_ps(230.f);
+        int j = 0;
+        for (; j + 8 <= cols; j += 8) {
+            __m256 t = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(h + j), vscale), vshift);
+            __m256 skin = _mm256_or_ps(_mm256_cmp_ps(t, below, _CMP_LT_OQ), _mm256_cmp_ps(t, above, _CMP_GT_OQ));
+            int bits = _mm256_movemask_ps(skin);
+            white += _mm_popcnt_u32(bits);
+            if (mask) {
+                __m128i m = _mm_packs_epi32(_mm256_castsi256_si128(_mm256_castps_si256(skin)),
+                                            _mm256_extracti128_si256(_mm256_castps_si256(skin), 1));
+                _mm_storel_epi64((__m128i*)(mask + j), _mm_packs_epi16(m, m));
+            }
+        }
+        return j;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Avx2Tally
+    //Input: Hue row from Hues, hue limits, counts to increase.
+    //Output: Number of pixels done (a multiple of 8); counts increased like Tally.
+    //----------------------------------------------------------------------------------------------------------------------//
+    SKIN_AVX2 static int Avx2Tally(const float *h, int cols, float const limits[4], int count[3]) {
+        const __m256 sureBelow = _mm256_set1_ps(limits[0]), sureAbove = _mm256_set1_ps(limits[1]);
+        const __m256 noneAbove = _mm256_set1_ps(limits[2]), noneBelow = _mm256_set1_ps(limits[3]);
+        int j = 0;
+        for (; j + 8 <= cols; j += 8) {
+            __m256 v = _mm256_loadu_ps(h + j);
+            __m256 candidate = _mm256_cmp_ps(v, v, _CMP_ORD_Q);
+            __m256 sure = _mm256_or_ps(_mm256_cmp_ps(v, sureBelow, _CMP_LT_OQ), _mm256_cmp_ps(v, sureAbove, _CMP_GT_OQ));
+            __m256 none = _mm256_and_ps(_mm256_cmp_ps(v, noneAbove, _CMP_GT_OQ), _mm256_cmp_ps(v, noneBelow, _CMP_LT_OQ));
+            count[0] += _mm_popcnt_u32(_mm256_movemask_ps(candidate));
+            count[1] += _mm_popcnt_u32(_mm256_movemask_ps(sure));
+            count[2] += _mm_popcnt_u32(_mm256_movemask_ps(_mm256_andnot_ps(_mm256_or_ps(sure, none), candidate)));
+        }
+        return j;
+    }
+#endif
+
+    vector<float> hue;   // hue of the pixels passing R1 and R2, NaN for the rest
+    int crRange[256];    // R2: Cr in [crRange & 0xffff; crRange >> 16] for each Cb
+    float hueScale[256]; // 60/(max-min) of the HSV conversion, per max-min
+};
@@ -0,0 +1,132 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "Skin_kernel.h"
+
+using namespace std;
+using namespace cv;
+
+//--------------------------------------------------------------------------------------------------------------------------//
+// Precomputed skin colour table.
+//
+// R1 and R2 only depend on the B,G,R triple, so they are stored as one bit per 24-bit colour (2 MB), built once or
+// loaded from disk, and tested with a single lookup per pixel. R3 is not a function of the colour alone: it tests the
+// hue after NORM_MINMAX over the whole ROI. A ROI where no pixel passes R1 and R2 has no skin whatever R3 says, so
+// the table rejects those ROIs (most of the blobs on open water) without any colour conversion; the others are
+// counted exactly by SkinKernel. The result is always the same as GetSkin's.
+//--------------------------------------------------------------------------------------------------------------------------//
+class SkinLut {
+public:
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: SkinLut
+    //Input: -
+    //Output: Empty table (Build or Load it before use).
+    //----------------------------------------------------------------------------------------------------------------------//
+    SkinLut() {}
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Build
+    //Input: Kernel providing R1 and R2
+    //Output: Table of R1 && R2 for every colour.
+    //----------------------------------------------------------------------------------------------------------------------//
+    void Build(SkinKernel const &kernel) {
+        bits.assign(Bytes, 0);
+        for (int R = 0; R < 256; R++)
+            for (int G = 0; G < 256; G++)
+                for (int B = 0; B < 256; B++)
+                    if (kernel.R1R2(B, G, R)) {
+                        int c = Index(B, G, R);
+                        bits[c >> 3] |= 1 << (c & 7);
+                    }
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Load
+    //Input: Filename of a table written by Save
+    //Output: (true/false) whether the table was read.
+    //----------------------------------------------------------------------------------------------------------------------//
+    bool Load(string const &filename) {
+        ifstream in(filename.c_str(), ios::binary);
+        vector<uchar> data(Bytes);
+        if (!in.read((char*)&data[0], Bytes) || in.peek() != EOF)
+            return false;
+        bits.swap(data);
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Save
+    //Input: Filename
+    //Output: (true/false) whether the table was written (raw 2 MB bitset).
+    //----------------------------------------------------------------------------------------------------------------------//
+    bool Save(string const &filename) const {
+        ofstream out(filename.c_str(), ios::binary | ios::trunc);
+        return !bits.empty() && out.write((const char*)&bits[0], Bytes) && out.flush();
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Empty
+    //Input: -
+    //Output: (true/false) whether neither Build nor Load has been done.
+    //----------------------------------------------------------------------------------------------------------------------//
+    bool Empty() const { return bits.empty(); }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Lookup
+    //Input: B,G,R values of one pixel
+    //Output: (true/false) R1 && R2
+    //----------------------------------------------------------------------------------------------------------------------//
+    bool Lookup(int B, int G, int R) const {
+        int c = Index(B, G, R);
+        return (bits[c >> 3] >> (c & 7)) & 1;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Candidates
+    //Input: 8-bit BGR image (may be a ROI)
+    //Output: Number of pixels passing R1 and R2, an upper bound of the skin pixel count.
+    //----------------------------------------------------------------------------------------------------------------------//
+    int Candidates(Mat const &src) const {
+        CV_Assert(src.type() == CV_8UC3 && !bits.empty());
+        const uchar *table = &bits[0];
+        int count = 0;
+        for (int i = 0; i < src.rows; i++) {
+            const uchar *p = src.ptr<uchar>(i), *end = p + 3*src.cols;
+            for (; p != end; p += 3) {
+                int c = Index(p[0], p[1], p[2]);
+                count += (table[c >> 3] >> (c & 7)) & 1;
+            }
+        }
+        return count;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Count
+    //Input: 8-bit BGR image (may be a ROI), kernel for ROIs with candidates, optional mask output (as SkinKernel::Count)
+    //Output: Number of pixels passing R1, R2 and R3, as counted by the original GetSkin.
+    //----------------------------------------------------------------------------------------------------------------------//
+    int Count(Mat const &src, SkinKernel &kernel, Mat *mask = 0) const {
+        if (Candidates(src) == 0) {
+            if (mask) {
+                mask->create(src.rows, src.cols, CV_8UC1);
+                mask->setTo(Scalar(0));
+            }
+            return 0;
+        }
+        return kernel.Count(src, mask);
+    }
+
+    static const int Bytes = 1 << 21; // 2^24 colours, one bit each
+
+private:
+    //----------------------------------------------------------------------------------------------------------------------//
+    //Name: Index
+    //Input: B,G,R values
+    //Output: Bit number of the colour in the table.
+    //----------------------------------------------------------------------------------------------------------------------//
+    static int Index(int B, int G, int R) { return (R << 16) | (G << 8) | B; }
+
+    vector<uchar> bits;
+};
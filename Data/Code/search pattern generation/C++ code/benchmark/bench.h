@@ -0,0 +1,315 @@
+/**
+ * @file bench.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "../waypointgen1/waypointgen.h"
+#include "../waypointgen1/localframe.h"
+#include "../waypointgen1/coverage.h"
+
+using namespace std;
+
+/** @brief home First coordinate of zigzag1.kml */
+const coordinate home(55.47527419285358,10.32365339962823,24);
+/** @brief target Second coordinate of zigzag1.kml */
+const coordinate target(55.47742621920217,10.33021817870239,24);
+
+/**
+ * @brief The Stopwatch struct Wall clock timer (steady clock)
+ */
+struct Stopwatch {
+	/** @brief t0 Start time */
+	chrono::steady_clock::time_point t0;
+	/** @brief Stopwatch ctor, starts the timer */
+	Stopwatch() :t0(chrono::steady_clock::now()) { }
+	/** @brief restart Restarts the timer */
+	void restart() { t0 = chrono::steady_clock::now(); }
+	/**
+	 * @brief seconds
+	 * @return Seconds since start
+	 */
+	double seconds() const {
+		return chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+	}
+};
+
+/**
+ * @brief best_of Runs f reps times
+ * @param reps Number of repetitions
+ * @param f Function to time
+ * @return Fastest run (s)
+ */
+template<class F>
+double best_of(size_t reps, F f) {
+	double best = 1e300;
+	for(size_t r=0; r<reps; ++r) {
+		Stopwatch sw;
+		f();
+		double t = sw.seconds();
+		if(t<best)
+			best = t;
+	}
+	return best;
+}
+
+/**
+ * @brief percentile Value below which a fraction of the samples lie
+ * @param s Samples, sorted
+ * @param f Fraction (0-1)
+ * @return Percentile
+ */
+inline double percentile(const vector<double> &s, double f) {
+	return s[min(s.size()-1,static_cast<size_t>(f*(s.size()-1)+0.5))];
+}
+
+/**
+ * @brief print_latency Prints the latency distribution of a run
+ * @param name Name to print
+ * @param ms Latencies (ms), sorted in place
+ */
+inline void print_latency(const string &name, vector<double> &ms) {
+	sort(ms.begin(),ms.end());
+	printf(" %-26s %5zu updates  p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n",name.c_str(),ms.size(),
+		   percentile(ms,0.5),percentile(ms,0.99),ms.back());
+}
+
+/**
+ * @brief write_matlab_csv Writes coordinates like the MATLAB scripts do
+ * (lat,lon,alt with '%3.16g', no newline after the last line).
+ * @param filename csv filename
+ * @param coords Coordinates
+ */
+inline void write_matlab_csv(const string &filename, const MAVLink::VecCoord &coords) {
+	FILE *f = fopen(filename.c_str(),"w");
+	if(!f)
+		throw(file_error(filename,false));
+	for(size_t i=0; i<coords.size(); ++i)
+		fprintf(f,"%s%3.16g,%3.16g,%3.16g",i?"\n":"",
+				coords[i].get_lat(),coords[i].get_lon(),coords[i].get_alt());
+	fclose(f);
+}
+
+/**
+ * @brief max_difference Largest lat/lon/alt difference between two coordinate vectors
+ * @param a Coordinates
+ * @param b Coordinates
+ * @return Max difference, or infinity if the sizes differ
+ */
+inline double max_difference(const VecCoord &a, const VecCoord &b) {
+	if(a.size()!=b.size())
+		return INFINITY;
+	double m = 0;
+	for(size_t i=0; i<a.size(); ++i) {
+		m = max(m,fabs(a[i].get_lat()-b[i].get_lat()));
+		m = max(m,fabs(a[i].get_lon()-b[i].get_lon()));
+		m = max(m,fabs(a[i].get_alt()-b[i].get_alt()));
+	}
+	return m;
+}
+
+/**
+ * @brief coastline An irregular, concave search polygon: a wobbly ellipse with
+ * bays and headlands at all scales (amplitude ~ 1/frequency)
+ * @param centre Centre
+ * @param vertices Number of vertices
+ * @param area Area (m^2)
+ * @return Polygon, closed as in kml (the last vertex is the first)
+ */
+inline VecCoord coastline(const coordinate &centre, size_t vertices, double area) {
+	mt19937 rng(2016);
+	uniform_real_distribution<double> phase(0,2*M_PI);
+	vector<double> phases(200);
+	for(double &p:phases)
+		p = phase(rng);
+	vector<double> x(vertices), y(vertices);
+	double a = 0;
+	for(size_t i=0; i<vertices; ++i) {
+		double t = 2*M_PI*i/vertices;
+		double radius = 1+0.3*sin(3*t+phases[0]);
+		for(size_t f=5; f<phases.size(); ++f)
+			radius += 0.15/f*sin(f*t+phases[f]);
+		x[i] = 1.4*radius*cos(t);
+		y[i] = radius*sin(t);
+	}
+	for(size_t i=0, j=vertices-1; i<vertices; j=i++)
+		a += x[j]*y[i]-x[i]*y[j];
+	double k = sqrt(area/fabs(a/2));
+	localframe f(centre);
+	VecCoord polygon;
+	for(size_t i=0; i<vertices; ++i)
+		polygon.push_back(f.to_coordinate(k*x[i],k*y[i],0));
+	polygon.push_back(polygon.front());
+	return polygon;
+}
+
+/**
+ * @brief inside Point in polygon (crossing number)
+ * @param r Ring
+ * @param p Point
+ * @return true if inside
+ */
+inline bool inside(const Coverage::ring &r, const Coverage::point &p) {
+	bool in = false;
+	for(size_t i=0, j=r.size()-1; i<r.size(); j=i++)
+		if((r[i].y>p.y)!=(r[j].y>p.y) && p.x<r[j].x+(p.y-r[j].y)*(r[i].x-r[j].x)/(r[i].y-r[j].y))
+			in = !in;
+	return in;
+}
+
+/**
+ * @brief segment_distance Distance of a point to a segment
+ * @param p Point
+ * @param a Segment start
+ * @param b Segment end
+ * @return Distance (m)
+ */
+inline double segment_distance(const Coverage::point &p, const Coverage::point &a, const Coverage::point &b) {
+	double dx = b.x-a.x, dy = b.y-a.y, len2 = dx*dx+dy*dy;
+	double t = len2>0?max(0.0,min(1.0,((p.x-a.x)*dx+(p.y-a.y)*dy)/len2)):0;
+	return hypot(a.x+t*dx-p.x,a.y+t*dy-p.y);
+}
+
+/**
+ * @brief covered Fraction of random points in the polygon within reach of a track piece
+ * @param r Ring
+ * @param segments Pairs of track piece ends
+ * @param reach Half the swath width (m)
+ * @param samples Number of points
+ * @return Fraction covered
+ */
+inline double covered(const Coverage::ring &r, const vector<Coverage::point> &segments, double reach, size_t samples) {
+	double x0 = r[0].x, x1 = r[0].x, y0 = r[0].y, y1 = r[0].y;
+	for(const Coverage::point &p:r) {
+		x0 = min(x0,p.x);
+		x1 = max(x1,p.x);
+		y0 = min(y0,p.y);
+		y1 = max(y1,p.y);
+	}
+	mt19937 rng(4711);
+	uniform_real_distribution<double> ux(x0,x1), uy(y0,y1);
+	size_t hits = 0;
+	for(size_t n=0; n<samples; ) {
+		Coverage::point p{ux(rng),uy(rng)};
+		if(!inside(r,p))
+			continue;
+		++n;
+		for(size_t i=0; i+1<segments.size(); i+=2)
+			if(segment_distance(p,segments[i],segments[i+1])<=reach+1e-9) {
+				++hits;
+				break;
+			}
+	}
+	return static_cast<double>(hits)/samples;
+}
+
+/**
+ * @brief bench_patterns Pattern generation vs. csv import (Patterngen)
+ * @param args [directory with MATLAB csv files to validate against]
+ * @return 0 on success
+ */
+int bench_patterns(const vector<string> &args);
+
+/**
+ * @brief bench_kml kml coordinate extraction throughput (Coordstream vs. Kmlmanip)
+ * @param args [directory with zigzag1.kml to validate against]
+ * @return 0 on success
+ */
+int bench_kml(const vector<string> &args);
+
+/**
+ * @brief bench_csv csv coordinate import throughput (Coordstream vs. Kmlmanip)
+ * @param args [directory with MATLAB csv files to validate against]
+ * @return 0 on success
+ */
+int bench_csv(const vector<string> &args);
+
+/**
+ * @brief bench_wpl Waypoint file writing (Wplwriter vs. autopath::save), with byte equality check
+ * @param args [directory with MATLAB csv files]
+ * @return 0 on success
+ */
+int bench_wpl(const vector<string> &args);
+
+/**
+ * @brief bench_soa Memory and throughput of soa_autopath vs. autopath on 1M waypoints
+ * @param args unused
+ * @return 0 on success
+ */
+int bench_soa(const vector<string> &args);
+
+/**
+ * @brief bench_utm Batched UTM conversion accuracy and points/s (scalar vs. AVX2)
+ * @param args [directory with MATLAB csv files to validate against]
+ * @return 0 on success
+ */
+int bench_utm(const vector<string> &args);
+
+/**
+ * @brief bench_geotag Detection geotagging checks and detection-to-mission-file latency
+ * @param args [pose log csv (time,lat,lon,alt,roll,pitch,yaw); default: a synthetic flight]
+ * @return 0 on success
+ */
+int bench_geotag(const vector<string> &args);
+
+/**
+ * @brief bench_wplfile Incremental waypoint file checks and append/patch latency vs. full save
+ * @param args unused
+ * @return 0 on success
+ */
+int bench_wplfile(const vector<string> &args);
+
+/**
+ * @brief bench_mavlink MAVLink v2 MISSION_ITEM_INT known-good frames, round trip and items/s
+ * @param args unused
+ * @return 0 on success
+ */
+int bench_mavlink(const vector<string> &args);
+
+/**
+ * @brief bench_simplify Douglas-Peucker reduction and deviation on the patterns, serial vs. threads
+ * @param args [csvdir]
+ * @return 0 on success
+ */
+int bench_simplify(const vector<string> &args);
+
+/**
+ * @brief bench_coverage Polygon lawnmower planning: direction, cells, coverage and planning time
+ * @param args unused
+ * @return 0 on success
+ */
+int bench_coverage(const vector<string> &args);
+
+/**
+ * @brief bench_partition Multi-aircraft partitioning: balance, coverage, files and planning time vs. threads
+ * @param args unused
+ * @return 0 on success
+ */
+int bench_partition(const vector<string> &args);
+
+/**
+ * @brief bench_route Point of interest ordering: optimality checks, route length reduction and time
+ * @param args unused
+ * @return 0 on success
+ */
+int bench_route(const vector<string> &args);
+
+/**
+ * @brief bench_check Mission validation: distances, turns, geofence and swap checks, legs/s scalar vs. AVX2
+ * @param args unused
+ * @return 0 on success
+ */
+int bench_check(const vector<string> &args);
+
+/**
+ * @brief bench_index Spatial index over waypoints and legs: query checks and time vs. brute force
+ * @param args unused
+ * @return 0 on success
+ */
+int bench_index(const vector<string> &args);
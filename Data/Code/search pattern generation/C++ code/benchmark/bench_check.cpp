@@ -0,0 +1,192 @@
+/**
+ * @file bench_check.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "../waypointgen1/missioncheck.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief spiral Spiral mission around home, one waypoint every step metres
+ * @param n Number of waypoints
+ * @param spacing Distance between the turns of the spiral (m)
+ * @param step Distance between waypoints (m)
+ * @return Coordinates
+ */
+VecCoord spiral(size_t n, double spacing, double step) {
+	localframe f(home);
+	VecCoord c;
+	c.reserve(n);
+	double theta = 2*M_PI;
+	for(size_t i=0; i<n; ++i) {
+		double r = spacing*theta/(2*M_PI);
+		c.push_back(f.to_coordinate(r*cos(theta),r*sin(theta),50+(i%100)*0.1));
+		theta += step/r;
+	}
+	return c;
+}
+
+/**
+ * @brief circle Polygon around home
+ * @param radius Radius (m)
+ * @param vertices Number of vertices
+ * @return Polygon
+ */
+VecCoord circle(double radius, size_t vertices) {
+	localframe f(home);
+	VecCoord c;
+	for(size_t i=0; i<vertices; ++i)
+		c.push_back(f.to_coordinate(radius*cos(2*M_PI*i/vertices),radius*sin(2*M_PI*i/vertices),0));
+	return c;
+}
+
+/**
+ * @brief swap_lat_lon The mistake of a KML file written latitude first
+ * @param c Coordinates
+ * @return Coordinates with latitude and longitude exchanged
+ */
+VecCoord swap_lat_lon(const VecCoord &c) {
+	VecCoord s;
+	for(const coordinate &p:c)
+		s.emplace_back(p.get_lon(),p.get_lat(),p.get_alt());
+	return s;
+}
+
+/**
+ * @brief same Compares reports of the same mission
+ * @param a Report
+ * @param b Report
+ * @return true if equal, sums to 1e-9
+ */
+bool same(const Missioncheck::report &a, const Missioncheck::report &b) {
+	return fabs(a.distance-b.distance)<=1e-9*a.distance && fabs(a.flight_distance-b.flight_distance)<=1e-9*a.flight_distance
+			&& fabs(a.turns-b.turns)<=1e-9*max(1.0,a.turns) && fabs(a.max_leg-b.max_leg)<=1e-9*a.max_leg
+			&& a.max_leg_index==b.max_leg_index && a.duplicates==b.duplicates && a.zero_legs==b.zero_legs
+			&& a.invalid==b.invalid && a.outside==b.outside && a.crossing==b.crossing && a.swapped==b.swapped;
+}
+
+/**
+ * @brief brute_force Waypoints outside and legs crossing a fence, testing every edge
+ * @param c Mission
+ * @param fence Geofence (only its ring and frame are used)
+ * @param outside Output: Waypoints outside
+ * @param crossing Output: Legs crossing the outline
+ */
+void brute_force(const VecCoord &c, const Missioncheck::geofence &fence, vector<size_t> &outside,
+				 vector<size_t> &crossing) {
+	const Coverage::ring &r = fence.ring;
+	vector<Coverage::point> p(c.size());
+	for(size_t i=0; i<c.size(); ++i)
+		fence.frame.to_local(c[i],p[i].x,p[i].y);
+	for(size_t i=0; i<p.size(); ++i) {
+		bool in = false;
+		for(size_t k=0, j=r.size()-1; k<r.size(); j=k++)
+			if((r[k].y>p[i].y)!=(r[j].y>p[i].y) && p[i].x<r[j].x+(p[i].y-r[j].y)*(r[k].x-r[j].x)/(r[k].y-r[j].y))
+				in = !in;
+		if(!in)
+			outside.push_back(i);
+		if(i==0)
+			continue;
+		const Coverage::point &a = p[i-1], &b = p[i];
+		for(size_t k=0; k<r.size(); ++k) {
+			const Coverage::point &u = r[k], &v = r[(k+1)%r.size()];
+			double o1 = (b.x-a.x)*(u.y-a.y)-(b.y-a.y)*(u.x-a.x), o2 = (b.x-a.x)*(v.y-a.y)-(b.y-a.y)*(v.x-a.x);
+			double o3 = (v.x-u.x)*(a.y-u.y)-(v.y-u.y)*(a.x-u.x), o4 = (v.x-u.x)*(b.y-u.y)-(v.y-u.y)*(b.x-u.x);
+			if(((o1<0 && o2>0) || (o1>0 && o2<0)) && ((o3<0 && o4>0) || (o3>0 && o4<0))) {
+				crossing.push_back(i-1);
+				break;
+			}
+		}
+	}
+}
+} //namespace
+
+int bench_check(const vector<string> &) {
+	int failures = 0;
+	const Missioncheck::settings s(10,4);
+
+	//Quarter of a great circle, and one degree of latitude.
+	double q = Missioncheck::haversine(0,0,0,90), d = Missioncheck::haversine(55,10,56,10);
+	bool ok = fabs(q-Missioncheck::earth_radius*M_PI/2)<1e-6 && fabs(d-Missioncheck::earth_radius*M_PI/180)<1e-6;
+	printf(" %-44s %.3f km, %.3f m %s\n","equator quarter, 1 degree of latitude",q/1e3,d,ok?"ok":"WRONG");
+	failures += !ok;
+
+	//100 m east, a duplicate, 5 cm east, 100 m north: a right angle and two bad legs.
+	{
+		localframe f(home);
+		VecCoord c = {f.to_coordinate(0,0,50),f.to_coordinate(100,0,50),f.to_coordinate(100,0,50),
+					  f.to_coordinate(100.05,0,50),f.to_coordinate(100.05,100,50)};
+		Missioncheck::report r = Missioncheck::check(autopath(c),s);
+		//The haversine sphere is 0.2% smaller than the WGS84 radii of localframe here.
+		ok = fabs(r.distance-200.05)<1e-2*200.05 && r.duplicates==vector<size_t>{1} && r.zero_legs==vector<size_t>{2}
+				&& fabs(r.turns-0.5)<1e-3 && fabs(r.time-(r.flight_distance/10+2))<1e-9 && r.max_leg_index==3
+				&& Missioncheck::problems(r,s).size()==2;
+		printf(" %-44s %.2f m, %.2f turns, %.2f s, %zu problems %s\n","right angle, duplicate, zero-length leg",
+			   r.distance,r.turns,r.time,Missioncheck::problems(r,s).size(),ok?"ok":"WRONG");
+		failures += !ok;
+	}
+
+	//Random legs in a concave fence: banded tests against every edge.
+	const VecCoord area = coastline(home,2000,10e6);
+	const Missioncheck::geofence coast(area);
+	{
+		mt19937 rng(11);
+		uniform_real_distribution<double> u(-2500,2500);
+		localframe f(home);
+		VecCoord c;
+		for(size_t i=0; i<20000; ++i)
+			c.push_back(f.to_coordinate(u(rng),u(rng),50));
+		vector<size_t> outside, crossing;
+		brute_force(c,coast,outside,crossing);
+		Missioncheck::report r = Missioncheck::check(autopath(c),s,&coast);
+		ok = r.outside==outside && r.crossing==crossing && !r.swapped;
+		printf(" %-44s %zu outside, %zu crossing %s\n","20000 random waypoints vs. coastline",r.outside.size(),
+			   r.crossing.size(),ok?"ok":"WRONG");
+		failures += !ok;
+	}
+
+	//Swapped latitude and longitude: caught by the fence, or by the range without one.
+	{
+		VecCoord c = spiral(10000,20,5);
+		const Missioncheck::geofence fence(circle(2000,64));
+		Missioncheck::report good = Missioncheck::check(autopath(c),s,&fence);
+		Missioncheck::report bad = Missioncheck::check(autopath(swap_lat_lon(c)),s,&fence);
+		VecCoord sydney{coordinate(-33.86,151.21,50),coordinate(-33.87,151.22,50)};
+		Missioncheck::report range = Missioncheck::check(autopath(swap_lat_lon(sydney)),s);
+		ok = good.outside.empty() && good.crossing.empty() && !good.swapped && bad.swapped
+				&& range.swapped && range.invalid.size()==2 && !Missioncheck::check(autopath(sydney),s).swapped;
+		printf(" %-44s fence: %s, range: %s %s\n","swapped latitude and longitude",bad.swapped?"swapped":"-",
+			   range.swapped?"swapped":"-",ok?"ok":"WRONG");
+		failures += !ok;
+	}
+
+	//1M waypoints: scalar vs. AVX2, arrays vs. autopath, with and without a fence.
+	const size_t n = 1000000;
+	VecCoord c = spiral(n,20,2);
+	c[1000] = c[999];
+	c[300001] = c[300000];
+	autopath ap(c);
+	MAVLink::soa_autopath soa(c);
+	const Missioncheck::geofence fence(circle(5000,2000));
+	Missioncheck::report scalar, simd, from_autopath, fenced;
+	const size_t reps = 5;
+	double t_scalar = best_of(reps,[&]{ scalar = Missioncheck::check(soa.lat.data(),soa.lon.data(),soa.alt.data(),n,s,
+																	   nullptr,false); });
+	double t_simd = best_of(reps,[&]{ simd = Missioncheck::check(soa,s); });
+	double t_autopath = best_of(reps,[&]{ from_autopath = Missioncheck::check(ap,s); });
+	double t_fence = best_of(reps,[&]{ fenced = Missioncheck::check(soa,s,&fence); });
+	ok = same(scalar,simd) && same(simd,from_autopath) && simd.duplicates==vector<size_t>{999,300000}
+			&& simd.zero_legs.empty() && fenced.outside.empty() && fenced.crossing.empty();
+	printf("Spiral of %zu waypoints: %.1f km, longest leg %.2f m, %.1f reversals, %.2f h at %.0f m/s %s\n",n,
+		   simd.distance/1e3,simd.max_leg,simd.turns,simd.time/3600,s.speed,ok?"ok":"WRONG");
+	failures += !ok;
+	printf(" scalar               %7.2f ms %6.1f M legs/s\n",1e3*t_scalar,n/t_scalar/1e6);
+	printf(" AVX2%-16s %7.2f ms %6.1f M legs/s\n",UTM::have_avx2()?"":" (unsupported)",1e3*t_simd,n/t_simd/1e6);
+	printf(" autopath (gather)    %7.2f ms %6.1f M legs/s\n",1e3*t_autopath,n/t_autopath/1e6);
+	printf(" with geofence (2000) %7.2f ms %6.1f M legs/s\n",1e3*t_fence,n/t_fence/1e6);
+	return failures;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file bench_coverage.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "../waypointgen1/coverage.h"
+
+using namespace std;
+
+namespace {
+typedef Coverage::point point;
+typedef Coverage::ring ring;
+
+/**
+ * @brief boundary_distance Distance of a point to the polygon outline
+ * @param r Ring
+ * @param p Point
+ * @return Distance (m)
+ */
+double boundary_distance(const ring &r, const point &p) {
+	double d = numeric_limits<double>::max();
+	for(size_t i=0, j=r.size()-1; i<r.size(); j=i++)
+		d = min(d,segment_distance(p,r[j],r[i]));
+	return d;
+}
+
+/**
+ * @brief on_boundary Checks that every track piece starts and ends on the outline
+ * @param r Ring
+ * @param path Path from Coverage::sweep
+ * @return Largest distance to the outline (m)
+ */
+double on_boundary(const ring &r, const vector<point> &path) {
+	double worst = 0;
+	for(const point &p:path)
+		worst = max(worst,boundary_distance(r,p));
+	return worst;
+}
+
+/**
+ * @brief rotated Rectangle centred on the origin
+ * @param w Width along the angle (m)
+ * @param h Height (m)
+ * @param angle Angle (degrees counterclockwise from east)
+ * @return Ring
+ */
+ring rotated(double w, double h, double angle) {
+	double c = cos(angle*(M_PI/180)), s = sin(angle*(M_PI/180));
+	ring r;
+	for(auto xy:{make_pair(-w/2,-h/2),make_pair(w/2,-h/2),make_pair(w/2,h/2),make_pair(-w/2,h/2)})
+		r.push_back(point{xy.first*c-xy.second*s,xy.first*s+xy.second*c});
+	return r;
+}
+
+/**
+ * @brief check Plans a ring and checks the plan
+ * @param name Name to print
+ * @param r Ring
+ * @param spacing Track spacing (m)
+ * @param expected_angle Expected angle (negative: any)
+ * @param expected_cells Expected number of cells (0: any)
+ * @param min_covered Smallest fraction covered
+ * @return true if ok
+ */
+bool check(const char *name, const ring &r, double spacing, double expected_angle, size_t expected_cells,
+		   double min_covered) {
+	Coverage::report rep;
+	double angle = Coverage::best_angle(r,spacing);
+	vector<point> path = Coverage::sweep(r,spacing,angle,r[0],&rep);
+	double cov = covered(r,path,spacing/2,20000);
+	double off = on_boundary(r,path);
+	bool ok = (expected_angle<0 || fabs(angle-expected_angle)<1e-6 || fabs(angle-expected_angle-180)<1e-6)
+			&& (expected_cells==0 || rep.cells==expected_cells) && cov>=min_covered && off<1e-6
+			&& rep.tracks==Coverage::count_tracks(r,spacing,angle) && path.size()==2*rep.tracks;
+	printf(" %-28s %6.1f deg %4zu tracks %3zu cells, %6.2f%% covered %s\n",name,angle,rep.tracks,rep.cells,
+		   100*cov,ok?"ok":"WRONG");
+	return ok;
+}
+} //namespace
+
+int bench_coverage(const vector<string> &) {
+	int failures = 0;
+	const double spacing = 20;
+	failures += !check("rectangle 1000x500 m",rotated(1000,500,0),spacing,0,1,1);
+	failures += !check("rectangle, rotated 30 deg",rotated(1000,500,30),spacing,30,1,1);
+	failures += !check("rectangle, rotated 125 deg",rotated(1000,500,125),spacing,125,1,1);
+	ring u = {{0,0},{600,0},{600,400},{400,400},{400,100},{200,100},{200,400},{0,400}};
+	failures += !check("U, notch from the top",u,spacing,90,1,1);
+	ring h = {{0,0},{200,0},{200,150},{400,150},{400,0},{600,0},{600,400},{400,400},{400,250},{200,250},{200,400},{0,400}};
+	failures += !check("H, two notches",h,spacing,-1,0,1);
+	const VecCoord polygon = coastline(home,2000,10e6);
+	const ring coast = Coverage::to_local(polygon,localframe(polygon.front()));
+	failures += !check("coastline, 2000 vertices",coast,spacing,-1,0,0.99);
+
+	//From coordinates to coordinates.
+	Coverage::report rep;
+	VecCoord path;
+	const size_t reps = 10;
+	double t = best_of(reps,[&]{ path = Coverage::lawnmower_coordinates(polygon,spacing,50,&rep,&home); });
+	autopath ap = Coverage::lawnmower(polygon,spacing,50);
+	bool ok = ap.size()==path.size() && path.size()==2*rep.tracks && path.front().get_alt()==50;
+	printf("Coastline of %.1f km2, %zu vertices, %.0f m spacing: %zu waypoints, %.1f km %s\n",rep.area/1e6,
+		   coast.size(),spacing,path.size(),rep.length/1e3,ok?"ok":"WRONG");
+	failures += !ok;
+	printf(" planned in %.2f ms (projection, direction and tracks)\n",1e3*t);
+	size_t scanned = numeric_limits<size_t>::max();
+	double scanned_angle = 0;
+	for(int a=0; a<180; ++a) {
+		size_t n = Coverage::count_tracks(coast,spacing,a);
+		if(n<scanned) {
+			scanned = n;
+			scanned_angle = a;
+		}
+	}
+	printf(" track pieces: %zu at %.1f deg (chosen), %zu east-west, %zu north-south, %zu best of 1 deg scan (%.0f deg)\n",
+		   rep.tracks,rep.angle,Coverage::count_tracks(coast,spacing,0),Coverage::count_tracks(coast,spacing,90),
+		   scanned,scanned_angle);
+	return failures;
+}
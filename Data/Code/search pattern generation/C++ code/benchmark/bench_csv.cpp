@@ -0,0 +1,79 @@
+/**
+ * @file bench_csv.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "../waypointgen1/coordstream.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief survey_grid A regular grid of coordinates
+ * @param rows Number of coordinates
+ * @return Coordinates
+ */
+VecCoord survey_grid(size_t rows) {
+	VecCoord c;
+	c.reserve(rows);
+	for(size_t i=0; i<rows; ++i)
+		c.emplace_back(55.47+1e-5*(i/1000),10.32+1e-5*(i%1000),24);
+	return c;
+}
+
+/**
+ * @brief file_size
+ * @param filename Name of file
+ * @return Size in bytes
+ */
+size_t file_size(const string &filename) {
+	mapped_file m(filename);
+	return m.size();
+}
+} //namespace
+
+int bench_csv(const vector<string> &args) {
+	int failures = 0;
+	if(!args.empty()) {
+		for(const char *name:{"spiral1_30m.csv","zigzag1_10degrees.csv","sector1.csv"}) {
+			string csvfile = args[0]+"/"+name;
+			double d = max_difference(Coordstream::csv_extract_coordinates(csvfile),
+									  Kmlmanip::csv_extract_coordinates(csvfile));
+			printf(" %s: max difference %.3g %s\n",csvfile.c_str(),d,d==0?"OK":"MISMATCH");
+			failures += d!=0;
+		}
+	}
+
+	//Trailing blank lines, CRLF and blanks around numbers.
+	const string csvfile = "bench_csv.csv";
+	FILE *f = fopen(csvfile.c_str(),"w");
+	if(!f)
+		throw(file_error(csvfile,false));
+	fprintf(f,"55.1,10.2, 24\r\n 55.3 ,10.4,\t25\n\n\r\n");
+	fclose(f);
+	VecCoord t = Coordstream::csv_extract_coordinates(csvfile);
+	bool ok = t.size()==2 && t[1].get_lat()==55.3 && t[1].get_alt()==25;
+	ok = ok && max_difference(t,Kmlmanip::csv_extract_coordinates(csvfile))==0;
+	printf(" trailing blank lines: %s\n",ok?"OK":"FAILED");
+	failures += !ok;
+
+	const size_t rows = 500000;
+	const size_t reps = 5;
+	write_matlab_csv(csvfile,survey_grid(rows));
+	double mb = file_size(csvfile)/1e6;
+	double d = max_difference(Coordstream::csv_extract_coordinates(csvfile),survey_grid(rows));
+	printf("Survey grid, %.1f MB, %zu rows: max difference %.3g %s\n",mb,rows,d,d<1e-12?"OK":"MISMATCH");
+	failures += !(d<1e-12);
+
+	size_t sink = 0;
+	double t_old = best_of(reps,[&]{ sink += Kmlmanip::csv_extract_coordinates(csvfile).size(); });
+	double t_new = best_of(reps,[&]{ sink += Coordstream::csv_extract_coordinates(csvfile).size(); });
+	remove(csvfile.c_str());
+
+	printf(" Kmlmanip::csv_extract_coordinates     %8.1f MB/s %8.2f Mrows/s\n",mb/t_old,rows/t_old/1e6);
+	printf(" Coordstream::csv_extract_coordinates  %8.1f MB/s %8.2f Mrows/s\n",mb/t_new,rows/t_new/1e6);
+	printf(" speedup                               %8.1fx\n",t_old/t_new);
+	return failures+(sink==0);
+}
@@ -0,0 +1,194 @@
+/**
+ * @file bench_geotag.cpp
+ * @author Mikael Westermann
+ */
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include "bench.h"
+#include "../waypointgen1/geotag.h"
+#include "../waypointgen1/mappedfile.h"
+#include "../waypointgen1/patterngen.h"
+#include "../waypointgen1/wplwriter.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief pixel_of Projects a ground coordinate into the camera (inverse of Geotag::project)
+ * @param cam Camera
+ * @param p Pose
+ * @param g Ground coordinate
+ * @param ground_alt Ground altitude
+ * @param u Output: Pixel x
+ * @param v Output: Pixel y
+ */
+void pixel_of(const Geotag::camera &cam, const Geotag::pose &p, const coordinate &g, double ground_alt,
+			  double &u, double &v) {
+	coordinate a(p.lat,p.lon,p.alt);
+	double north = Geotag::distance(a,coordinate(g.get_lat(),p.lon,0))*(g.get_lat()<p.lat?-1:1);
+	double east = Geotag::distance(a,coordinate(p.lat,g.get_lon(),0))*(g.get_lon()<p.lon?-1:1);
+	double ned[3] = { north, east, p.alt-ground_alt };
+	//body = R^T ned
+	double r = p.roll*(M_PI/180), q = p.pitch*(M_PI/180), y = p.yaw*(M_PI/180);
+	double cr = cos(r), sr = sin(r), cq = cos(q), sq = sin(q), cy = cos(y), sy = sin(y);
+	double b0 = cq*cy*ned[0]+cq*sy*ned[1]-sq*ned[2];
+	double b1 = (sr*sq*cy-cr*sy)*ned[0]+(sr*sq*sy+cr*cy)*ned[1]+sr*cq*ned[2];
+	double b2 = (cr*sq*cy+sr*sy)*ned[0]+(cr*sq*sy-sr*cy)*ned[1]+cr*cq*ned[2];
+	double tilt = cam.tilt*(M_PI/180);
+	double c0 = b0*cos(tilt)-b2*sin(tilt), c2 = b0*sin(tilt)+b2*cos(tilt);
+	u = cam.cx+cam.fx*b1/c2;
+	v = cam.cy-cam.fy*c0/c2;
+}
+
+/**
+ * @brief synthetic_log Writes a 10 Hz pose log of a flight along a path
+ * @param filename csv filename
+ * @param path Path to fly (altitude: ground)
+ * @param height Height above the path (m)
+ * @param speed Ground speed (m/s)
+ */
+void synthetic_log(const string &filename, const VecCoord &path, double height, double speed) {
+	FILE *f = fopen(filename.c_str(),"w");
+	if(!f)
+		throw(file_error(filename,false));
+	fprintf(f,"time,lat,lon,alt,roll,pitch,yaw\n");
+	double t = 0;
+	for(size_t i=0; i+1<path.size(); ++i) {
+		const coordinate &a = path[i], &b = path[i+1];
+		double len = Geotag::distance(a,b);
+		double yaw = atan2((b.get_lon()-a.get_lon())*cos(a.get_lat()*(M_PI/180)),b.get_lat()-a.get_lat())*(180/M_PI);
+		for(double s=0; s<len; s+=speed*0.1, t+=0.1) {
+			double f_ = s/len;
+			fprintf(f,"%.2f,%.12f,%.12f,%.3f,%.3f,%.3f,%.3f\n",t,
+					a.get_lat()+f_*(b.get_lat()-a.get_lat()),a.get_lon()+f_*(b.get_lon()-a.get_lon()),
+					a.get_alt()+height+2*sin(0.3*t),12*sin(0.7*t),4*sin(1.1*t),fmod(yaw+360,360.0));
+		}
+	}
+	fclose(f);
+}
+} //namespace
+
+int bench_geotag(const vector<string> &args) {
+	int failures = 0;
+	const double ground_alt = 24;
+	Geotag::camera cam{1400,1400,960,540,0};
+
+	//Straight down from a level aircraft, the image centre is below the aircraft.
+	Geotag::pose level{0,home.get_lat(),home.get_lon(),124,0,0,37};
+	coordinate c(0,0,0);
+	bool ok = Geotag::project(cam,level,960,540,ground_alt,c) && Geotag::distance(home,c)<1e-6;
+	//Top of the image is ahead: 100 m up, 540 px at f=1400 -> 38.57 m along the heading.
+	ok = ok && Geotag::project(cam,level,960,0,ground_alt,c) && fabs(Geotag::distance(home,c)-100*540/1400.0)<1e-3;
+	printf(" %-40s %s\n","nadir and image top, level flight",ok?"ok":"WRONG");
+	failures += !ok;
+
+	//Random attitudes, both camera mountings: project and back to the pixel.
+	mt19937 rng(12345);
+	uniform_real_distribution<double> unit(0,1);
+	double worst = 0;
+	size_t misses = 0;
+	for(int tilt=0; tilt<=20; tilt+=20) {
+		cam.tilt = tilt;
+		for(int i=0; i<10000; ++i) {
+			Geotag::pose p{0,home.get_lat(),home.get_lon(),ground_alt+30+200*unit(rng),
+						   30*unit(rng)-15,30*unit(rng)-15,360*unit(rng)};
+			double u = 1920*unit(rng), v = 1080*unit(rng), u2, v2;
+			if(!Geotag::project(cam,p,u,v,ground_alt,c)) {
+				++misses;
+				continue;
+			}
+			pixel_of(cam,p,c,ground_alt,u2,v2);
+			worst = max(worst,max(fabs(u-u2),fabs(v-v2)));
+		}
+	}
+	cam.tilt = 0;
+	ok = worst<1e-6;
+	printf(" %-40s max %.2e px (%zu rays above the horizon) %s\n","pixel -> ground -> pixel",worst,misses,ok?"ok":"WRONG");
+	failures += !ok;
+
+	Geotag::poselog wrap;
+	wrap.add(Geotag::pose{0,0,0,0,0,0,350});
+	wrap.add(Geotag::pose{1,0,0,0,0,0,10});
+	ok = fabs(wrap.at(0.5).yaw)<1e-9 && fabs(wrap.at(0.75).yaw-5)<1e-9;
+	printf(" %-40s %s\n","yaw interpolation across north",ok?"ok":"WRONG");
+	failures += !ok;
+
+	//Pose log: the given one, or a flight along a 30 m spiral at 15 m/s, 100 m up.
+	const autopath mission = Patterngen::spiral(home,target,30);
+	string logfile = "bench_geotag_poses.csv";
+	bool recorded = !args.empty() && args[0].size()>4 && args[0].substr(args[0].size()-4)==".csv";
+	if(recorded)
+		logfile = args[0];
+	else {
+		VecCoord route;
+		for(const waypoint &w:mission)
+			route.push_back(w.my_cmd.coord);
+		synthetic_log(logfile,route,100,15);
+	}
+	Geotag::poselog log;
+	Stopwatch sw;
+	log.load(logfile);
+	double t_load = sw.seconds();
+	if(!recorded)
+		remove(logfile.c_str());
+	printf("Pose log %s: %zu poses, %.1f s, loaded in %.2f ms\n",recorded?logfile.c_str():"(synthetic)",
+		   log.size(),log[log.size()-1].t-log[0].t,1e3*t_load);
+
+	//Detections at random times and pixels, in the order a video would give them.
+	const size_t n = 2000;
+	vector<double> times(n);
+	for(double &t:times)
+		t = log[0].t+(log[log.size()-1].t-log[0].t)*unit(rng);
+	sort(times.begin(),times.end());
+	vector<pair<double,double>> pixels(n);
+	for(auto &px:pixels)
+		px = make_pair(1920*unit(rng),1080*unit(rng));
+
+	const string filename = "bench_geotag.txt";
+	vector<double> ms;
+	Geotag::retasker r(mission,filename);
+	for(size_t i=0; i<n; ++i) {
+		Stopwatch d;
+		Geotag::pose p = log.at(times[i]);
+		if(Geotag::project(cam,p,pixels[i].first,pixels[i].second,ground_alt,c))
+			r.add_target(coordinate(c.get_lat(),c.get_lon(),p.alt));
+		ms.push_back(1e3*d.seconds());
+	}
+	string written;
+	{
+		mapped_file m(filename);
+		written = string(m.view());
+	}
+	ok = written==r.file_text() && written==Wplwriter::format(r.mission());
+	printf("Mission of %zu waypoints, %zu detections -> %zu targets (closer than %.0f m dropped), file %s\n",
+		   mission.size(),n,r.target_count(),r.min_separation,ok?"identical to Wplwriter::format":"DIFFERENT");
+	failures += !ok;
+	printf("Detection to saved mission file:\n");
+	print_latency("retasker (incremental)",ms);
+
+	//The same updates re-serializing the whole mission every time.
+	autopath full(mission);
+	size_t m = min<size_t>(n,r.target_count());
+	ms.clear();
+	for(size_t i=0; i<m; ++i) {
+		Stopwatch d;
+		const waypoint &w = r.mission()[mission.size()+i];
+		full.push_back(w);
+		Wplwriter::save(full,filename);
+		ms.push_back(1e3*d.seconds());
+	}
+	print_latency("Wplwriter::save (full)",ms);
+	full = mission;
+	ms.clear();
+	for(size_t i=0; i<min<size_t>(m,200); ++i) {
+		Stopwatch d;
+		full.push_back(r.mission()[mission.size()+i]);
+		full.save(filename);
+		ms.push_back(1e3*d.seconds());
+	}
+	print_latency("autopath::save (full)",ms);
+	remove(filename.c_str());
+	return failures;
+}
@@ -0,0 +1,271 @@
+/**
+ * @file bench_index.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "../waypointgen1/missionindex.h"
+
+using namespace std;
+
+namespace {
+/** @brief half Half the side of the square the missions fly in (m) */
+const double half = 5000;
+
+typedef Missionindex::point point;
+
+/**
+ * @brief wander A mission of short legs with random turns, and a long transit every 1000 legs
+ * @param n Number of waypoints
+ * @param seed Random seed
+ * @return Coordinates
+ */
+VecCoord wander(size_t n, unsigned seed) {
+	mt19937 rng(seed);
+	uniform_real_distribution<double> u(-half,half), turn(-0.5,0.5);
+	exponential_distribution<double> step(1/5.0);
+	localframe f(home);
+	VecCoord c;
+	c.reserve(n);
+	double x = 0, y = 0, heading = 0;
+	for(size_t i=0; i<n; ++i) {
+		c.push_back(f.to_coordinate(x,y,50));
+		if(i%1000==999) {
+			x = u(rng);
+			y = u(rng);
+			continue;
+		}
+		heading += turn(rng);
+		x += step(rng)*cos(heading);
+		y += step(rng)*sin(heading);
+		if(fabs(x)>half || fabs(y)>half) { //turn back at the edge
+			heading += M_PI;
+			x = max(-half,min(half,x));
+			y = max(-half,min(half,y));
+		}
+	}
+	return c;
+}
+
+/**
+ * @brief The brute struct The same queries as Missionindex, by looking at every waypoint and leg
+ */
+struct brute {
+	/** @brief frame Local frame of the first waypoint */
+	localframe frame;
+	/** @brief p Waypoints on the plane */
+	vector<point> p;
+
+	/**
+	 * @brief brute ctor
+	 * @param c Coordinates
+	 */
+	brute(const VecCoord &c) :frame(c.front()),p(c.size()) {
+		for(size_t i=0; i<c.size(); ++i)
+			frame.to_local(c[i],p[i].x,p[i].y);
+	}
+
+	/**
+	 * @brief local A coordinate on the plane
+	 * @param c Coordinate
+	 * @return Point
+	 */
+	point local(const coordinate &c) const {
+		point q;
+		frame.to_local(c,q.x,q.y);
+		return q;
+	}
+
+	/** @brief nearest See Missionindex::nearest */
+	size_t nearest(const coordinate &c, double &d) const {
+		point q = local(c);
+		size_t best = 0;
+		double b2 = numeric_limits<double>::max();
+		for(size_t i=0; i<p.size(); ++i) {
+			double d2 = (p[i].x-q.x)*(p[i].x-q.x)+(p[i].y-q.y)*(p[i].y-q.y);
+			if(d2<b2) {
+				b2 = d2;
+				best = i;
+			}
+		}
+		d = sqrt(b2);
+		return best;
+	}
+
+	/** @brief nearest_leg See Missionindex::nearest_leg */
+	size_t nearest_leg(const coordinate &c, double &d) const {
+		point q = local(c);
+		size_t best = 0;
+		double b2 = numeric_limits<double>::max();
+		for(size_t i=0; i+1<p.size(); ++i) {
+			double d2 = Missionindex::segment_distance2(q,p[i],p[i+1]);
+			if(d2<b2) {
+				b2 = d2;
+				best = i;
+			}
+		}
+		d = sqrt(b2);
+		return best;
+	}
+
+	/** @brief within See Missionindex::within */
+	vector<size_t> within(const coordinate &c, double radius) const {
+		point q = local(c);
+		vector<size_t> result;
+		for(size_t i=0; i<p.size(); ++i)
+			if(hypot(p[i].x-q.x,p[i].y-q.y)<=radius)
+				result.push_back(i);
+		return result;
+	}
+
+	/** @brief crossing See Missionindex::crossing */
+	vector<size_t> crossing(const coordinate &a, const coordinate &b) const {
+		point u = local(a), v = local(b);
+		vector<size_t> result;
+		for(size_t i=0; i+1<p.size(); ++i)
+			if(Missionindex::intersects(u,v,p[i],p[i+1]))
+				result.push_back(i);
+		return result;
+	}
+
+	/** @brief legs_in See Missionindex::legs_in */
+	vector<size_t> legs_in(const VecCoord &polygon) const {
+		const Missioncheck::geofence zone(polygon);
+		vector<size_t> result;
+		vector<point> z(p.size());
+		for(size_t i=0; i<p.size(); ++i)
+			zone.frame.to_local(frame.to_coordinate(p[i].x,p[i].y,0),z[i].x,z[i].y);
+		for(size_t i=0; i+1<p.size(); ++i)
+			if(zone.inside(z[i].x,z[i].y) || zone.inside(z[i+1].x,z[i+1].y) || zone.crosses(z[i].x,z[i].y,z[i+1].x,z[i+1].y))
+				result.push_back(i);
+		return result;
+	}
+};
+
+/**
+ * @brief zone A 300 m no-fly circle
+ * @param centre Centre
+ * @return Polygon of 32 vertices
+ */
+VecCoord zone(const coordinate &centre) {
+	localframe f(centre);
+	VecCoord c;
+	for(size_t i=0; i<32; ++i)
+		c.push_back(f.to_coordinate(300*cos(2*M_PI*i/32),300*sin(2*M_PI*i/32),0));
+	return c;
+}
+} //namespace
+
+int bench_index(const vector<string> &) {
+	int failures = 0;
+
+	//Small cases.
+	{
+		localframe f(home);
+		VecCoord one{home};
+		Missionindex a(one);
+		double d;
+		bool ok = a.nearest(f.to_coordinate(3,4,0),&d)==0 && fabs(d-5)<1e-6 && a.nearest_leg(home)==1
+				&& a.within(home,1)==vector<size_t>{0} && a.crossing(home,f.to_coordinate(10,0,0)).empty();
+		//A square flown twice: equally near waypoints give the lowest index.
+		VecCoord square;
+		for(int k=0; k<2; ++k)
+			for(auto xy:{make_pair(0,0),make_pair(100,0),make_pair(100,100),make_pair(0,100)})
+				square.push_back(f.to_coordinate(xy.first,xy.second,50));
+		Missionindex b(square);
+		ok = ok && b.nearest(f.to_coordinate(99,1,0))==1 && b.nearest_leg(f.to_coordinate(50,-10,0),&d)==0
+				&& fabs(d-10)<1e-6 && b.within(f.to_coordinate(100,100,0),1)==(vector<size_t>{2,6})
+				&& b.crossing(f.to_coordinate(50,-50,0),f.to_coordinate(50,50,0))==(vector<size_t>{0,4})
+				&& b.crossing(f.to_coordinate(100,100,0),f.to_coordinate(200,200,0))==(vector<size_t>{1,2,5,6})
+				&& b.legs_in(zone(f.to_coordinate(-250,50,0)))==(vector<size_t>{0,2,3,4,6}); //not x = 100
+		printf(" %-40s %s\n","one waypoint, a square flown twice",ok?"ok":"WRONG");
+		failures += !ok;
+	}
+
+	//Random queries against brute force.
+	const size_t queries = 200;
+	printf("Queries on a %.0f km square, %zu of each (us per query: index / brute force):\n",2*half/1e3,queries);
+	printf(" %8s %9s %17s %17s %17s %17s %17s\n","waypoints","build","nearest","nearest leg","within 50 m",
+		   "crossing 200 m","legs in zone");
+	for(size_t n:{10000,100000,1000000}) {
+		VecCoord c = wander(n,7);
+		Stopwatch sw;
+		Missionindex index(c);
+		double build = sw.seconds();
+		brute b(c);
+
+		mt19937 rng(3);
+		uniform_real_distribution<double> u(-half,half), angle(0,2*M_PI);
+		localframe f(home);
+		VecCoord q, q2;
+		vector<VecCoord> zones;
+		for(size_t i=0; i<queries; ++i) {
+			double x = u(rng), y = u(rng), a = angle(rng);
+			q.push_back(f.to_coordinate(x,y,0));
+			q2.push_back(f.to_coordinate(x+200*cos(a),y+200*sin(a),0));
+			zones.push_back(zone(q.back()));
+		}
+		q[0] = c[n/2]; //on a waypoint
+
+		bool ok = true;
+		double t[5][2];
+		vector<size_t> r1(queries), r2(queries);
+		vector<double> d1(queries), d2(queries);
+		vector<vector<size_t>> s1(queries), s2(queries);
+		size_t found[5] = {0,0,0,0,0};
+		//nearest
+		sw.restart();
+		for(size_t i=0; i<queries; ++i) r1[i] = index.nearest(q[i],&d1[i]);
+		t[0][0] = sw.seconds();
+		sw.restart();
+		for(size_t i=0; i<queries; ++i) r2[i] = b.nearest(q[i],d2[i]);
+		t[0][1] = sw.seconds();
+		ok = ok && r1==r2 && d1==d2;
+		//nearest leg
+		sw.restart();
+		for(size_t i=0; i<queries; ++i) r1[i] = index.nearest_leg(q[i],&d1[i]);
+		t[1][0] = sw.seconds();
+		sw.restart();
+		for(size_t i=0; i<queries; ++i) r2[i] = b.nearest_leg(q[i],d2[i]);
+		t[1][1] = sw.seconds();
+		ok = ok && r1==r2 && d1==d2;
+		//within 50 m
+		sw.restart();
+		for(size_t i=0; i<queries; ++i) s1[i] = index.within(q[i],50);
+		t[2][0] = sw.seconds();
+		sw.restart();
+		for(size_t i=0; i<queries; ++i) s2[i] = b.within(q[i],50);
+		t[2][1] = sw.seconds();
+		ok = ok && s1==s2;
+		for(auto &s:s1) found[2] += s.size();
+		//crossing a 200 m segment
+		sw.restart();
+		for(size_t i=0; i<queries; ++i) s1[i] = index.crossing(q[i],q2[i]);
+		t[3][0] = sw.seconds();
+		sw.restart();
+		for(size_t i=0; i<queries; ++i) s2[i] = b.crossing(q[i],q2[i]);
+		t[3][1] = sw.seconds();
+		ok = ok && s1==s2;
+		for(auto &s:s1) found[3] += s.size();
+		//legs in a 300 m zone
+		sw.restart();
+		for(size_t i=0; i<queries; ++i) s1[i] = index.legs_in(zones[i]);
+		t[4][0] = sw.seconds();
+		sw.restart();
+		for(size_t i=0; i<queries; ++i) s2[i] = b.legs_in(zones[i]);
+		t[4][1] = sw.seconds();
+		ok = ok && s1==s2;
+		for(auto &s:s1) found[4] += s.size();
+
+		printf(" %8zu %7.1f ms",n,1e3*build);
+		for(int k=0; k<5; ++k)
+			printf(" %7.1f/%-9.0f",1e6*t[k][0]/queries,1e6*t[k][1]/queries);
+		printf(" %s\n",ok?"ok":"WRONG");
+		printf(" %8s %10s %17s %17s %17.0f %17.0f %17.0f (found per query)\n","","","","",
+			   static_cast<double>(found[2])/queries,static_cast<double>(found[3])/queries,
+			   static_cast<double>(found[4])/queries);
+		failures += !ok;
+	}
+	return failures;
+}
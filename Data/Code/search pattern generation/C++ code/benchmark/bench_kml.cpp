@@ -0,0 +1,75 @@
+/**
+ * @file bench_kml.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "../waypointgen1/coordstream.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief write_kml Writes a Google Earth style kml file with many placemarks
+ * @param filename kml filename
+ * @param placemarks Number of placemarks
+ * @param per_placemark Coordinates per placemark
+ * @return File size in bytes
+ */
+size_t write_kml(const string &filename, size_t placemarks, size_t per_placemark) {
+	FILE *f = fopen(filename.c_str(),"w");
+	if(!f)
+		throw(file_error(filename,false));
+	fprintf(f,"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n<Document>\n");
+	for(size_t i=0; i<placemarks; ++i) {
+		fprintf(f,"\t<Placemark>\n\t\t<name>track%zu</name>\n\t\t<LineString>\n"
+				"\t\t\t<tessellate>1</tessellate>\n\t\t\t<coordinates>\n\t\t\t\t",i);
+		for(size_t j=0; j<per_placemark; ++j)
+			fprintf(f,"%.14f,%.14f,%g ",10.32+1e-6*(i*per_placemark+j),55.47-3e-7*j,24.0+j%7);
+		fprintf(f,"\n\t\t\t</coordinates>\n\t\t</LineString>\n\t</Placemark>\n");
+	}
+	fprintf(f,"</Document>\n</kml>\n");
+	size_t size = static_cast<size_t>(ftell(f));
+	fclose(f);
+	return size;
+}
+} //namespace
+
+int bench_kml(const vector<string> &args) {
+	int failures = 0;
+	if(!args.empty()) {
+		string kmlfile = args[0]+"/zigzag1.kml";
+		double d = max_difference(Coordstream::kml_extract_coordinates(kmlfile),
+								  Kmlmanip::kml_extract_coordinates(kmlfile));
+		printf(" %s: max difference %.3g %s\n",kmlfile.c_str(),d,d==0?"OK":"MISMATCH");
+		failures += d!=0;
+	}
+
+	const string kmlfile = "bench_kml.kml";
+	const size_t reps = 5;
+	size_t bytes = write_kml(kmlfile,20000,10);
+	double mb = bytes/1e6;
+
+	VecCoord a = Coordstream::kml_extract_coordinates(kmlfile);
+	VecCoord b = Kmlmanip::kml_extract_coordinates(kmlfile);
+	double d = max_difference(a,b);
+	printf("Synthetic kml, %.1f MB, %zu coordinates: max difference %.3g %s\n",
+		   mb,a.size(),d,d==0?"OK":"MISMATCH");
+	failures += d!=0;
+
+	size_t sink = 0;
+	double t_old = best_of(reps,[&]{ sink += Kmlmanip::kml_extract_coordinates(kmlfile).size(); });
+	double t_new = best_of(reps,[&]{ sink += Coordstream::kml_extract_coordinates(kmlfile).size(); });
+	double t_cb = best_of(reps,[&]{
+		Coordstream::kml_for_each(kmlfile,[&](const coordinate &c) { sink += c.get_alt()>0; });
+	});
+	remove(kmlfile.c_str());
+
+	printf(" Kmlmanip::kml_extract_coordinates     %8.1f MB/s\n",mb/t_old);
+	printf(" Coordstream::kml_extract_coordinates  %8.1f MB/s\n",mb/t_new);
+	printf(" Coordstream::kml_for_each             %8.1f MB/s (no VecCoord)\n",mb/t_cb);
+	printf(" speedup                               %8.1fx\n",t_old/t_new);
+	return failures+(sink==0);
+}
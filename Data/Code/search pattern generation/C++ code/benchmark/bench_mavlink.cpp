@@ -0,0 +1,177 @@
+/**
+ * @file bench_mavlink.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "bench.h"
+#include "../waypointgen1/missionitem.h"
+#include "../waypointgen1/patterngen.h"
+#include "../waypointgen1/wplwriter.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief The golden struct A known-good frame
+ */
+struct golden {
+	/** @brief name Name to print */
+	const char *name;
+	/** @brief w Waypoint */
+	waypoint w;
+	/** @brief packet_seq Packet sequence number */
+	uint8_t packet_seq;
+	/** @brief l Sender and receiver */
+	Missionitem::link l;
+	/** @brief bytes Expected frame */
+	vector<uint8_t> bytes;
+};
+
+/**
+ * @brief link_of Sender and receiver
+ * @param sysid Sender system id
+ * @param compid Sender component id
+ * @param target_system Target system id
+ * @param target_component Target component id
+ * @return link
+ */
+Missionitem::link link_of(uint8_t sysid, uint8_t compid, uint8_t target_system, uint8_t target_component) {
+	Missionitem::link l;
+	l.sysid = sysid;
+	l.compid = compid;
+	l.target_system = target_system;
+	l.target_component = target_component;
+	return l;
+}
+
+/**
+ * @brief crc_extra_of CRC_EXTRA from the message definition, as mavgen computes it:
+ * CRC of "NAME " and "type name " of every non-extension field in wire order.
+ * @return CRC_EXTRA of MISSION_ITEM_INT
+ */
+uint8_t crc_extra_of() {
+	static const char *fields[][2] = {
+		{"float","param1"},{"float","param2"},{"float","param3"},{"float","param4"},
+		{"int32_t","x"},{"int32_t","y"},{"float","z"},{"uint16_t","seq"},{"uint16_t","command"},
+		{"uint8_t","target_system"},{"uint8_t","target_component"},{"uint8_t","frame"},
+		{"uint8_t","current"},{"uint8_t","autocontinue"}};
+	string s = "MISSION_ITEM_INT ";
+	for(auto &f:fields)
+		s += string(f[0])+" "+f[1]+" ";
+	uint16_t crc = Missionitem::crc_x25(reinterpret_cast<const uint8_t*>(s.data()),s.size());
+	return static_cast<uint8_t>((crc&0xFF)^(crc>>8));
+}
+
+/**
+ * @brief same Compares a decoded waypoint with the encoded one
+ * @param a Encoded
+ * @param b Decoded
+ * @return Equal up to the int32 (1e-7 degrees) and float precision of the frame
+ */
+bool same(const waypoint &a, const waypoint &b) {
+	const command &x = a.my_cmd, &y = b.my_cmd;
+	return a.index==b.index && a.current_wp==b.current_wp && a.coord_frame==b.coord_frame
+			&& a.autocontinue==b.autocontinue && x.cmd==y.cmd
+			&& static_cast<float>(x.p1)==y.p1 && static_cast<float>(x.p2)==y.p2
+			&& static_cast<float>(x.p3)==y.p3 && static_cast<float>(x.p4)==y.p4
+			&& fabs(x.coord.get_lat()-y.coord.get_lat())<=0.5e-7+1e-15
+			&& fabs(x.coord.get_lon()-y.coord.get_lon())<=0.5e-7+1e-15
+			&& static_cast<float>(x.coord.get_alt())==y.coord.get_alt();
+}
+} //namespace
+
+int bench_mavlink(const vector<string> &) {
+	int failures = 0;
+	const uint8_t check[] = "123456789";
+	bool ok = Missionitem::crc_x25(check,9)==0x6F91;
+	printf(" %-40s %s\n","CRC-16/MCRF4XX check value 0x6F91",ok?"ok":"WRONG");
+	failures += !ok;
+	ok = crc_extra_of()==Missionitem::crc_extra;
+	printf(" %-40s %d %s\n","CRC_EXTRA from the field list",crc_extra_of(),ok?"ok":"WRONG");
+	failures += !ok;
+
+	//Frames computed by hand from the MAVLink v2 specification (independent of this encoder).
+	const golden frames[] = {
+		{"waypoint, current", waypoint(0,1,0,16,0,0,0,0,55.47527419285358,10.32365339962823,24,1), 0,
+		 link_of(255,190,1,1),
+		 {0xfd,0x25,0x00,0x00,0x00,0xff,0xbe,0x49,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+		  0x00,0x00,0x00,0x00,0x00,0x00,0xe6,0xda,0x10,0x21,0xb6,0x43,0x27,0x06,0x00,0x00,0xc0,0x41,0x00,0x00,
+		  0x10,0x00,0x01,0x01,0x00,0x01,0x01,0xf0,0xe0}},
+		{"loiter, negative coordinates", waypoint(321,0,3,19,60,0,0,0,-33.8567844,-151.213108,-12.5,1), 7,
+		 link_of(255,190,1,1),
+		 {0xfd,0x25,0x00,0x00,0x07,0xff,0xbe,0x49,0x00,0x00,0x00,0x00,0x70,0x42,0x00,0x00,0x00,0x00,0x00,0x00,
+		  0x00,0x00,0x00,0x00,0x00,0x00,0x5c,0xdd,0xd1,0xeb,0xf8,0xb5,0xde,0xa5,0x00,0x00,0x48,0xc1,0x41,0x01,
+		  0x13,0x00,0x01,0x01,0x03,0x00,0x01,0x06,0x3d}},
+		{"truncated zeros", waypoint(0,0,0,16,0,0,0,0,0,0,0,0), 255,
+		 link_of(1,1,0,0),
+		 {0xfd,0x1f,0x00,0x00,0xff,0x01,0x01,0x49,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+		  0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+		  0x10,0xa1,0xfd}},
+	};
+	for(const golden &g:frames) {
+		uint8_t out[Missionitem::max_frame];
+		size_t n = Missionitem::encode(g.w,g.packet_seq,out,g.l);
+		waypoint back(0,0,0,0,0,0,0,0,0,0,0);
+		size_t used = 0;
+		Missionitem::link l;
+		ok = n==g.bytes.size() && memcmp(out,g.bytes.data(),n)==0
+				&& Missionitem::decode(g.bytes.data(),g.bytes.size(),back,used,&l)==Missionitem::ok
+				&& used==n && same(g.w,back) && l.sysid==g.l.sysid && l.target_system==g.l.target_system;
+		printf(" %-40s %2zu bytes %s\n",g.name,n,ok?"byte identical, decoded":"WRONG");
+		failures += !ok;
+	}
+
+	//Round trip of a long mission, corruption and framing.
+	const autopath ap = Patterngen::spiral(home,target,0.15); //about 64000 waypoints
+	vector<uint8_t> buf;
+	Missionitem::encode(ap,buf);
+	VecWP back = Missionitem::decode(buf.data(),buf.size());
+	ok = back.size()==ap.size();
+	for(size_t i=0; ok && i<ap.size(); ++i)
+		ok = same(ap[i],back[i]);
+	printf(" %-40s %7zu waypoints %s\n","dense spiral round trip",ap.size(),ok?"ok":"WRONG");
+	failures += !ok;
+	try {
+		Missionitem::encode(Patterngen::spiral(home,target,0.1),buf);
+		ok = false;
+	} catch(const out_of_range &) {
+		ok = true;
+	}
+	printf(" %-40s %s\n","more than 65536 waypoints refused",ok?"ok":"WRONG");
+	failures += !ok;
+	vector<uint8_t> noisy(buf.begin(),buf.begin()+3*49);
+	noisy.insert(noisy.begin(),{0x00,0x55}); //garbage before the first frame
+	const uint8_t heartbeat[] = {0xfd,0x09,0x00,0x00,0x00,0x01,0x01,0x00,0x00,0x00,
+								 0,0,0,0,0,0,0,0,0,0,0}; //another message, CRC not checked
+	noisy.insert(noisy.begin()+2+49,heartbeat,heartbeat+sizeof(heartbeat));
+	ok = Missionitem::decode(noisy.data(),noisy.size()).size()==3;
+	size_t detected = 0;
+	for(size_t i=1; i<49; ++i) {
+		vector<uint8_t> bad(buf.begin(),buf.begin()+49);
+		bad[i] ^= 0x10;
+		try { //a flipped message id turns the frame into another message, which is skipped
+			detected += Missionitem::decode(bad.data(),bad.size()).size()!=1;
+		} catch(const parse_error &) {
+			++detected;
+		}
+	}
+	ok = ok && detected==48;
+	printf(" %-40s %zu of 48 bit flips rejected %s\n","garbage, other messages, corrupt frames",detected,ok?"ok":"WRONG");
+	failures += !ok;
+
+	//Throughput
+	const size_t reps = 5;
+	string text;
+	double t_text = best_of(reps,[&]{ Wplwriter::format(ap,text); });
+	double t_enc = best_of(reps,[&]{ Missionitem::encode(ap,buf); });
+	size_t sink = 0;
+	double t_dec = best_of(reps,[&]{ sink += Missionitem::decode(buf.data(),buf.size()).size(); });
+	double n = static_cast<double>(ap.size());
+	printf("Dense spiral, %zu waypoints:\n",ap.size());
+	printf(" Wplwriter::format (text)  %8.1f ms %8.2f Mitems/s %6.1f MB\n",1e3*t_text,n/t_text/1e6,text.size()/1e6);
+	printf(" Missionitem::encode       %8.1f ms %8.2f Mitems/s %6.1f MB\n",1e3*t_enc,n/t_enc/1e6,buf.size()/1e6);
+	printf(" Missionitem::decode       %8.1f ms %8.2f Mitems/s\n",1e3*t_dec,n/t_dec/1e6);
+	return failures+(sink==0);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file bench_partition.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include "bench.h"
+#include "../waypointgen1/mappedfile.h"
+#include "../waypointgen1/partition.h"
+#include "../waypointgen1/wplwriter.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief homes Launch sites around the south of an area
+ * @param n Number of aircraft
+ * @param radius Distance from the centre of the area (m)
+ * @return Home coordinates
+ */
+VecCoord homes(size_t n, double radius) {
+	localframe f(home);
+	VecCoord h;
+	for(size_t i=0; i<n; ++i) {
+		double t = M_PI*(1.1+0.8*(n>1?i/(n-1.0):0.5)); //south-west to south-east
+		h.push_back(f.to_coordinate(radius*cos(t),radius*sin(t),24));
+	}
+	return h;
+}
+
+/**
+ * @brief track_ends Track piece ends of all missions in a local frame
+ * @param f Local frame
+ * @param missions Missions (home, then pairs of track piece ends)
+ * @return Pairs of track piece ends
+ */
+vector<Coverage::point> track_ends(const localframe &f, const vector<autopath> &missions) {
+	vector<Coverage::point> ends;
+	for(const autopath &m:missions)
+		for(size_t i=1; i<m.size(); ++i) {
+			ends.emplace_back();
+			f.to_local(m[i].my_cmd.coord,ends.back().x,ends.back().y);
+		}
+	return ends;
+}
+} //namespace
+
+int bench_partition(const vector<string> &) {
+	int failures = 0;
+	const double spacing = 20, alt = 50;
+	const VecCoord area = coastline(home,2000,10e6);
+	const VecCoord h = homes(3,4000);
+
+	//Three aircraft over the 10 km2 coastline.
+	vector<Partition::report> reps;
+	vector<autopath> missions = Partition::plan(area,h,spacing,alt,1,&reps);
+	double shortest = 1e300, longest = 0, total_area = 0;
+	printf("Three aircraft, %.0f km2, %.0f m spacing:\n",Coverage::area(Coverage::to_local(area,localframe(area.front())))/1e6,
+		   spacing);
+	for(size_t i=0; i<missions.size(); ++i) {
+		const Partition::report &r = reps[i];
+		double flight = r.coverage.length+r.transit;
+		shortest = min(shortest,flight);
+		longest = max(longest,flight);
+		total_area += r.coverage.area;
+		printf(" aircraft %zu: %5.2f km2 %4zu tracks %5zu waypoints, %6.1f km tracks + %5.1f km transit = %6.1f km\n",i+1,
+			   r.coverage.area/1e6,r.coverage.tracks,missions[i].size(),r.coverage.length/1e3,r.transit/1e3,flight/1e3);
+	}
+	const localframe f(area.front());
+	double cov = covered(Coverage::to_local(area,f),track_ends(f,missions),spacing/2,20000);
+	bool ok = fabs(total_area-10e6)<1 && cov>0.99 && longest/shortest<1.05;
+	printf(" areas add up to %.3f km2, %.2f%% covered, longest/shortest flight %.3f %s\n",total_area/1e6,100*cov,
+		   longest/shortest,ok?"ok":"WRONG");
+	failures += !ok;
+
+	//The same missions whatever the number of threads, saved with autopath::save.
+	vector<autopath> again = Partition::plan(area,h,spacing,alt,4);
+	ok = again.size()==missions.size();
+	for(size_t i=0; ok && i<missions.size(); ++i)
+		ok = Wplwriter::format(again[i])==Wplwriter::format(missions[i]);
+	Partition::save(missions,"bench_partition");
+	for(size_t i=0; i<missions.size(); ++i) {
+		string filename = "bench_partition_"+to_string(i+1)+".txt";
+		{
+			mapped_file m(filename);
+			ok = ok && m.view()==Wplwriter::format(missions[i]);
+		}
+		remove(filename.c_str());
+	}
+	printf(" %-40s %s\n","4 threads identical, files saved",ok?"ok":"WRONG");
+	failures += !ok;
+
+	//Planning time: 100 km2 at 10 m spacing (about 10000 km of tracks).
+	const VecCoord big = coastline(home,5000,100e6);
+	const size_t counts[] = {1,2,4,8};
+	printf("Planning time, 100 km2, 10 m spacing (%u hardware threads):\n %-10s",thread::hardware_concurrency(),"aircraft");
+	for(size_t threads:counts)
+		printf(" %6zu thread%s",threads,threads>1?"s":" ");
+	printf("\n");
+	for(size_t n:counts) {
+		VecCoord hn = homes(n,9000);
+		printf(" %-10zu",n);
+		for(size_t threads:counts) {
+			double t = best_of(3,[&]{ Partition::plan(big,hn,10,alt,threads); });
+			printf(" %9.1f ms",1e3*t);
+		}
+		printf("\n");
+	}
+	return failures;
+}
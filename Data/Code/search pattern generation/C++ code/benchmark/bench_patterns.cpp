@@ -0,0 +1,69 @@
+/**
+ * @file bench_patterns.cpp
+ * @author Mikael Westermann
+ */
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "../waypointgen1/patterngen.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief validate Compares generated patterns with the csv files made in MATLAB
+ * @param dir Directory of the csv files
+ * @return Number of mismatching patterns
+ */
+int validate(const string &dir) {
+	struct { const char *file; VecCoord c; } patterns[] = {
+		{"spiral1_30m.csv",Patterngen::spiral_coordinates(home,target,30)},
+		{"spiral1_50m.csv",Patterngen::spiral_coordinates(home,target,50)},
+		{"spiral1_100m_inwards.csv",Patterngen::spiral_coordinates(home,target,100,true)},
+		{"zigzag1_10degrees.csv",Patterngen::zigzag_coordinates(home,target,10,10)},
+		{"zigzag1_30degrees.csv",Patterngen::zigzag_coordinates(home,target,20,30)},
+		{"sector1.csv",Patterngen::sector_coordinates(home,target)},
+	};
+	int failures = 0;
+	for(auto &p:patterns) {
+		double d = max_difference(p.c,Kmlmanip::csv_extract_coordinates(dir+"/"+p.file));
+		bool ok = d<1e-9;
+		printf(" %-26s %5zu waypoints, max difference %.3g deg %s\n",
+			   p.file,p.c.size(),d,ok?"OK":"MISMATCH");
+		failures += !ok;
+	}
+	return failures;
+}
+} //namespace
+
+int bench_patterns(const vector<string> &args) {
+	int failures = 0;
+	if(!args.empty()) {
+		cout << "Validating against MATLAB csv files in \"" << args[0] << "\":" << endl;
+		failures = validate(args[0]);
+	}
+
+	//A dense spiral: roughly 19000 waypoints.
+	const double spacing = 0.5;
+	const size_t reps = 10;
+	size_t n = Patterngen::spiral_coordinates(home,target,spacing).size();
+	const string csvfile = "bench_patterns_spiral.csv";
+	write_matlab_csv(csvfile,Patterngen::spiral_coordinates(home,target,spacing));
+
+	size_t sink = 0;
+	double t_gen = best_of(reps,[&]{ sink += Patterngen::spiral(home,target,spacing).size(); });
+	double t_zz = best_of(reps,[&]{ sink += Patterngen::zigzag(home,target,0.05,10).size(); });
+	size_t nzz = Patterngen::zigzag_coordinates(home,target,0.05,10).size();
+	double t_csv = best_of(reps,[&]{ sink += Kmlmanip::csv_to_autopath(csvfile).size(); });
+	remove(csvfile.c_str());
+
+	printf("Spiral, %zu waypoints (best of %zu):\n",n,reps);
+	printf(" Patterngen::spiral          %10.3f ms/1000 wp\n",1e6*t_gen/n);
+	printf(" Kmlmanip::csv_to_autopath   %10.3f ms/1000 wp (csv import only, MATLAB not included)\n",
+		   1e6*t_csv/n);
+	printf(" speedup                     %10.1fx\n",t_csv/t_gen);
+	printf("Zigzag, %zu waypoints:\n",nzz);
+	printf(" Patterngen::zigzag          %10.3f ms/1000 wp\n",1e6*t_zz/nzz);
+	return failures+(sink==0);
+}
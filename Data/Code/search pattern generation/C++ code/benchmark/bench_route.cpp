@@ -0,0 +1,143 @@
+/**
+ * @file bench_route.cpp
+ * @author Mikael Westermann
+ */
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include "bench.h"
+#include "../waypointgen1/routeorder.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief scattered Random points of interest around home
+ * @param n Number of points (home first)
+ * @param size Side of the square (m)
+ * @param clusters Number of clusters (0: uniform)
+ * @param seed Random seed
+ * @return Points
+ */
+VecCoord scattered(size_t n, double size, size_t clusters, unsigned seed) {
+	mt19937 rng(seed);
+	uniform_real_distribution<double> u(-size/2,size/2);
+	normal_distribution<double> spread(0,size/40);
+	vector<pair<double,double>> centres(clusters);
+	for(auto &c:centres)
+		c = make_pair(u(rng),u(rng));
+	localframe f(home);
+	VecCoord p{home};
+	while(p.size()<n) {
+		if(clusters==0) {
+			p.push_back(f.to_coordinate(u(rng),u(rng),24));
+			continue;
+		}
+		const auto &c = centres[rng()%clusters];
+		p.push_back(f.to_coordinate(c.first+spread(rng),c.second+spread(rng),24));
+	}
+	return p;
+}
+
+/**
+ * @brief is_route Checks that an order visits every point once, starting at 0
+ * @param t Order
+ * @param n Number of points
+ * @return true if valid
+ */
+bool is_route(const vector<size_t> &t, size_t n) {
+	vector<size_t> s(t);
+	sort(s.begin(),s.end());
+	vector<size_t> all(n);
+	iota(all.begin(),all.end(),0);
+	return !t.empty() && t[0]==0 && s==all;
+}
+
+/**
+ * @brief optimum Shortest open route from point 0, by trying every order
+ * @param p Points (at most 10)
+ * @return Length (m)
+ */
+double optimum(const VecCoord &p) {
+	vector<size_t> t(p.size());
+	iota(t.begin(),t.end(),0);
+	double best = INFINITY;
+	do {
+		double l = 0;
+		for(size_t i=1; i<t.size() && l<best; ++i)
+			l += Routeorder::length(VecCoord{p[t[i-1]],p[t[i]]});
+		best = min(best,l);
+	} while(next_permutation(t.begin()+1,t.end()));
+	return best;
+}
+} //namespace
+
+int bench_route(const vector<string> &) {
+	int failures = 0;
+
+	//A north leg of 1000 m on the tangent plane is 1000 m on the ellipsoid.
+	double l = Routeorder::length(VecCoord{home,localframe(home).to_coordinate(0,1000,24)});
+	bool ok = fabs(l-1000)<1e-2;
+	printf(" %-40s %.4f m %s\n","1000 m north",l,ok?"ok":"WRONG");
+	failures += !ok;
+
+	//Points on a circle, shuffled: the best open route goes around.
+	{
+		const size_t n = 500;
+		const double radius = 1000;
+		localframe f(home);
+		VecCoord p;
+		for(size_t i=0; i<n; ++i)
+			p.push_back(f.to_coordinate(radius*cos(2*M_PI*i/n),radius*sin(2*M_PI*i/n),24));
+		double around = (n-1)*Routeorder::length(VecCoord{p[0],p[1]});
+		shuffle(p.begin()+1,p.end(),mt19937(7));
+		Routeorder::report r;
+		vector<size_t> t = Routeorder::order(p,&r);
+		ok = is_route(t,n) && fabs(r.optimized-around)<1e-6*around;
+		printf(" %-40s %.1f km -> %.3f km (around: %.3f km) %s\n","500 shuffled points on a circle",r.input/1e3,
+			   r.optimized/1e3,around/1e3,ok?"ok":"WRONG");
+		failures += !ok;
+	}
+
+	//Small instances against the optimum.
+	{
+		size_t optimal = 0, cases = 50;
+		double worst = 1;
+		ok = true;
+		for(unsigned c=0; c<cases; ++c) {
+			VecCoord p = scattered(9,2000,0,100+c);
+			Routeorder::report r;
+			ok = ok && is_route(Routeorder::order(p,&r),p.size()) && r.optimized<=r.nearest_neighbour+1e-6;
+			double best = optimum(p);
+			optimal += r.optimized<=best*(1+1e-9);
+			worst = max(worst,r.optimized/best);
+		}
+		printf(" %-40s %zu of %zu optimal, worst %.3fx %s\n","9 points vs. every order",optimal,cases,worst,
+			   ok?"ok":"WRONG");
+		failures += !ok;
+	}
+
+	//Scaling: uniform and clustered points of interest in a 5 km square.
+	printf("Points in a 5 km square: input order -> nearest neighbour -> 2-opt/Or-opt\n");
+	for(size_t clusters:{0,20}) {
+		for(size_t n:{1000,10000,50000}) {
+			VecCoord p = scattered(n,5000,clusters,1);
+			Routeorder::report r;
+			vector<size_t> t;
+			Stopwatch sw;
+			t = Routeorder::order(p,&r);
+			double s = sw.seconds();
+			ok = is_route(t,n) && r.optimized<=r.nearest_neighbour;
+			printf(" %6zu %-9s %8.1f km -> %7.1f km -> %7.1f km (-%4.1f%% vs. input, -%4.1f%% vs. NN) %8.1f ms %s\n",n,
+				   clusters?"clustered":"uniform",r.input/1e3,r.nearest_neighbour/1e3,r.optimized/1e3,
+				   100*(1-r.optimized/r.input),100*(1-r.optimized/r.nearest_neighbour),1e3*s,ok?"ok":"WRONG");
+			failures += !ok;
+			if(!clusters) //Beardwood-Halton-Hammersley: the optimum is about 0.7124*sqrt(n*area)
+				printf(" %6s %-9s estimated optimum %.1f km, this route %.1f%% longer\n","","",0.7124*sqrt(n*25e6)/1e3,
+					   100*(r.optimized/(0.7124*sqrt(n*25e6))-1));
+		}
+	}
+	return failures;
+}
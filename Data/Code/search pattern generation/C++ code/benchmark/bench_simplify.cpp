@@ -0,0 +1,86 @@
+/**
+ * @file bench_simplify.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include "bench.h"
+#include "../waypointgen1/coordstream.h"
+#include "../waypointgen1/pathsimplify.h"
+#include "../waypointgen1/patterngen.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief valid Checks a simplification
+ * @param c Path
+ * @param k Kept indices
+ * @param tolerance Tolerance (m)
+ * @return true if the end points are kept, the indices ascend and no removed coordinate is too far
+ */
+bool valid(const VecCoord &c, const vector<size_t> &k, double tolerance) {
+	bool ok = !k.empty() && k.front()==0 && k.back()==c.size()-1;
+	for(size_t i=1; ok && i<k.size(); ++i)
+		ok = k[i-1]<k[i];
+	return ok && Pathsimplify::deviation(c,k)<=tolerance*(1+1e-12);
+}
+} //namespace
+
+int bench_simplify(const vector<string> &args) {
+	int failures = 0;
+	struct { const char *file; VecCoord c; } patterns[] = {
+		{"spiral1_30m.csv",Patterngen::spiral_coordinates(home,target,30)},
+		{"spiral1_50m.csv",Patterngen::spiral_coordinates(home,target,50)},
+		{"spiral1_100m_inwards.csv",Patterngen::spiral_coordinates(home,target,100,true)},
+		{"zigzag1_10degrees.csv",Patterngen::zigzag_coordinates(home,target,10,10)},
+		{"zigzag1_30degrees.csv",Patterngen::zigzag_coordinates(home,target,20,30)},
+		{"sector1.csv",Patterngen::sector_coordinates(home,target)},
+	};
+	if(!args.empty()) {
+		cout << "Patterns from the csv files in \"" << args[0] << "\":" << endl;
+		for(auto &p:patterns)
+			p.c = Coordstream::csv_extract_coordinates(args[0]+"/"+p.file);
+	}
+	else
+		cout << "Generated patterns (pass the csv directory to use the MATLAB files):" << endl;
+	const double tolerances[] = {0.01,1,2,5};
+	printf(" %-26s %6s","","items");
+	for(double tol:tolerances)
+		printf("  %9.2f m tolerance",tol);
+	printf("\n");
+	for(auto &p:patterns) {
+		printf(" %-26s %6zu",p.file,p.c.size());
+		for(double tol:tolerances) {
+			vector<size_t> k = Pathsimplify::keep(p.c,tol);
+			bool ok = valid(p.c,k,tol);
+			printf("  %5zu (-%3.0f%%) %5.2f m%s",k.size(),100.0*(p.c.size()-k.size())/p.c.size(),
+				   Pathsimplify::deviation(p.c,k),ok?"":" WRONG");
+			failures += !ok;
+		}
+		printf("\n");
+	}
+
+	//A dense spiral: roughly a million coordinates, serial vs. threads.
+	const VecCoord dense = Patterngen::spiral_coordinates(home,target,0.01);
+	const double tol = 0.5;
+	const size_t reps = 3;
+	vector<size_t> serial;
+	double t_serial = best_of(reps,[&]{ serial = Pathsimplify::keep(dense,tol); });
+	bool ok = valid(dense,serial,tol);
+	printf("Dense spiral, %zu coordinates, %.1f m tolerance -> %zu (-%.0f%%) %s, %u hardware threads\n",dense.size(),
+		   tol,serial.size(),100.0*(dense.size()-serial.size())/dense.size(),ok?"ok":"WRONG",thread::hardware_concurrency());
+	failures += !ok;
+	printf(" %2d thread%s %8.1f ms %8.2f Mcoords/s\n",1," ",1e3*t_serial,dense.size()/t_serial/1e6);
+	size_t hw = max<size_t>(1,thread::hardware_concurrency());
+	for(size_t threads=2; threads<=max<size_t>(4,hw); threads*=2) { //checked even on fewer cores
+		vector<size_t> k;
+		double t = best_of(reps,[&]{ k = Pathsimplify::keep(dense,tol,threads); });
+		ok = k==serial;
+		printf(" %2zu threads %8.1f ms %8.2f Mcoords/s %5.1fx %s\n",threads,1e3*t,dense.size()/t/1e6,
+			   t_serial/t,ok?"same waypoints":"DIFFERENT");
+		failures += !ok;
+	}
+	return failures;
+}
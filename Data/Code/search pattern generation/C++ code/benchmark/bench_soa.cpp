@@ -0,0 +1,86 @@
+/**
+ * @file bench_soa.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "../waypointgen1/soapath.h"
+#include "../waypointgen1/wplwriter.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief soa_bytes Memory used by the arrays of a soa_autopath
+ * @param s Path
+ * @return Bytes
+ */
+size_t soa_bytes(const soa_autopath &s) {
+	return s.lat.capacity()*sizeof(double)*7+s.index.capacity()*sizeof(uint32_t)
+			+s.cmd.capacity()*sizeof(uint16_t)+s.coord_frame.capacity()+s.flags.capacity();
+}
+} //namespace
+
+int bench_soa(const vector<string> &args) {
+	const size_t n = 1000000;
+	const size_t reps = 5;
+	VecCoord coords;
+	coords.reserve(n);
+	for(size_t i=0; i<n; ++i)
+		coords.emplace_back(55.47+1e-6*(i%1000),10.32+1e-6*(i/1000),24+i%50);
+
+	size_t sink = 0;
+	double t_build_aos = best_of(reps,[&]{ sink += autopath(coords).size(); });
+	double t_build_soa = best_of(reps,[&]{ sink += soa_autopath(coords).size(); });
+	autopath ap(coords);
+	soa_autopath sp(coords);
+
+	//A typical transform: move the whole path and raise it.
+	const double dlat = 1e-5, dlon = -2e-5, dalt = 0.5;
+	double t_move_aos = best_of(reps,[&]{
+		for(waypoint &w:ap) {
+			coordinate &c = w.my_cmd.coord;
+			c = coordinate(c.get_lat()+dlat,c.get_lon()+dlon,c.get_alt()+dalt);
+		}
+	});
+	double t_move_soa = best_of(reps,[&]{
+		double *lat = sp.lat.data(), *lon = sp.lon.data(), *alt = sp.alt.data();
+		for(size_t i=0; i<n; ++i) {
+			lat[i] += dlat;
+			lon[i] += dlon;
+			alt[i] += dalt;
+		}
+	});
+
+	string a, b;
+	double t_fmt_aos = best_of(reps,[&]{ Wplwriter::format(ap,a); });
+	double t_fmt_soa = best_of(reps,[&]{ sp.format(b); });
+	bool same = a==b;
+
+	double mb_aos = n*sizeof(waypoint)/1e6, mb_soa = soa_bytes(sp)/1e6;
+	printf("%zu waypoints (best of %zu):\n",n,reps);
+	printf("                         autopath   soa_autopath\n");
+	printf(" memory            %10.1f MB %10.1f MB\n",mb_aos,mb_soa);
+	printf(" bytes/waypoint    %10zu    %10.0f\n",sizeof(waypoint),1e6*mb_soa/n);
+	printf(" construct         %10.1f ms %10.1f ms\n",1e3*t_build_aos,1e3*t_build_soa);
+	printf(" move lat/lon/alt  %10.2f ms %10.2f ms\n",1e3*t_move_aos,1e3*t_move_soa);
+	printf(" format            %10.1f ms %10.1f ms\n",1e3*t_fmt_aos,1e3*t_fmt_soa);
+	printf(" same file: %s\n",same?"yes":"NO");
+
+	//Fields wider than the arrays are rejected, not truncated.
+	size_t rejected = 0;
+	for(const waypoint &w:{waypoint(size_t(1)<<32,0,0,16,0,0,0,0,55.47,10.32,24,1),
+						   waypoint(0,0,0,65536,0,0,0,0,55.47,10.32,24,1),
+						   waypoint(0,0,256,16,0,0,0,0,55.47,10.32,24,1)}) {
+		soa_autopath s;
+		try {
+			s.push_back(w);
+		} catch(const out_of_range &) {
+			rejected += s.size()==0;
+		}
+	}
+	printf(" out-of-range waypoints rejected: %s\n",rejected==3?"yes":"NO");
+	(void)args;
+	return !same+(rejected!=3)+(sink==0);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file bench_utm.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "../waypointgen1/coordstream.h"
+#include "../waypointgen1/utmbatch.h"
+
+using namespace std;
+
+namespace {
+/** @brief m_per_deg Metres per degree of latitude (roughly) */
+const double m_per_deg = 111320;
+
+/**
+ * @brief validate Compares the batch conversion with the MATLAB series on a csv file.
+ * The csv coordinates were made by utm2deg.m, so deg2utm (scalar, same as deg2utm.m)
+ * and then utm2deg_batch must give them back.
+ * @param csvfile csv filename
+ * @return true if both directions agree to a millimetre
+ */
+bool validate(const string &csvfile) {
+	VecCoord c = Coordstream::csv_extract_coordinates(csvfile);
+	size_t n = c.size();
+	vector<double> lat(n), lon(n), x(n), y(n), xs(n), ys(n), lat2(n), lon2(n);
+	for(size_t i=0; i<n; ++i) {
+		lat[i] = c[i].get_lat();
+		lon[i] = c[i].get_lon();
+		UTM::utmcoord u = UTM::deg2utm(lat[i],lon[i]);
+		xs[i] = u.x;
+		ys[i] = u.y;
+	}
+	int zone = UTM::zone_of(lon[0]);
+	UTM::deg2utm_batch(lat.data(),lon.data(),n,x.data(),y.data());
+	UTM::utm2deg_batch(xs.data(),ys.data(),n,zone,lat[0]>=0,lat2.data(),lon2.data());
+	double dfwd = 0, dinv = 0;
+	for(size_t i=0; i<n; ++i) {
+		dfwd = max(dfwd,max(fabs(x[i]-xs[i]),fabs(y[i]-ys[i])));
+		dinv = max(dinv,m_per_deg*max(fabs(lat2[i]-lat[i]),fabs(lon2[i]-lon[i])));
+	}
+	bool ok = dfwd<1e-3 && dinv<1e-3;
+	printf(" %-40s %4zu points, deg2utm %.2g m, utm2deg %.2g m %s\n",
+		   csvfile.c_str(),n,dfwd,dinv,ok?"OK":"MISMATCH");
+	return ok;
+}
+} //namespace
+
+int bench_utm(const vector<string> &args) {
+	int failures = 0;
+	printf("AVX2 kernels: %s\n",UTM::have_avx2()?"yes":"no (scalar only)");
+	if(!args.empty())
+		for(const char *name:{"spiral1_30m.csv","spiral1_50m.csv","spiral1_100m_inwards.csv",
+							  "zigzag1_10degrees.csv","zigzag1_30degrees.csv","sector1.csv"})
+			failures += !validate(args[0]+"/"+name);
+
+	//1M points in a 50x50 km square around Odense.
+	const size_t n = 1000000;
+	const size_t reps = 5;
+	vector<double> lat(n), lon(n), x(n), y(n), lat2(n), lon2(n);
+	for(size_t i=0; i<n; ++i) {
+		lat[i] = 55.2+0.45*(i%1000)/1000;
+		lon[i] = 10.0+0.8*(i/1000)/1000;
+	}
+	double t_fwd_s = best_of(reps,[&]{ UTM::deg2utm_batch(lat.data(),lon.data(),n,x.data(),y.data(),32,false); });
+	double t_fwd_v = best_of(reps,[&]{ UTM::deg2utm_batch(lat.data(),lon.data(),n,x.data(),y.data(),32,true); });
+	double t_inv_s = best_of(reps,[&]{ UTM::utm2deg_batch(x.data(),y.data(),n,32,true,lat2.data(),lon2.data(),false); });
+	double t_inv_v = best_of(reps,[&]{ UTM::utm2deg_batch(x.data(),y.data(),n,32,true,lat2.data(),lon2.data(),true); });
+	double round_trip = 0;
+	for(size_t i=0; i<n; ++i)
+		round_trip = max(round_trip,m_per_deg*max(fabs(lat2[i]-lat[i]),fabs(lon2[i]-lon[i])));
+
+	printf("%zu points (best of %zu), round trip error %.2g m:\n",n,reps,round_trip);
+	printf(" deg2utm scalar  %8.2f Mpoints/s\n",n/t_fwd_s/1e6);
+	printf(" deg2utm batch   %8.2f Mpoints/s (%.1fx)\n",n/t_fwd_v/1e6,t_fwd_s/t_fwd_v);
+	printf(" utm2deg scalar  %8.2f Mpoints/s\n",n/t_inv_s/1e6);
+	printf(" utm2deg batch   %8.2f Mpoints/s (%.1fx)\n",n/t_inv_v/1e6,t_inv_s/t_inv_v);
+	return failures;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file bench_wpl.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include "bench.h"
+#include "../waypointgen1/coordstream.h"
+#include "../waypointgen1/patterngen.h"
+#include "../waypointgen1/wplwriter.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief reference The bytes autopath::save writes
+ * @param ap autopath
+ * @return File contents
+ */
+string reference(const autopath &ap) {
+	const string filename = "bench_wpl_reference.txt";
+	ap.save(filename);
+	mapped_file m(filename);
+	string s(m.view());
+	remove(filename.c_str());
+	return s;
+}
+
+/**
+ * @brief golden Compares Wplwriter output with autopath::save output
+ * @param name Name to print
+ * @param ap autopath
+ * @return true if byte identical
+ */
+bool golden(const string &name, const autopath &ap) {
+	const string filename = "bench_wpl_golden.txt";
+	Wplwriter::save(ap,filename);
+	string written;
+	{
+		mapped_file m(filename);
+		written = string(m.view());
+	}
+	remove(filename.c_str());
+	bool ok = written==reference(ap) && written==Wplwriter::format(ap);
+	printf(" %-28s %7zu waypoints, %9zu bytes %s\n",name.c_str(),ap.size(),written.size(),
+		   ok?"byte identical":"DIFFERENT");
+	return ok;
+}
+
+/**
+ * @brief edge_cases A path with values that are awkward to format
+ * @return autopath
+ */
+autopath edge_cases() {
+	autopath ap(VecCoord{coordinate(-33.8567844,151.213108,-12.5),
+						 coordinate(0,-0.0,1e7),
+						 coordinate(89.99999999999999,-179.99999999999997,0.000000000000005),
+						 coordinate(1e-300,123456789.123456789,-1e-15)});
+	ap.emplace_back(4,0,3,22,1.5,-2.25,1e20,0.1,55.476130,10.330925,50,0);
+	ap.emplace_back(static_cast<size_t>(-1),1,3,177,3,-1,0,0,0,0,0,1);
+	return ap;
+}
+} //namespace
+
+int bench_wpl(const vector<string> &args) {
+	int failures = 0;
+	failures += !golden("edge cases",edge_cases());
+	failures += !golden("sector",Patterngen::sector(home,target));
+	failures += !golden("zigzag 10 degrees",Patterngen::zigzag(home,target,10,10));
+	if(!args.empty()) {
+		autopath ap = Coordstream::csv_to_autopath(args[0]+"/spiral1_30m.csv");
+		failures += !golden("spiral1_30m.csv",ap);
+		//The committed file was written in text mode on Windows: "\r\r\n" line endings.
+		string txtfile = args[0]+"/Waypoint text files/spiral1_30m.txt";
+		mapped_file m(txtfile);
+		string committed;
+		for(size_t i=0; i<m.view().size(); ++i)
+			if(!(m.view()[i]=='\r' && i+1<m.view().size() && m.view()[i+1]=='\r'))
+				committed += m.view()[i];
+		bool ok = committed==Wplwriter::format(ap);
+		printf(" %-28s %7zu waypoints, %9zu bytes %s\n","spiral1_30m.txt (committed)",
+			   ap.size(),committed.size(),ok?"byte identical (CR CR LF -> CR LF)":"DIFFERENT");
+		failures += !ok;
+	}
+
+	const autopath ap = Patterngen::spiral(home,target,0.05); //about 190000 waypoints
+	failures += !golden("dense spiral",ap);
+
+	const string filename = "bench_wpl.txt";
+	const size_t reps = 5;
+	double t_old = best_of(reps,[&]{ ap.save(filename); });
+	double t_new = best_of(reps,[&]{ Wplwriter::save(ap,filename); });
+	string buf;
+	double t_fmt = best_of(reps,[&]{ Wplwriter::format(ap,buf); });
+	remove(filename.c_str());
+
+	double n = static_cast<double>(ap.size());
+	printf("Dense spiral, %zu waypoints, %.1f MB:\n",ap.size(),buf.size()/1e6);
+	printf(" autopath::save        %8.1f ms %8.2f Mwp/s\n",1e3*t_old,n/t_old/1e6);
+	printf(" Wplwriter::save       %8.1f ms %8.2f Mwp/s\n",1e3*t_new,n/t_new/1e6);
+	printf(" Wplwriter::format     %8.1f ms %8.2f Mwp/s (no file)\n",1e3*t_fmt,n/t_fmt/1e6);
+	printf(" speedup               %8.1fx\n",t_old/t_new);
+	return failures;
+}
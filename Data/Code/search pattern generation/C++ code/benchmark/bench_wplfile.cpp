@@ -0,0 +1,179 @@
+/**
+ * @file bench_wplfile.cpp
+ * @author Mikael Westermann
+ */
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "../waypointgen1/mappedfile.h"
+#include "../waypointgen1/patterngen.h"
+#include "../waypointgen1/wplfile.h"
+#include "../waypointgen1/wplwriter.h"
+
+using namespace std;
+
+namespace {
+/**
+ * @brief read_file Reads a whole file
+ * @param filename Filename
+ * @return File contents
+ */
+string read_file(const string &filename) {
+	mapped_file m(filename);
+	return string(m.view());
+}
+
+/**
+ * @brief reindexed A path with the indices a Wplfile writes (the position)
+ * @param wps Waypoints
+ * @return Copy with index i at position i
+ */
+VecWP reindexed(VecWP wps) {
+	for(size_t i=0; i<wps.size(); ++i)
+		wps[i].index = i;
+	return wps;
+}
+
+/**
+ * @brief check Compares a waypoint file with the expected mission
+ * @param name Name to print
+ * @param filename Waypoint file
+ * @param expected Expected waypoints
+ * @param fixed Expected fixed-width records
+ * @return true if equal
+ */
+bool check(const string &name, const string &filename, const VecWP &expected, bool fixed) {
+	string text = read_file(filename);
+	Wplfile f(filename);
+	bool ok = Wplfile::unpad(text)==Wplwriter::format(reindexed(expected)) && f.size()==expected.size()
+			&& f.fixed_width()==fixed && (!fixed || text.size()==Wplwriter::header.size()+expected.size()*Wplfile::record_width);
+	printf(" %-40s %7zu waypoints %s\n",name.c_str(),expected.size(),ok?"ok":"WRONG");
+	return ok;
+}
+
+/**
+ * @brief loiter A loiter waypoint with a wrong index (Wplfile writes the position)
+ * @param k Number
+ * @return Waypoint
+ */
+waypoint loiter(size_t k) {
+	return waypoint(0,0,0,19,60,0,0,0,55.476+1e-5*k,10.327-1e-5*k,124,1);
+}
+} //namespace
+
+int bench_wplfile(const vector<string> &) {
+	int failures = 0;
+	const string filename = "bench_wplfile.txt";
+	remove(filename.c_str());
+
+	//Fixed-width file: save, append, patch, reopen.
+	VecWP expected = Patterngen::spiral(home,target,10);
+	{
+		Wplfile f(filename,false);
+		f.save(expected);
+		for(size_t k=0; k<5; ++k) {
+			f.append(loiter(k));
+			expected.push_back(loiter(k));
+		}
+		f.append(VecWP{loiter(5),loiter(6)});
+		expected.push_back(loiter(5));
+		expected.push_back(loiter(6));
+		f.patch(3,loiter(7));
+		expected[3] = loiter(7);
+		f.patch(expected.size()-1,loiter(8));
+		expected.back() = loiter(8);
+	}
+	failures += !check("save, append and patch (fixed width)",filename,expected,true);
+
+	//A crash in the middle of an append: the partial line goes away on open.
+	string before = read_file(filename);
+	{
+		FILE *f = fopen(filename.c_str(),"ab");
+		fputs("999\t0\t0\t19\t60.000",f);
+		fclose(f);
+	}
+	{
+		Wplfile f(filename,false);
+		bool ok = f.size()==expected.size() && read_file(filename)==before;
+		printf(" %-40s %7zu waypoints %s\n","torn last line removed on open",f.size(),ok?"ok":"WRONG");
+		failures += !ok;
+		f.append(loiter(9));
+		expected.push_back(loiter(9));
+	}
+	failures += !check("append after recovery",filename,expected,true);
+
+	//A waypoint too wide for a record: rewritten with plain lines.
+	{
+		Wplfile f(filename,false);
+		waypoint wide(0,0,0,19,1e100,0,0,0,55.476,10.327,124,1);
+		f.patch(1,wide);
+		expected[1] = wide;
+		f.append(loiter(10));
+		expected.push_back(loiter(10));
+	}
+	failures += !check("too wide -> plain lines",filename,expected,false);
+	{
+		Wplfile f(filename,false);
+		f.save(expected);
+	}
+	failures += !check("save, too wide -> plain lines",filename,expected,false);
+
+	//A plain file written by autopath::save.
+	autopath plain = Patterngen::zigzag(home,target,10,10);
+	plain.save(filename);
+	expected = plain;
+	{
+		Wplfile f(filename,false);
+		f.append(loiter(0));
+		expected.push_back(loiter(0));
+		f.patch(2,loiter(1));
+		expected[2] = loiter(1);
+	}
+	failures += !check("autopath::save file, append and patch",filename,expected,false);
+	remove(filename.c_str());
+	{
+		Wplfile f(filename,false);
+		f.append(loiter(2));
+	}
+	failures += !check("new file, append",filename,VecWP{loiter(2)},true);
+
+	//Latency on a long mission.
+	const autopath ap = Patterngen::spiral(home,target,0.5); //about 19000 waypoints
+	printf("Mission of %zu waypoints, %.1f MB (%.1f MB fixed width):\n",ap.size(),
+		   Wplwriter::format(ap).size()/1e6,ap.size()*Wplfile::record_width/1e6);
+	for(int durable=0; durable<2; ++durable) {
+		printf("%s\n",durable?"Flushed to disk (fsync/fdatasync):":"Not flushed (page cache):");
+		const size_t reps = 50;
+		vector<double> ms;
+		for(size_t r=0; r<reps; ++r) {
+			Stopwatch d;
+			Wplwriter::save(ap,filename);
+			ms.push_back(1e3*d.seconds());
+		}
+		print_latency("Wplwriter::save (no fsync)",ms);
+		Wplfile f(filename,durable!=0);
+		ms.clear();
+		for(size_t r=0; r<reps; ++r) {
+			Stopwatch d;
+			f.save(ap);
+			ms.push_back(1e3*d.seconds());
+		}
+		print_latency("Wplfile::save (atomic)",ms);
+		ms.clear();
+		for(size_t r=0; r<reps; ++r) {
+			Stopwatch d;
+			f.append(loiter(r));
+			ms.push_back(1e3*d.seconds());
+		}
+		print_latency("Wplfile::append",ms);
+		ms.clear();
+		for(size_t r=0; r<reps; ++r) {
+			Stopwatch d;
+			f.patch((r*7919)%f.size(),loiter(r));
+			ms.push_back(1e3*d.seconds());
+		}
+		print_latency("Wplfile::patch (in place)",ms);
+	}
+	remove(filename.c_str());
+	return failures;
+}
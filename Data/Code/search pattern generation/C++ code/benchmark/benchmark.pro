@@ -0,0 +1,54 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+CONFIG += c++17
+
+# qmake CONFIG+=native builds for this CPU with FMA contraction, so that
+# results compared exactly against brute force are checked under other rounding.
+native {
+    QMAKE_CXXFLAGS += -march=native -ffp-contract=fast
+}
+
+SOURCES += main.cpp \
+    bench_patterns.cpp \
+    bench_kml.cpp \
+    bench_csv.cpp \
+    bench_wpl.cpp \
+    bench_soa.cpp \
+    bench_utm.cpp \
+    bench_geotag.cpp \
+    bench_wplfile.cpp \
+    bench_mavlink.cpp \
+    bench_simplify.cpp \
+    bench_coverage.cpp \
+    bench_partition.cpp \
+    bench_route.cpp \
+    bench_check.cpp \
+    bench_index.cpp
+
+include(deployment.pri)
+qtcAddDeployment()
+
+HEADERS += \
+    bench.h \
+    ../waypointgen1/waypointgen.h \
+    ../waypointgen1/utm.h \
+    ../waypointgen1/utmbatch.h \
+    ../waypointgen1/patterngen.h \
+    ../waypointgen1/mappedfile.h \
+    ../waypointgen1/coordstream.h \
+    ../waypointgen1/wplwriter.h \
+    ../waypointgen1/soapath.h \
+    ../waypointgen1/geotag.h \
+    ../waypointgen1/wplfile.h \
+    ../waypointgen1/missionitem.h \
+    ../waypointgen1/localframe.h \
+    ../waypointgen1/batch.h \
+    ../waypointgen1/parallel.h \
+    ../waypointgen1/pathsimplify.h \
+    ../waypointgen1/coverage.h \
+    ../waypointgen1/partition.h \
+    ../waypointgen1/routeorder.h \
+    ../waypointgen1/missioncheck.h \
+    ../waypointgen1/missionindex.h
@@ -0,0 +1,80 @@
+/**
+ * @file main.cpp
+ * @author Mikael Westermann
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bench.h"
+
+using namespace std;
+
+/**
+ * @brief The benchmark struct A named benchmark
+ */
+struct benchmark {
+	/** @brief name Name passed on the command line */
+	const char *name;
+	/** @brief usage Arguments and description */
+	const char *usage;
+	/** @brief run Benchmark function */
+	int (*run)(const vector<string> &);
+};
+
+/** @brief benchmarks All benchmarks, in the order they are run by "all" */
+static const benchmark benchmarks[] = {
+	{"patterns", "[csvdir]  pattern generation vs. csv import", bench_patterns},
+	{"kml", "[kmldir]  kml coordinate extraction throughput", bench_kml},
+	{"csv", "[csvdir]  csv coordinate import throughput", bench_csv},
+	{"wpl", "[csvdir]  waypoint file writing, byte equality with autopath::save", bench_wpl},
+	{"soa", "          structure-of-arrays path memory and throughput", bench_soa},
+	{"utm", "[csvdir]  batched UTM conversion accuracy and throughput", bench_utm},
+	{"geotag", "[poses.csv]  detection geotagging and detection-to-mission-file latency", bench_geotag},
+	{"wplfile", "          incremental waypoint file: append/patch latency vs. full save", bench_wplfile},
+	{"mavlink", "          MAVLink v2 MISSION_ITEM_INT encoding: known-good frames and items/s", bench_mavlink},
+	{"simplify", "[csvdir]  Douglas-Peucker waypoint reduction: items, deviation, threads", bench_simplify},
+	{"coverage", "          polygon lawnmower planning: direction, cells, coverage, planning time", bench_coverage},
+	{"partition", "          one area, several aircraft: balance, coverage, planning time vs. threads", bench_partition},
+	{"route", "          point of interest ordering (TSP heuristic): route length and time", bench_route},
+	{"check", "          mission validation and flight time: checks and legs/s (scalar vs. AVX2)", bench_check},
+	{"index", "          spatial index over waypoints and legs: build and query time vs. brute force", bench_index},
+};
+
+/**
+ * @brief main Runs the benchmark(s) named by the first argument.
+ * @param argc 1 + Number of arguments
+ * @param argv benchmark name followed by its arguments
+ * @return 0 if all benchmarks succeeded
+ */
+int main(int argc, char** argv) {
+	cout << "waypoint benchmarks by Mikael Westermann." << endl;
+	if(argc<2) {
+		cout << "Usage: " << argv[0] << " <benchmark|all> [arguments]\n"
+			 << "Benchmarks:" << endl;
+		for(const benchmark &b:benchmarks)
+			cout << "  " << b.name << " " << b.usage << endl;
+		return 0;
+	}
+	string name(argv[1]);
+	vector<string> args(argv+2,argv+argc);
+	int failures = 0;
+	bool found = false;
+	for(const benchmark &b:benchmarks) {
+		if(name!="all" && name!=b.name)
+			continue;
+		found = true;
+		cout << "--- " << b.name << " ---" << endl;
+		try {
+			if(b.run(args)!=0)
+				++failures;
+		} catch(const exception &e) {
+			cout << "Error: " << e.what() << endl;
+			++failures;
+		}
+	}
+	if(!found) {
+		cout << "Unknown benchmark \"" << name << "\"." << endl;
+		return 1;
+	}
+	return failures;
+}
@@ -2,7 +2,8 @@ TEMPLATE = app
 CONFIG += console
 CONFIG -= app_bundle
 CONFIG -= qt
-CONFIG += c++11
+CONFIG += c++17
+CONFIG += thread
 
 SOURCES += main.cpp
 
@@ -10,5 +11,17 @@ include(deployment.pri)
 qtcAddDeployment()
 
 HEADERS += \
-    ../waypointgen1/waypointgen.h
+    ../waypointgen1/waypointgen.h \
+    ../waypointgen1/mappedfile.h \
+    ../waypointgen1/coordstream.h \
+    ../waypointgen1/wplwriter.h \
+    ../waypointgen1/batch.h \
+    ../waypointgen1/parallel.h \
+    ../waypointgen1/utm.h \
+    ../waypointgen1/localframe.h \
+    ../waypointgen1/pathsimplify.h \
+    ../waypointgen1/coverage.h \
+    ../waypointgen1/soapath.h \
+    ../waypointgen1/utmbatch.h \
+    ../waypointgen1/missioncheck.h
 
@@ -0,0 +1,200 @@
+/**
+ * @file batch.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "waypointgen.h"
+#include "coordstream.h"
+#include "pathsimplify.h"
+#include "missioncheck.h"
+
+/**
+ * @brief The Batchconvert class Converts many files on several threads
+ *
+ * Worker threads take the next file from a shared counter, so fast and slow
+ * files even out. Results are reported on the calling thread, in the order
+ * of the file list, as soon as all earlier files are done, so console output
+ * is never interleaved.
+ */
+class Batchconvert {
+public:
+	/**
+	 * @brief parse_args Splits arguments into file names and "-j N" / "-jN"
+	 * @param argc 1 + Number of arguments
+	 * @param argv Arguments
+	 * @param files File names (output)
+	 * @return Number of threads (1 if not given, hardware threads for "-j 0")
+	 */
+	static size_t parse_args(int argc, char** argv, vector<string> &files) {
+		size_t jobs = 1;
+		for(int i=1; i<argc; ++i) {
+			string arg(argv[i]);
+			if(arg.compare(0,2,"-j")!=0) {
+				files.push_back(arg);
+				continue;
+			}
+			string n = arg.size()>2?arg.substr(2):(i+1<argc?string(argv[++i]):string());
+			char *end = nullptr;
+			long j = strtol(n.c_str(),&end,10);
+			if(n.empty() || *end!='\0' || j<0)
+				throw(invalid_argument("Expected a number of threads after -j, got \""+n+"\"."));
+			jobs = j>0?static_cast<size_t>(j):max<size_t>(1,thread::hardware_concurrency());
+		}
+		return jobs;
+	}
+
+	/**
+	 * @brief run Converts files concurrently
+	 * @param files File names
+	 * @param threads Number of worker threads
+	 * @param convert Conversion: convert(file), throws on failure
+	 * @param report Called in file order: report(index, success, error message)
+	 * @return Number of files converted successfully
+	 */
+	template<class Convert, class Report>
+	static size_t run(const vector<string> &files, size_t threads, Convert convert, Report report) {
+		size_t n = files.size();
+		vector<string> errors(n);
+		vector<char> done(n,0), ok(n,0);
+		mutex m;
+		condition_variable cv;
+		atomic<size_t> next(0);
+		auto work = [&]() {
+			for(size_t i; (i=next++)<n; ) {
+				bool success = true;
+				string error;
+				try {
+					convert(files[i]);
+				} catch(const exception &e) {
+					success = false;
+					error = e.what();
+				}
+				lock_guard<mutex> lock(m);
+				ok[i] = success;
+				errors[i] = move(error);
+				done[i] = 1;
+				cv.notify_all();
+			}
+		};
+		threads = max<size_t>(1,min(threads,n));
+		vector<thread> pool;
+		for(size_t t=0; t<threads; ++t)
+			pool.emplace_back(work);
+		size_t converted = 0;
+		for(size_t i=0; i<n; ++i) {
+			unique_lock<mutex> lock(m);
+			cv.wait(lock,[&]{ return done[i]!=0; });
+			bool success = ok[i];
+			string error = move(errors[i]);
+			lock.unlock();
+			converted += success;
+			report(i,success,error);
+		}
+		for(thread &t:pool)
+			t.join();
+		return converted;
+	}
+
+	/**
+	 * @brief main Converts the files named on the command line to waypoint txt files, while outputting to console.
+	 * With "-j N", N files are converted at a time ("-j 0": one per hardware thread).
+	 * With "-s M", waypoints are removed as long as the path stays within M metres (Douglas-Peucker).
+	 * With "-c", every mission is checked (Missioncheck) and its length, flight time and problems are printed.
+	 * @param argc 1 + Number of arguments
+	 * @param argv File names and optionally -j N, -s M and -c
+	 * @param kind File kind in messages ("kml", "csv")
+	 * @param extract Reads the coordinates of a file: extract(file)
+	 * @param convert Writes the waypoint file of a file directly: convert(file)
+	 * @return 0, 1 for bad arguments
+	 */
+	template<class Extract, class Convert>
+	static int main(int argc, char** argv, const string &kind, Extract extract, Convert convert) {
+		cout << kind << " to waypoint file converter by Mikael Westermann.\n"
+			 << "Pass " << kind << " file name(s) as argument(s) "
+			 << "when running this program (-j N: convert N files at a time,\n"
+			 << "-s M: remove waypoints within M metres of the path, -c: check the missions)." << endl;
+		vector<string> files;
+		size_t jobs;
+		double tolerance;
+		bool check;
+		try {
+			jobs = parse_args(argc,argv,files);
+			tolerance = Pathsimplify::parse_tolerance(files);
+			check = Missioncheck::parse_check(files);
+		} catch(const invalid_argument &e) {
+			cout << e.what() << endl;
+			return 1;
+		}
+		int no_of_files = static_cast<int>(files.size());
+		if(no_of_files>0) {
+			cout << "Converting " << no_of_files << " file" << (no_of_files!=1?"s":"")
+				 << (jobs>1?" on "+to_string(jobs)+" threads:":":") << endl;
+			mutex m;
+			map<string,Pathsimplify::report> reports;
+			map<string,Missioncheck::report> checks;
+			const Missioncheck::settings aircraft;
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			int converted = static_cast<int>(run(files,jobs,
+				[&](const string &file) {
+					if(tolerance<=0 && !check) {
+						convert(file);
+						return;
+					}
+					Pathsimplify::report r;
+					VecCoord c = extract(file);
+					autopath p(tolerance>0?Pathsimplify::simplify(c,tolerance,&r):c);
+					Missioncheck::report mc;
+					if(check)
+						mc = Missioncheck::check(p,aircraft);
+					Wplwriter::save(p,file.substr(0,file.find_last_of('.'))+".txt");
+					lock_guard<mutex> lock(m);
+					reports[file] = r;
+					checks[file] = mc;
+				},
+				[&](size_t i, bool success, const string &error) {
+					const string &file = files[i];
+					cout << " Converting " << kind << " file \"" << file
+						 << "\" to waypoint file \""
+						 << (file.substr(0,file.find_last_of('.'))+".txt")
+						 << "\"... " << (success?"Done!":error);
+					if(success && tolerance>0) {
+						lock_guard<mutex> lock(m);
+						const Pathsimplify::report &r = reports[file];
+						cout << " (" << r.before << " -> " << r.after << " waypoints, max deviation "
+							 << r.max_deviation << " m)";
+					}
+					if(success && check) {
+						lock_guard<mutex> lock(m);
+						const Missioncheck::report &r = checks[file];
+						cout << " (" << r.distance/1e3 << " km, " << r.time/60 << " min at " << aircraft.speed << " m/s)";
+						for(const string &problem:Missioncheck::problems(r,aircraft))
+							cout << "\n  " << problem;
+					}
+					cout << endl;
+				}));
+			double seconds = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+			if(converted==no_of_files)
+				cout << "All files have been converted." << endl;
+			else
+				cout << converted << " file" << (converted!=1?"s have":" has")
+					 << " been converted." << endl;
+			cout << "Time: " << seconds << " s (" << (seconds>0?converted/seconds:0)
+				 << " files/s)." << endl;
+		}
+		else {
+			cout << "No file names passed as arguments. Exiting." << endl;
+		}
+		return 0;
+	}
+};
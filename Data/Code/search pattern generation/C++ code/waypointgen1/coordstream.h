@@ -0,0 +1,269 @@
+/**
+ * @file coordstream.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "waypointgen.h"
+#include "mappedfile.h"
+#include "wplwriter.h"
+
+/**
+  * Single-pass coordinate readers.
+  *
+  * Kmlmanip reads line by line, collects the coordinate text in strings and
+  * converts them with stod. The readers here map the file and parse the
+  * numbers in place with from_chars (locale independent), handing each
+  * coordinate to a callback or appending it straight to a VecCoord.
+  * No strings are allocated.
+  */
+
+/**
+ * @brief The parse_error struct An exception for malformed file contents.
+ */
+struct parse_error : public runtime_error {
+	/**
+	 * @brief parse_error ctor
+	 * @param filename name of file being parsed
+	 * @param offset byte offset of the error
+	 * @param what what was expected
+	 */
+	parse_error(const string& filename, size_t offset, const string &what)
+		:runtime_error(
+			 (string("Error parsing file \"")+filename+string("\" at byte ")
+			  +to_string(offset)+string(": expected ")+what+string(".")))
+	{ }
+};
+
+/**
+ * @brief The Coordstream class Fast coordinate reading function wrapper
+ */
+class Coordstream {
+protected:
+	/**
+	 * @brief is_space Whitespace as used between kml tuples
+	 * @param c Character
+	 * @return c is a space, tab or newline
+	 */
+	static bool is_space(char c) {
+		return c==' ' || c=='\n' || c=='\r' || c=='\t';
+	}
+
+	/**
+	 * @brief parse_number Parses a double at p and advances p past it
+	 * @param p Current position
+	 * @param end End of buffer
+	 * @param value Parsed value
+	 * @return true if a number was parsed
+	 */
+	static bool parse_number(const char *&p, const char *end, double &value) {
+		if(p<end && *p=='+')
+			++p;
+		from_chars_result r = from_chars(p,end,value);
+		if(r.ec!=errc())
+			return false;
+		p = r.ptr;
+		return true;
+	}
+
+	/**
+	 * @brief skip_blanks Skips spaces and tabs
+	 * @param p Current position
+	 * @param end End of buffer
+	 */
+	static void skip_blanks(const char *&p, const char *end) {
+		while(p<end && (*p==' ' || *p=='\t'))
+			++p;
+	}
+
+	/**
+	 * @brief kml_parse_tuples Parses "lon,lat[,alt]" tuples up to the next '<'
+	 * @param p Current position, advanced to the '<' (or end)
+	 * @param end End of buffer
+	 * @param begin Start of buffer (error offsets)
+	 * @param filename Name of file (error messages)
+	 * @param f Callback receiving each coordinate
+	 * @return Number of coordinates
+	 */
+	template<class F>
+	static size_t kml_parse_tuples(const char *&p, const char *end, const char *begin,
+								   const string &filename, F &f) {
+		size_t n = 0;
+		while(true) {
+			while(p<end && is_space(*p))
+				++p;
+			if(p==end || *p=='<')
+				return n;
+			double lon, lat, alt = 0;
+			if(!parse_number(p,end,lon) || p==end || *p++!=',' ||
+					!parse_number(p,end,lat))
+				throw(parse_error(filename,p-begin,"lon,lat[,alt]"));
+			if(p<end && *p==',' && (++p, !parse_number(p,end,alt)))
+				throw(parse_error(filename,p-begin,"altitude"));
+			if(p<end && !is_space(*p) && *p!='<')
+				throw(parse_error(filename,p-begin,"whitespace after coordinate"));
+			f(coordinate(lat,lon,alt)); //--------------------WEIRD GOOGLE FORMAT! LONGITUDE FIRST???---------//
+			++n;
+		}
+	}
+
+public:
+	/**
+	 * @brief kml_parse Calls f for every coordinate in kml text.
+	 * All tuples inside <coordinates> elements are read, including ones on the
+	 * same line as the tags. A missing altitude becomes 0.
+	 * @param text kml file contents
+	 * @param f Callback: f(const coordinate&)
+	 * @param filename Name of file (error messages)
+	 * @return Number of coordinates
+	 */
+	template<class F>
+	static size_t kml_parse(string_view text, F f, const string &filename="") {
+		static const char tag[] = "<coordinates";
+		const char *begin = text.data();
+		const char *end = begin+text.size();
+		const char *p = begin;
+		size_t n = 0;
+		while(true) {
+			string_view rest(p,end-p);
+			size_t pos = rest.find(tag);
+			if(pos==string_view::npos)
+				return n;
+			p += pos+sizeof(tag)-1;
+			//<coordinates> or <coordinates ...>, but not eg. <coordinatesX>
+			if(p==end || (*p!='>' && !is_space(*p)))
+				continue;
+			const char *gt = static_cast<const char*>(memchr(p,'>',end-p));
+			if(!gt)
+				throw(parse_error(filename,p-begin,"'>'"));
+			p = gt+1;
+			if(gt[-1]=='/') //<coordinates/>
+				continue;
+			n += kml_parse_tuples(p,end,begin,filename,f);
+		}
+	}
+
+	/**
+	 * @brief kml_for_each Calls f for every coordinate in kml file
+	 * @param kmlfile kml filename
+	 * @param f Callback: f(const coordinate&)
+	 * @return Number of coordinates
+	 */
+	template<class F>
+	static size_t kml_for_each(const string &kmlfile, F f) {
+		mapped_file m(kmlfile);
+		return kml_parse(m.view(),f,kmlfile);
+	}
+
+	/**
+	 * @brief kml_extract_coordinates Opens kml file and extracts coordinates
+	 * @param kmlfile kml filename
+	 * @return Vector of coordinates in kml file
+	 */
+	static const VecCoord kml_extract_coordinates(const string &kmlfile) {
+		VecCoord result;
+		kml_for_each(kmlfile,[&result](const coordinate &c) { result.push_back(c); });
+		return move(result);
+	}
+
+	/**
+	 * @brief csv_parse Appends the coordinates of csv text to result.
+	 * Rows are "lat,lon,alt" with optional blanks around the numbers and
+	 * LF or CRLF line endings. Blank lines (eg. a trailing newline) are skipped.
+	 * @param text csv file contents
+	 * @param result Vector to append to
+	 * @param filename Name of file (error messages)
+	 * @return Number of coordinates
+	 */
+	static size_t csv_parse(string_view text, VecCoord &result, const string &filename="") {
+		const char *begin = text.data();
+		const char *end = begin+text.size();
+		const char *p = begin;
+		//One row per line: reserve once, so push_back never reallocates.
+		size_t lines = 1;
+		for(const char *q=begin; (q=static_cast<const char*>(memchr(q,'\n',end-q))); ++q)
+			++lines;
+		result.reserve(result.size()+lines);
+		size_t n = 0;
+		while(p<end) {
+			skip_blanks(p,end);
+			if(p<end && *p=='\r')
+				++p;
+			if(p<end && *p=='\n') {
+				++p;
+				continue;
+			}
+			if(p==end)
+				break;
+			double v[3];
+			for(int i=0; i<3; ++i) {
+				skip_blanks(p,end);
+				if(!parse_number(p,end,v[i]))
+					throw(parse_error(filename,p-begin,"lat,lon,alt"));
+				skip_blanks(p,end);
+				if(i<2 && (p==end || *p++!=','))
+					throw(parse_error(filename,p-begin,"','"));
+			}
+			if(p<end && *p=='\r')
+				++p;
+			if(p<end && *p++!='\n')
+				throw(parse_error(filename,p-begin-1,"end of line"));
+			result.emplace_back(v[0],v[1],v[2]);
+			++n;
+		}
+		return n;
+	}
+
+	/**
+	 * @brief csv_extract_coordinates Opens csv file and extracts coordinates
+	 * @param csvfile csv filename
+	 * @return Vector of coordinates in csv file
+	 */
+	static const VecCoord csv_extract_coordinates(const string &csvfile) {
+		mapped_file m(csvfile);
+		VecCoord result;
+		csv_parse(m.view(),result,csvfile);
+		return move(result);
+	}
+
+	/**
+	 * @brief csv_to_autopath Generates autopath from csv file
+	 * @param csvfile csv filename
+	 * @return autopath of waypoints generated from coordinates in csvfile
+	 */
+	static const autopath csv_to_autopath(const string &csvfile) {
+		return move(autopath(csv_extract_coordinates(csvfile)));
+	}
+
+	/**
+	 * @brief csv2wp Converts csv file to autopath waypoint text file
+	 * @param csvfile csv filename
+	 */
+	static void csv2wp(const string &csvfile) {
+		string wpfilename = csvfile.substr(0,csvfile.find_last_of('.'))+".txt";
+		autopath p = csv_to_autopath(csvfile);
+		Wplwriter::save(p,wpfilename);
+	}
+
+	/**
+	 * @brief kml_to_autopath Generates autopath from kml file
+	 * @param kmlfile kml filename
+	 * @return autopath of waypoints generated from coordinates in kmlfile
+	 */
+	static const autopath kml_to_autopath(const string &kmlfile) {
+		return move(autopath(kml_extract_coordinates(kmlfile)));
+	}
+
+	/**
+	 * @brief kml2wp Converts kml file to autopath waypoint text file
+	 * @param kmlfile kml filename
+	 */
+	static void kml2wp(const string &kmlfile) {
+		string wpfilename = kmlfile.substr(0,kmlfile.find_last_of('.'))+".txt";
+		autopath p = kml_to_autopath(kmlfile);
+		Wplwriter::save(p,wpfilename);
+	}
+};
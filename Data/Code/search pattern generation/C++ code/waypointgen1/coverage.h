@@ -0,0 +1,398 @@
+/**
+ * @file coverage.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "waypointgen.h"
+#include "localframe.h"
+
+/**
+  * Lawnmower (boustrophedon) coverage of a search polygon.
+  *
+  * zigzag.m sweeps the rectangle-like area between two coordinates. Here the
+  * area is any simple polygon, e.g. a coastline drawn in Google Earth and read
+  * with Coordstream::kml_extract_coordinates. Parallel tracks, spacing metres
+  * apart, are clipped to the polygon and flown back and forth:
+  * VecCoord area = Coordstream::kml_extract_coordinates("bay.kml");
+  * autopath p = Coverage::lawnmower(area,20,50);
+  *
+  * The direction of the tracks is chosen to fly as few tracks (and turns) as
+  * possible. For a convex polygon the best direction is parallel to one of its
+  * edges, so the edges of the convex hull are candidates, along with every
+  * whole degree for concave polygons. Each candidate is scored by counting
+  * track crossings per edge, without building the tracks.
+  *
+  * Where a concave polygon splits a track in several pieces, the area is
+  * decomposed into cells along the tracks (a boustrophedon decomposition:
+  * a new cell starts wherever the pieces of two neighbouring tracks do not
+  * overlap one to one). Every track crosses a cell in one piece, which is
+  * what the back and forth needs from a convex part, with fewer cells than a
+  * convex decomposition. Cells are flown nearest first from the start point;
+  * the transit to the next cell is a straight line.
+  *
+  * All geometry is done in metres on the local tangent plane of the first
+  * polygon vertex (localframe).
+  */
+
+/**
+ * @brief The Coverage class Polygon coverage planning function wrapper
+ */
+class Coverage {
+public:
+	/**
+	 * @brief The point struct A point on the local tangent plane
+	 */
+	struct point {
+		/**
+		 * @brief x East (m)
+		 * @brief y North (m)
+		 */
+		double x, y;
+	};
+
+	/** @brief ring Polygon vertices (not closed: the last vertex is not the first) */
+	typedef vector<point> ring;
+
+	/**
+	 * @brief The report struct Summary of a plan
+	 */
+	struct report {
+		/** @brief angle Track direction (degrees counterclockwise from east, 0-180) */
+		double angle;
+		/**
+		 * @brief tracks Number of track pieces flown
+		 * @brief cells Number of cells
+		 */
+		size_t tracks, cells;
+		/**
+		 * @brief area Polygon area (m^2)
+		 * @brief length Path length (m)
+		 */
+		double area, length;
+	};
+
+	/**
+	 * @brief to_local Projects a polygon on a local tangent plane
+	 * @param polygon Polygon (a closing copy of the first vertex is dropped)
+	 * @param f Local frame
+	 * @return Ring
+	 */
+	static const ring to_local(const VecCoord &polygon, const localframe &f) {
+		size_t n = polygon.size();
+		if(n>1 && polygon.front().get_lat()==polygon.back().get_lat()
+				&& polygon.front().get_lon()==polygon.back().get_lon())
+			--n;
+		if(n<3)
+			throw(invalid_argument("A search polygon needs at least 3 vertices, got "+to_string(n)+"."));
+		ring r(n);
+		for(size_t i=0; i<n; ++i)
+			f.to_local(polygon[i],r[i].x,r[i].y);
+		return move(r);
+	}
+
+	/**
+	 * @brief area Area of a ring (shoelace formula)
+	 * @param r Ring
+	 * @return Area (m^2)
+	 */
+	static double area(const ring &r) {
+		double a = 0;
+		for(size_t i=0, j=r.size()-1; i<r.size(); j=i++)
+			a += r[j].x*r[i].y-r[i].x*r[j].y;
+		return fabs(a)/2;
+	}
+
+	/**
+	 * @brief best_angle Track direction with the fewest track pieces
+	 * @param r Ring
+	 * @param spacing Track spacing (m)
+	 * @return Angle (degrees counterclockwise from east, 0-180)
+	 */
+	static double best_angle(const ring &r, double spacing) {
+		vector<point> h = hull(r);
+		vector<double> candidates;
+		for(size_t i=0, j=h.size()-1; i<h.size(); j=i++) {
+			double a = atan2(h[i].y-h[j].y,h[i].x-h[j].x)*(180/M_PI);
+			candidates.push_back(a<0?a+180:(a>=180?a-180:a));
+		}
+		for(int a=0; a<180; ++a) //a concave polygon can do better between hull edges
+			candidates.push_back(a);
+		sort(candidates.begin(),candidates.end());
+		double best = 0;
+		size_t fewest = numeric_limits<size_t>::max();
+		for(size_t i=0; i<candidates.size(); ++i) {
+			if(i>0 && candidates[i]-candidates[i-1]<1e-9)
+				continue;
+			size_t n = count_tracks(r,spacing,candidates[i]);
+			if(n<fewest) {
+				fewest = n;
+				best = candidates[i];
+			}
+		}
+		return best;
+	}
+
+	/**
+	 * @brief count_tracks Number of track pieces in a direction, counted from
+	 * the edge crossings without building the tracks
+	 * @param r Ring
+	 * @param spacing Track spacing (m)
+	 * @param angle Track direction (degrees counterclockwise from east)
+	 * @return Track pieces
+	 */
+	static size_t count_tracks(const ring &r, double spacing, double angle) {
+		double c = cos(angle*(M_PI/180)), s = sin(angle*(M_PI/180));
+		vector<double> v(r.size());
+		for(size_t i=0; i<r.size(); ++i)
+			v[i] = -r[i].x*s+r[i].y*c;
+		double v0;
+		size_t n = track_layout(v,spacing,v0);
+		size_t crossings = 0;
+		for(size_t i=0, j=r.size()-1; i<r.size(); j=i++) {
+			size_t k0, k1;
+			if(tracks_crossed(v[j],v[i],v0,spacing,n,k0,k1))
+				crossings += k1-k0;
+		}
+		return crossings/2;
+	}
+
+	/**
+	 * @brief sweep Plans the back and forth over a ring in a given direction
+	 * @param r Ring
+	 * @param spacing Track spacing (m)
+	 * @param angle Track direction (degrees counterclockwise from east)
+	 * @param start Start point (the first cell is the one nearest to it)
+	 * @param rep Output: Summary, if not null
+	 * @return Path: both ends of every track piece, in flying order
+	 */
+	static const vector<point> sweep(const ring &r, double spacing, double angle, const point &start,
+									 report *rep=nullptr) {
+		if(!(spacing>0))
+			throw(invalid_argument("Track spacing must be positive."));
+		double c = cos(angle*(M_PI/180)), s = sin(angle*(M_PI/180));
+		vector<double> u(r.size()), v(r.size());
+		for(size_t i=0; i<r.size(); ++i) {
+			u[i] = r[i].x*c+r[i].y*s;
+			v[i] = -r[i].x*s+r[i].y*c;
+		}
+		double v0;
+		size_t n = track_layout(v,spacing,v0);
+
+		//Crossings of every track with the edges, sorted along the track.
+		vector<vector<double>> xs(n);
+		for(size_t i=0, j=r.size()-1; i<r.size(); j=i++) {
+			size_t k0, k1;
+			if(!tracks_crossed(v[j],v[i],v0,spacing,n,k0,k1))
+				continue;
+			double du = (u[i]-u[j])/(v[i]-v[j]);
+			for(size_t k=k0; k<k1; ++k)
+				xs[k].push_back(u[j]+(v0+k*spacing-v[j])*du);
+		}
+
+		//Track pieces into cells.
+		vector<cell> cells;
+		vector<pair<double,double>> prev, cur;
+		vector<size_t> prev_cell, cur_cell;
+		for(size_t k=0; k<n; ++k) {
+			sort(xs[k].begin(),xs[k].end());
+			cur.clear();
+			for(size_t i=0; i+1<xs[k].size(); i+=2)
+				if(xs[k][i]<xs[k][i+1]) //not a touching vertex
+					cur.emplace_back(xs[k][i],xs[k][i+1]);
+			cur_cell.assign(cur.size(),0);
+			for(size_t i=0; i<cur.size(); ++i) {
+				size_t overlaps = 0, p = 0;
+				for(size_t j=0; j<prev.size(); ++j)
+					if(prev[j].first<cur[i].second && cur[i].first<prev[j].second) {
+						++overlaps;
+						p = j;
+					}
+				bool extend = overlaps==1;
+				for(size_t j=0; extend && j<cur.size(); ++j)
+					extend = j==i || !(prev[p].first<cur[j].second && cur[j].first<prev[p].second);
+				if(extend) {
+					cur_cell[i] = prev_cell[p];
+				}
+				else {
+					cur_cell[i] = cells.size();
+					cells.push_back(cell{k,{}});
+				}
+				cells[cur_cell[i]].pieces.push_back(cur[i]);
+			}
+			prev.swap(cur);
+			prev_cell.swap(cur_cell);
+		}
+
+		//Cells nearest first, entering each at the nearest of its four corners.
+		vector<point> path;
+		vector<char> done(cells.size(),0);
+		double pu = start.x*c+start.y*s, pv = -start.x*s+start.y*c;
+		size_t pieces = 0;
+		for(size_t left=cells.size(); left>0; --left) {
+			size_t best = 0;
+			bool from_top = false, from_right = false;
+			double nearest = numeric_limits<double>::max();
+			for(size_t i=0; i<cells.size(); ++i) {
+				if(done[i])
+					continue;
+				const cell &e = cells[i];
+				for(int top=0; top<2; ++top) {
+					const pair<double,double> &piece = top?e.pieces.back():e.pieces.front();
+					double tv = v0+(e.first_track+(top?e.pieces.size()-1:0))*spacing;
+					for(int right=0; right<2; ++right) {
+						double tu = right?piece.second:piece.first;
+						double d = (tu-pu)*(tu-pu)+(tv-pv)*(tv-pv);
+						if(d<nearest) {
+							nearest = d;
+							best = i;
+							from_top = top;
+							from_right = right;
+						}
+					}
+				}
+			}
+			done[best] = 1;
+			const cell &e = cells[best];
+			size_t m = e.pieces.size();
+			pieces += m;
+			for(size_t t=0; t<m; ++t) {
+				size_t k = from_top?m-1-t:t;
+				double tv = v0+(e.first_track+k)*spacing;
+				bool rightwards = (t%2==0)!=from_right;
+				double a = rightwards?e.pieces[k].first:e.pieces[k].second;
+				double b = rightwards?e.pieces[k].second:e.pieces[k].first;
+				path.push_back(point{a*c-tv*s,a*s+tv*c});
+				path.push_back(point{b*c-tv*s,b*s+tv*c});
+				pu = b;
+				pv = tv;
+			}
+		}
+		if(rep) {
+			rep->angle = angle;
+			rep->tracks = pieces;
+			rep->cells = cells.size();
+			rep->area = area(r);
+			rep->length = 0;
+			for(size_t i=1; i<path.size(); ++i)
+				rep->length += hypot(path[i].x-path[i-1].x,path[i].y-path[i-1].y);
+		}
+		return move(path);
+	}
+
+	/**
+	 * @brief lawnmower_coordinates Coverage path of a polygon in the direction with the fewest tracks
+	 * @param polygon Polygon
+	 * @param spacing Track spacing (m)
+	 * @param alt Altitude of the path
+	 * @param rep Output: Summary, if not null
+	 * @param start Start coordinate (default: the first polygon vertex)
+	 * @return Coordinates of the path
+	 */
+	static const VecCoord lawnmower_coordinates(const VecCoord &polygon, double spacing, double alt,
+												report *rep=nullptr, const coordinate *start=nullptr) {
+		localframe f(polygon.front());
+		ring r = to_local(polygon,f);
+		point p = r.front();
+		if(start)
+			f.to_local(*start,p.x,p.y);
+		vector<point> path = sweep(r,spacing,best_angle(r,spacing),p,rep);
+		VecCoord result;
+		result.reserve(path.size());
+		for(const point &q:path)
+			result.push_back(f.to_coordinate(q.x,q.y,alt));
+		return move(result);
+	}
+
+	/**
+	 * @brief lawnmower Coverage autopath of a polygon
+	 * @param polygon Polygon
+	 * @param spacing Track spacing (m)
+	 * @param alt Altitude of the path
+	 * @return autopath
+	 */
+	static const autopath lawnmower(const VecCoord &polygon, double spacing, double alt) {
+		return move(autopath(lawnmower_coordinates(polygon,spacing,alt)));
+	}
+
+protected:
+	/**
+	 * @brief The cell struct Track pieces on consecutive tracks, one per track
+	 */
+	struct cell {
+		/** @brief first_track Track of the first piece */
+		size_t first_track;
+		/** @brief pieces Start and end of each piece along its track */
+		vector<pair<double,double>> pieces;
+	};
+
+	/**
+	 * @brief track_layout Places the tracks across the polygon, centred so that
+	 * no border is more than spacing/2 from a track
+	 * @param v Vertex positions across the tracks
+	 * @param spacing Track spacing
+	 * @param v0 Output: Position of the first track
+	 * @return Number of tracks
+	 */
+	static size_t track_layout(const vector<double> &v, double spacing, double &v0) {
+		double lo = *min_element(v.begin(),v.end()), hi = *max_element(v.begin(),v.end());
+		size_t n = max<size_t>(1,static_cast<size_t>(ceil((hi-lo)/spacing-1e-9))); //a width of exactly n tracks
+		v0 = lo+((hi-lo)-(n-1)*spacing)/2;
+		return n;
+	}
+
+	/**
+	 * @brief tracks_crossed Tracks crossed by an edge (half open, so a vertex
+	 * on a track is counted once)
+	 * @param va Edge start across the tracks
+	 * @param vb Edge end across the tracks
+	 * @param v0 Position of the first track
+	 * @param spacing Track spacing
+	 * @param n Number of tracks
+	 * @param k0 Output: First track crossed
+	 * @param k1 Output: One past the last track crossed
+	 * @return true if any track is crossed
+	 */
+	static bool tracks_crossed(double va, double vb, double v0, double spacing, size_t n, size_t &k0, size_t &k1) {
+		if(va==vb)
+			return false;
+		double lo = min(va,vb), hi = max(va,vb);
+		double a = ceil((lo-v0)/spacing), b = ceil((hi-v0)/spacing);
+		while(a>0 && v0+(a-1)*spacing>=lo) --a;
+		while(v0+a*spacing<lo) ++a;
+		while(b>0 && v0+(b-1)*spacing>=hi) --b;
+		while(v0+b*spacing<hi) ++b;
+		k0 = static_cast<size_t>(max(0.0,a));
+		k1 = static_cast<size_t>(max(0.0,min(static_cast<double>(n),b)));
+		return k0<k1;
+	}
+
+	/**
+	 * @brief hull Convex hull (Andrew's monotone chain)
+	 * @param r Ring
+	 * @return Hull vertices, counterclockwise
+	 */
+	static const vector<point> hull(ring r) {
+		sort(r.begin(),r.end(),[](const point &a, const point &b) { return a.x<b.x || (a.x==b.x && a.y<b.y); });
+		vector<point> h(2*r.size());
+		size_t k = 0;
+		auto cross = [](const point &o, const point &a, const point &b) {
+			return (a.x-o.x)*(b.y-o.y)-(a.y-o.y)*(b.x-o.x);
+		};
+		for(size_t i=0; i<r.size(); ++i) {
+			while(k>=2 && cross(h[k-2],h[k-1],r[i])<=0) --k;
+			h[k++] = r[i];
+		}
+		for(size_t i=r.size()-1, t=k+1; i-->0; ) {
+			while(k>=t && cross(h[k-2],h[k-1],r[i])<=0) --k;
+			h[k++] = r[i];
+		}
+		h.resize(k>1?k-1:k);
+		return move(h);
+	}
+};
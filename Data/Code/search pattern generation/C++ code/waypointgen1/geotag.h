@@ -0,0 +1,351 @@
+/**
+ * @file geotag.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "waypointgen.h"
+#include "coordstream.h"
+#include "mappedfile.h"
+#include "localframe.h"
+#include "wplfile.h"
+#include "wplwriter.h"
+
+/**
+  * Geotagging of detections and re-tasking of the mission.
+  *
+  * The human detector (../../Vision) finds a person as a rectangle in a camera
+  * frame. Here the centre pixel of that rectangle is projected onto the ground:
+  * the pose of the aircraft at the time of the frame is interpolated from a
+  * pose log, the pixel ray of a pinhole camera is rotated into north/east/down
+  * and intersected with flat ground at a known altitude.
+  * The resulting coordinate is appended to the mission as a loiter waypoint by
+  * a retasker, which keeps the waypoint file text in memory and only formats
+  * the new line, so the updated file is written a few milliseconds after the
+  * detection:
+  * Geotag::retasker r(Patterngen::spiral(start,end,30),"mission.txt");
+  * coordinate c(0,0,0);
+  * if(Geotag::project(cam,log.at(t),u,v,ground_alt,c))
+  *     r.add_target(c);
+  *
+  * The camera looks straight down when mounted with tilt 0, with the top of
+  * the image towards the nose of the aircraft. Angles are in degrees, yaw
+  * clockwise from north, roll right wing down, pitch nose up.
+  */
+
+namespace Geotag {
+/** @brief MAV_CMD_NAV_WAYPOINT Navigate to waypoint */
+const size_t MAV_CMD_NAV_WAYPOINT = 16;
+/** @brief MAV_CMD_NAV_LOITER_TIME Loiter around waypoint for p1 seconds */
+const size_t MAV_CMD_NAV_LOITER_TIME = 19;
+
+/**
+ * @brief The camera struct Pinhole camera intrinsics and mounting
+ */
+struct camera {
+	/**
+	 * @brief fx Focal length in pixels (x)
+	 * @brief fy Focal length in pixels (y)
+	 * @brief cx Principal point x (pixels)
+	 * @brief cy Principal point y (pixels)
+	 */
+	double fx, fy, cx, cy;
+	/** @brief tilt Forward tilt of the optical axis from straight down (degrees) */
+	double tilt;
+};
+
+/**
+ * @brief The pose struct Position and attitude of the aircraft at a time
+ */
+struct pose {
+	/** @brief t Time (s) */
+	double t;
+	/**
+	 * @brief lat Latitude
+	 * @brief lon Longitude
+	 * @brief alt Altitude, same reference as the ground altitude (m)
+	 */
+	double lat, lon, alt;
+	/**
+	 * @brief roll Roll, right wing down (degrees)
+	 * @brief pitch Pitch, nose up (degrees)
+	 * @brief yaw Heading, clockwise from north (degrees)
+	 */
+	double roll, pitch, yaw;
+};
+
+/**
+ * @brief offset Moves a coordinate by a local north/east offset.
+ * Moves in the localframe of c (WGS84 radii of curvature at its latitude), far more
+ * accurate than UTM grid north/east for the few hundred metres between an
+ * aircraft and the ground it sees.
+ * @param c Coordinate
+ * @param north North offset (m)
+ * @param east East offset (m)
+ * @param alt Altitude of the result
+ * @return Moved coordinate
+ */
+inline coordinate offset(const coordinate &c, double north, double east, double alt) {
+	return localframe(c).to_coordinate(east,north,alt);
+}
+
+/**
+ * @brief distance Ground distance between two nearby coordinates (inverse of offset)
+ * @param a Coordinate
+ * @param b Coordinate
+ * @return Distance (m)
+ */
+inline double distance(const coordinate &a, const coordinate &b) {
+	double east, north;
+	localframe(a).to_local(b,east,north);
+	return std::sqrt(north*north+east*east);
+}
+
+/**
+ * @brief ray_ned Direction of the ray through a pixel in north/east/down
+ * @param cam Camera
+ * @param p Pose (attitude)
+ * @param u Pixel x
+ * @param v Pixel y
+ * @param ned Output direction (not normalized)
+ */
+inline void ray_ned(const camera &cam, const pose &p, double u, double v, double ned[3]) {
+	//Camera x (right) is body y, camera y (down the image) is body -x, the optical axis is body z (down),
+	//then the camera is tilted forward about body y.
+	double xn = (u-cam.cx)/cam.fx, yn = (v-cam.cy)/cam.fy;
+	double tilt = cam.tilt*(M_PI/180);
+	double b[3] = { -yn*std::cos(tilt)+std::sin(tilt), xn, yn*std::sin(tilt)+std::cos(tilt) };
+	double r = p.roll*(M_PI/180), q = p.pitch*(M_PI/180), y = p.yaw*(M_PI/180);
+	double cr = std::cos(r), sr = std::sin(r), cq = std::cos(q), sq = std::sin(q), cy = std::cos(y), sy = std::sin(y);
+	ned[0] = cq*cy*b[0]+(sr*sq*cy-cr*sy)*b[1]+(cr*sq*cy+sr*sy)*b[2];
+	ned[1] = cq*sy*b[0]+(sr*sq*sy+cr*cy)*b[1]+(cr*sq*sy-sr*cy)*b[2];
+	ned[2] = -sq*b[0]+sr*cq*b[1]+cr*cq*b[2];
+}
+
+/**
+ * @brief project Projects a pixel onto flat ground
+ * @param cam Camera
+ * @param p Pose of the aircraft when the frame was taken
+ * @param u Pixel x (eg. centre of the detection rectangle)
+ * @param v Pixel y
+ * @param ground_alt Altitude of the ground (sea level: 0, same reference as p.alt)
+ * @param c Output: Ground coordinate, with altitude p.alt
+ * @return false if the ray does not hit the ground (above the horizon, or aircraft below ground)
+ */
+inline bool project(const camera &cam, const pose &p, double u, double v, double ground_alt, coordinate &c) {
+	double h = p.alt-ground_alt;
+	double ned[3];
+	ray_ned(cam,p,u,v,ned);
+	if(h<=0 || ned[2]<=1e-6)
+		return false;
+	double range = h/ned[2];
+	c = offset(coordinate(p.lat,p.lon,p.alt),ned[0]*range,ned[1]*range,p.alt);
+	return true;
+}
+
+/**
+ * @brief The poselog class Time-sorted aircraft poses, interpolated at any time
+ */
+class poselog {
+	/** @brief poses Poses, sorted by time */
+	vector<pose> poses;
+
+	/**
+	 * @brief parse_field Parses a number at p, skipping blanks and one ','
+	 * @param p Current position, advanced
+	 * @param end End of line
+	 * @param value Parsed value
+	 * @return true if a number was parsed
+	 */
+	static bool parse_field(const char *&p, const char *end, double &value) {
+		while(p<end && (*p==' ' || *p=='\t'))
+			++p;
+		if(p<end && *p==',')
+			++p;
+		while(p<end && (*p==' ' || *p=='\t'))
+			++p;
+		if(p<end && *p=='+')
+			++p;
+		from_chars_result r = from_chars(p,end,value);
+		if(r.ec!=errc())
+			return false;
+		p = r.ptr;
+		return true;
+	}
+
+public:
+	/**
+	 * @brief add Appends a pose (a live telemetry stream)
+	 * @param p Pose, not older than the last one
+	 */
+	void add(const pose &p) {
+		if(!poses.empty() && p.t<poses.back().t)
+			throw(runtime_error("Pose log must be sorted by time."));
+		poses.push_back(p);
+	}
+
+	/**
+	 * @brief parse Appends the poses of csv text.
+	 * Rows are "time,lat,lon,alt,roll,pitch,yaw" with LF or CRLF line endings.
+	 * Blank lines and lines not starting with a number (a header, '#' comments) are skipped.
+	 * @param text csv file contents
+	 * @param filename Name of file (error messages)
+	 * @return Number of poses
+	 */
+	size_t parse(string_view text, const string &filename="") {
+		const char *begin = text.data();
+		const char *end = begin+text.size();
+		size_t n = 0;
+		for(const char *p=begin; p<end; ) {
+			const char *eol = static_cast<const char*>(memchr(p,'\n',end-p));
+			if(!eol)
+				eol = end;
+			const char *q = p;
+			while(q<eol && (*q==' ' || *q=='\t'))
+				++q;
+			if(q<eol && (isdigit(static_cast<unsigned char>(*q)) || *q=='-' || *q=='+' || *q=='.')) {
+				double v[7];
+				for(int i=0; i<7; ++i)
+					if(!parse_field(q,eol,v[i]))
+						throw(parse_error(filename,q-begin,"time,lat,lon,alt,roll,pitch,yaw"));
+				add(pose{v[0],v[1],v[2],v[3],v[4],v[5],v[6]});
+				++n;
+			}
+			p = eol+1;
+		}
+		return n;
+	}
+
+	/**
+	 * @brief load Appends the poses of a csv file (see parse)
+	 * @param filename csv filename
+	 * @return Number of poses
+	 */
+	size_t load(const string &filename) {
+		mapped_file m(filename);
+		return parse(m.view(),filename);
+	}
+
+	/**
+	 * @brief at Pose at time t, linearly interpolated between the two nearest poses.
+	 * Yaw is interpolated the short way around. Outside the log the first/last pose is used.
+	 * @param t Time (s)
+	 * @return Pose
+	 */
+	pose at(double t) const {
+		if(poses.empty())
+			throw(runtime_error("Pose log is empty."));
+		auto it = lower_bound(poses.begin(),poses.end(),t,[](const pose &p, double t) { return p.t<t; });
+		if(it==poses.begin())
+			return poses.front();
+		if(it==poses.end())
+			return poses.back();
+		const pose &a = *(it-1), &b = *it;
+		double f = b.t>a.t?(t-a.t)/(b.t-a.t):0;
+		double dyaw = std::remainder(b.yaw-a.yaw,360.0);
+		return pose{t,a.lat+f*(b.lat-a.lat),a.lon+f*(b.lon-a.lon),a.alt+f*(b.alt-a.alt),
+					a.roll+f*(b.roll-a.roll),a.pitch+f*(b.pitch-a.pitch),std::fmod(a.yaw+f*dyaw+360.0,360.0)};
+	}
+
+	/**
+	 * @brief size
+	 * @return Number of poses
+	 */
+	size_t size() const { return poses.size(); }
+	/**
+	 * @brief operator[]
+	 * @param i Index
+	 * @return Pose i
+	 */
+	const pose &operator[](size_t i) const { return poses[i]; }
+};
+
+/**
+ * @brief The retasker class A mission that detections are appended to.
+ * The mission is saved once; adding a target formats only its line
+ * (Wplwriter::format_waypoint) and appends it to the file (Wplfile::append),
+ * so the time per update does not grow with the mission.
+ */
+class retasker {
+	/** @brief path Mission */
+	autopath path;
+	/** @brief text Waypoint file contents of path */
+	string text;
+	/** @brief file Waypoint file, or null to keep the mission in memory only */
+	unique_ptr<Wplfile> file;
+	/** @brief targets Appended targets */
+	VecCoord targets;
+
+public:
+	/** @brief loiter_time Seconds to loiter at a target (MAV_CMD_NAV_LOITER_TIME), 0 for a plain waypoint */
+	double loiter_time = 60;
+	/** @brief min_separation Targets closer than this to an earlier target are dropped (m) */
+	double min_separation = 10;
+
+	/**
+	 * @brief retasker ctor Formats (and saves) the mission
+	 * @param mission Mission, eg. a search pattern
+	 * @param filename Waypoint file (.txt), or "" for none
+	 * @param durable Flush every update to disk before returning (see Wplfile)
+	 */
+	retasker(const autopath &mission, const string &filename, bool durable=false)
+		:path(mission)
+	{
+		Wplwriter::format(path,text);
+		if(!filename.empty()) {
+			Wplwriter::write_file(filename,text);
+			file.reset(new Wplfile(filename,durable));
+		}
+	}
+
+	/**
+	 * @brief add_target Appends a loiter waypoint at a target and to the waypoint file
+	 * @param c Target coordinate (altitude: the one to loiter at)
+	 * @return false if the target was dropped (too close to an earlier one)
+	 */
+	bool add_target(const coordinate &c) {
+		for(const coordinate &t:targets)
+			if(distance(t,c)<min_separation)
+				return false;
+		targets.push_back(c);
+		if(loiter_time>0)
+			path.emplace_back(path.size(),0,0,MAV_CMD_NAV_LOITER_TIME,loiter_time,0,0,0,
+							  c.get_lat(),c.get_lon(),c.get_alt(),1);
+		else
+			path.emplace_back(path.size(),0,0,MAV_CMD_NAV_WAYPOINT,0,0,0,0,
+							  c.get_lat(),c.get_lon(),c.get_alt(),1);
+		size_t pos = text.size();
+		text.resize(pos+Wplwriter::max_line);
+		char *p = &text[pos];
+		Wplwriter::format_waypoint(p,path.back());
+		text.resize(p-&text[0]);
+		if(file)
+			file->append(path.back());
+		return true;
+	}
+
+	/**
+	 * @brief mission
+	 * @return Mission with the appended targets
+	 */
+	const autopath &mission() const { return path; }
+	/**
+	 * @brief file_text
+	 * @return Waypoint file contents of mission()
+	 */
+	const string &file_text() const { return text; }
+	/**
+	 * @brief target_count
+	 * @return Number of appended targets
+	 */
+	size_t target_count() const { return targets.size(); }
+};
+} //namespace Geotag
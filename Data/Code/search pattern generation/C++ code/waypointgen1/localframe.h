@@ -0,0 +1,72 @@
+/**
+ * @file localframe.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <cmath>
+#include "waypointgen.h"
+#include "utm.h"
+
+/**
+  * Local tangent plane in metres around an origin coordinate.
+  *
+  * x is east and y is north of the origin, scaled with the WGS84 radii of
+  * curvature at the latitude of the origin. Over the few kilometres of a
+  * search pattern the scale error is a few parts in 10000,
+  * and to_coordinate is the exact inverse of to_local, so geometry done in
+  * the plane maps back without drift:
+  * localframe f(path.front());
+  * double x, y;
+  * f.to_local(path[i],x,y);
+  * coordinate c = f.to_coordinate(x+10,y,path[i].get_alt());
+  */
+
+/**
+ * @brief The localframe struct East/north metres around an origin
+ */
+struct localframe {
+	/**
+	 * @brief lat0 Latitude of the origin
+	 * @brief lon0 Longitude of the origin
+	 */
+	double lat0, lon0;
+	/**
+	 * @brief m_per_lat Metres per degree of latitude (meridian radius)
+	 * @brief m_per_lon Metres per degree of longitude (prime vertical radius * cos(lat0))
+	 */
+	double m_per_lat, m_per_lon;
+
+	/**
+	 * @brief localframe ctor
+	 * @param origin Origin (altitude ignored)
+	 */
+	localframe(const coordinate &origin) :lat0(origin.get_lat()),lon0(origin.get_lon()) {
+		double lat = lat0*(M_PI/180);
+		double s = std::sin(lat);
+		double w = std::sqrt(1-UTM::e2*s*s);
+		m_per_lat = UTM::sa*(1-UTM::e2)/(w*w*w)*(M_PI/180);
+		m_per_lon = UTM::sa/w*std::cos(lat)*(M_PI/180);
+	}
+
+	/**
+	 * @brief to_local Projects a coordinate into the plane
+	 * @param c Coordinate
+	 * @param x Output: East (m)
+	 * @param y Output: North (m)
+	 */
+	void to_local(const coordinate &c, double &x, double &y) const {
+		x = (c.get_lon()-lon0)*m_per_lon;
+		y = (c.get_lat()-lat0)*m_per_lat;
+	}
+
+	/**
+	 * @brief to_coordinate Coordinate of a point in the plane (inverse of to_local)
+	 * @param x East (m)
+	 * @param y North (m)
+	 * @param alt Altitude
+	 * @return Coordinate
+	 */
+	coordinate to_coordinate(double x, double y, double alt) const {
+		return coordinate(lat0+y/m_per_lat,lon0+x/m_per_lon,alt);
+	}
+};
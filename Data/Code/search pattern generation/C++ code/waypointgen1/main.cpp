@@ -5,6 +5,8 @@
 #include <iostream>
 #include <vector>
 #include "waypointgen.h"
+#include "coordstream.h"
+#include "batch.h"
 
 using namespace std;
 
@@ -31,42 +33,11 @@ void kmltest() {
 }
 
 /**
- * @brief main Converts kml files to waypoint txt files, while outputting to console.
+ * @brief main Converts kml files to waypoint txt files, while outputting to console (see Batchconvert::main).
  * @param argc 1 + Number of arguments
- * @param argv kml file names
- * @return 0
+ * @param argv kml file names and optionally -j N, -s M and -c
+ * @return 0, 1 for bad arguments
  */
 int main(int argc, char** argv) {
-	int no_of_files = argc-1;
-	cout << "kml to waypoint file converter by Mikael Westermann.\n"
-		 << "Pass kml file name(s) as argument(s) "
-		 << "when running this program." << endl;
-	if(no_of_files>0) {
-		cout << "Converting " << no_of_files << " file" << (no_of_files!=1?"s:":":") << endl;
-		for(int i=1; i<argc; ++i) {
-			string kmlfile(argv[i]);
-			cout << " Converting kml file \"" << kmlfile
-				 << "\" to waypoint file \""
-				 << (kmlfile.substr(0,kmlfile.find_last_of('.'))+".txt")
-				 << "\"... " << flush;
-			try {
-				Kmlmanip::kml2wp(string(argv[i]));
-				cout << "Done!";
-			} catch(const file_error &e) {
-				cout << (e.what());
-				--no_of_files;
-			}
-			cout << endl;
-		}
-		if(no_of_files==argc-1)
-			cout << "All files have been converted." << endl;
-		else
-			cout << no_of_files << " file" << (no_of_files!=1?"s have":" has")
-				 << " been converted." << endl;
-	}
-	else {
-		cout << "No file names passed as arguments. Exiting." << endl;
-	}
-	return 0;
+	return Batchconvert::main(argc,argv,"kml",Coordstream::kml_extract_coordinates,Coordstream::kml2wp);
 }
-
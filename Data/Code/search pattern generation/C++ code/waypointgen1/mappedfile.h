@@ -0,0 +1,93 @@
+/**
+ * @file mappedfile.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <string>
+#include <string_view>
+#include "waypointgen.h"
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief The mapped_file class Read-only view of a whole file.
+ * The file is memory mapped where possible (POSIX),
+ * otherwise it is read into a buffer in one go.
+ */
+class mapped_file {
+	/** @brief ptr Start of file contents */
+	const char *ptr = nullptr;
+	/** @brief len File size */
+	size_t len = 0;
+#if defined(_WIN32)
+	/** @brief buffer File contents */
+	vector<char> buffer;
+#endif
+
+public:
+	/**
+	 * @brief mapped_file ctor Opens and maps the file
+	 * @param filename Name of file to open
+	 */
+	explicit mapped_file(const string &filename) {
+#if defined(_WIN32)
+		ifstream f(filename,ios::binary);
+		if(!f.is_open())
+			throw(file_error(filename,true));
+		buffer.assign(istreambuf_iterator<char>(f),istreambuf_iterator<char>());
+		ptr = buffer.data();
+		len = buffer.size();
+#else
+		int fd = open(filename.c_str(),O_RDONLY);
+		if(fd<0)
+			throw(file_error(filename,true));
+		struct stat st;
+		if(fstat(fd,&st)!=0) {
+			close(fd);
+			throw(file_error(filename,true));
+		}
+		len = static_cast<size_t>(st.st_size);
+		if(len>0) {
+			void *p = mmap(nullptr,len,PROT_READ,MAP_PRIVATE,fd,0);
+			if(p==MAP_FAILED) {
+				close(fd);
+				throw(file_error(filename,true));
+			}
+			madvise(p,len,MADV_SEQUENTIAL);
+			ptr = static_cast<const char*>(p);
+		}
+		close(fd);
+#endif
+	}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	/** @brief ~mapped_file dtor Unmaps the file */
+	~mapped_file() {
+#if !defined(_WIN32)
+		if(len>0)
+			munmap(const_cast<char*>(ptr),len);
+#endif
+	}
+
+	/**
+	 * @brief view
+	 * @return The file contents
+	 */
+	string_view view() const { return string_view(ptr,len); }
+	/**
+	 * @brief size
+	 * @return File size in bytes
+	 */
+	size_t size() const { return len; }
+};
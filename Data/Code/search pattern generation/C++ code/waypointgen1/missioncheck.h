@@ -0,0 +1,507 @@
+/**
+ * @file missioncheck.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "waypointgen.h"
+#include "localframe.h"
+#include "coverage.h"
+#include "soapath.h"
+#include "utmbatch.h"
+
+/**
+  * Checks a mission before it is saved and flown.
+  *
+  * One pass over the latitude, longitude and altitude arrays measures every
+  * leg (haversine on the mean earth radius, plus the climb), sums the flight
+  * distance and the turns, and finds the longest leg, duplicated waypoints
+  * (a waypoint equal to the one before) and zero-length legs. Latitudes and
+  * longitudes out of range are reported too. On x86 the pass runs four legs
+  * at a time with AVX2/FMA if the CPU supports it (the Cephes sin/cos/atan of
+  * utmbatch.h); the scalar pass gives the same numbers to about 1e-12.
+  *
+  * The flight time is the flight distance at the cruise speed, plus a turn
+  * time for every change of direction: settings::turn_time seconds for a
+  * reversal, scaled by (1-cos(turn))/2, so half of it for a right angle and
+  * nothing for a straight line.
+  *
+  * With a geofence polygon, waypoints outside it and legs crossing its
+  * outline are reported as well (a second, scalar loop). A KML file written
+  * with latitude first comes out of Kmlmanip/Coordstream with latitude and
+  * longitude exchanged; this is reported as swapped when most waypoints are
+  * outside the fence but inside it with latitude and longitude exchanged, or
+  * when latitudes are out of range but the exchanged coordinates are not:
+  * Missioncheck::geofence fence(area);
+  * Missioncheck::report r = Missioncheck::check(p,Missioncheck::settings(),&fence);
+  * for(const string &problem:Missioncheck::problems(r,Missioncheck::settings()))
+  *     cout << problem << endl;
+  */
+
+/**
+ * @brief The Missioncheck class Mission validation and flight time function wrapper
+ */
+class Missioncheck {
+public:
+	/** @brief earth_radius Mean earth radius (m, IUGG) */
+	static constexpr double earth_radius = 6371008.8;
+
+	/**
+	 * @brief The settings struct Aircraft and limits
+	 */
+	struct settings {
+		/** @brief speed Cruise speed (m/s) */
+		double speed;
+		/** @brief turn_time Extra time for a reversal (s), less for smaller turns */
+		double turn_time;
+		/** @brief zero_leg Legs shorter than this are zero-length (m) */
+		double zero_leg;
+		/** @brief max_leg Longest allowed leg (m, 0: no limit) */
+		double max_leg;
+		/** @brief max_time Longest allowed flight time (s, 0: no limit) */
+		double max_time;
+
+		/**
+		 * @brief settings ctor
+		 * @param speed Cruise speed (m/s)
+		 * @param turn_time Extra time for a reversal (s)
+		 * @param zero_leg Legs shorter than this are zero-length (m)
+		 * @param max_leg Longest allowed leg (m, 0: no limit)
+		 * @param max_time Longest allowed flight time (s, 0: no limit)
+		 */
+		settings(double speed=15, double turn_time=4, double zero_leg=0.1, double max_leg=0, double max_time=0)
+			:speed(speed),turn_time(turn_time),zero_leg(zero_leg),max_leg(max_leg),max_time(max_time) { }
+	};
+
+	/**
+	 * @brief The report struct Result of a check. Leg i goes from waypoint i to waypoint i+1.
+	 */
+	struct report {
+		/** @brief waypoints Number of waypoints */
+		size_t waypoints = 0;
+		/** @brief distance Sum of the horizontal leg lengths (m) */
+		double distance = 0;
+		/** @brief flight_distance Sum of the leg lengths with climbs (m) */
+		double flight_distance = 0;
+		/**
+		 * @brief max_leg Longest horizontal leg (m)
+		 * @brief max_leg_index Its index
+		 */
+		double max_leg = 0;
+		size_t max_leg_index = 0;
+		/** @brief turns Sum of (1-cos(turn))/2 over the waypoints, i.e. reversals */
+		double turns = 0;
+		/** @brief time Estimated flight time (s) */
+		double time = 0;
+		/** @brief duplicates Legs to an identical waypoint */
+		vector<size_t> duplicates;
+		/** @brief zero_legs Other legs shorter than settings::zero_leg */
+		vector<size_t> zero_legs;
+		/** @brief invalid Waypoints with latitude or longitude out of range (or NaN) */
+		vector<size_t> invalid;
+		/** @brief outside Waypoints outside the geofence */
+		vector<size_t> outside;
+		/** @brief crossing Legs crossing the geofence outline */
+		vector<size_t> crossing;
+		/** @brief swapped Latitude and longitude look exchanged */
+		bool swapped = false;
+	};
+
+	/**
+	 * @brief The geofence struct A polygon on its local tangent plane, cut into
+	 * horizontal bands so that a test only looks at the edges of one band
+	 */
+	struct geofence {
+		/** @brief frame Local frame of the first vertex */
+		localframe frame;
+		/** @brief ring Vertices */
+		Coverage::ring ring;
+		/**
+		 * @brief x0 West edge of the bounding box
+		 * @brief x1 East edge
+		 * @brief y0 South edge
+		 * @brief y1 North edge
+		 * @brief band Height of a band (m)
+		 */
+		double x0, x1, y0, y1, band;
+		/** @brief bands Edges (from ring[e] to the next vertex) reaching into every band, south first */
+		vector<vector<size_t>> bands;
+
+		/**
+		 * @brief geofence ctor
+		 * @param polygon Polygon (at least 3 vertices, a closing copy of the first is dropped)
+		 */
+		geofence(const VecCoord &polygon) :frame(polygon.front()),ring(Coverage::to_local(polygon,frame)) {
+			x0 = x1 = ring[0].x;
+			y0 = y1 = ring[0].y;
+			for(const Coverage::point &p:ring) {
+				x0 = min(x0,p.x);
+				x1 = max(x1,p.x);
+				y0 = min(y0,p.y);
+				y1 = max(y1,p.y);
+			}
+			bands.resize(min<size_t>(ring.size(),4096));
+			band = max(1e-9,(y1-y0)/bands.size());
+			for(size_t e=0; e<ring.size(); ++e) {
+				const Coverage::point &a = ring[e], &b = ring[(e+1)%ring.size()];
+				for(size_t k=row(min(a.y,b.y)); k<=row(max(a.y,b.y)); ++k)
+					bands[k].push_back(e);
+			}
+		}
+
+		/**
+		 * @brief row Band of a position
+		 * @param y North (m)
+		 * @return Band
+		 */
+		size_t row(double y) const {
+			return min(bands.size()-1,static_cast<size_t>(max(0.0,(y-y0)/band)));
+		}
+
+		/**
+		 * @brief inside Point in polygon (crossing number over one band)
+		 * @param x East (m)
+		 * @param y North (m)
+		 * @return true if inside
+		 */
+		bool inside(double x, double y) const {
+			if(!(x>=x0 && x<=x1 && y>=y0 && y<=y1))
+				return false;
+			bool in = false;
+			for(size_t e:bands[row(y)]) {
+				const Coverage::point &a = ring[e], &b = ring[(e+1)%ring.size()];
+				if((b.y>y)!=(a.y>y) && x<a.x+(y-a.y)*(b.x-a.x)/(b.y-a.y))
+					in = !in;
+			}
+			return in;
+		}
+
+		/**
+		 * @brief contains Is a coordinate inside the fence?
+		 * @param c Coordinate
+		 * @return true if inside
+		 */
+		bool contains(const coordinate &c) const {
+			double x, y;
+			frame.to_local(c,x,y);
+			return inside(x,y);
+		}
+
+		/**
+		 * @brief crosses Does a segment cross the outline? (touching does not count)
+		 * @param ax Start east (m)
+		 * @param ay Start north (m)
+		 * @param bx End east (m)
+		 * @param by End north (m)
+		 * @return true if it crosses an edge
+		 */
+		bool crosses(double ax, double ay, double bx, double by) const {
+			double lo = min(ay,by), hi = max(ay,by), left = min(ax,bx), right = max(ax,bx);
+			if(hi<y0 || lo>y1 || right<x0 || left>x1)
+				return false;
+			size_t first = row(lo), last = row(hi);
+			for(size_t k=first; k<=last; ++k)
+				for(size_t e:bands[k]) {
+					const Coverage::point &c = ring[e], &d = ring[(e+1)%ring.size()];
+					if(max(first,row(min(c.y,d.y)))!=k) //tested in an earlier band
+						continue;
+					if(max(c.x,d.x)<left || min(c.x,d.x)>right)
+						continue;
+					double o1 = (bx-ax)*(c.y-ay)-(by-ay)*(c.x-ax), o2 = (bx-ax)*(d.y-ay)-(by-ay)*(d.x-ax);
+					double o3 = (d.x-c.x)*(ay-c.y)-(d.y-c.y)*(ax-c.x), o4 = (d.x-c.x)*(by-c.y)-(d.y-c.y)*(bx-c.x);
+					if(((o1<0 && o2>0) || (o1>0 && o2<0)) && ((o3<0 && o4>0) || (o3>0 && o4<0)))
+						return true;
+				}
+			return false;
+		}
+	};
+
+	/**
+	 * @brief haversine Great circle distance on the mean earth radius
+	 * @param lat1 Latitude of the start (degrees)
+	 * @param lon1 Longitude of the start
+	 * @param lat2 Latitude of the end
+	 * @param lon2 Longitude of the end
+	 * @return Distance (m)
+	 */
+	static double haversine(double lat1, double lon1, double lat2, double lon2) {
+		const double rad = M_PI/180;
+		double sp = sin((lat2-lat1)*rad/2), sl = sin((lon2-lon1)*rad/2);
+		double a = min(1.0,max(0.0,sp*sp+cos(lat1*rad)*cos(lat2*rad)*sl*sl));
+		return 2*earth_radius*atan(sqrt(a)/sqrt(1-a));
+	}
+
+	/**
+	 * @brief check Checks a mission given as arrays
+	 * @param lat Latitudes (degrees)
+	 * @param lon Longitudes (degrees)
+	 * @param alt Altitudes (m)
+	 * @param n Number of waypoints
+	 * @param s Settings
+	 * @param fence Geofence, if not null
+	 * @param simd Use the AVX2 kernel if the CPU supports it
+	 * @return Report
+	 */
+	static const report check(const double *lat, const double *lon, const double *alt, size_t n,
+							  const settings &s=settings(), const geofence *fence=nullptr, bool simd=true) {
+		report r;
+		r.waypoints = n;
+		size_t i = 0;
+#if UTM_HAVE_AVX2
+		if(simd && UTM::have_avx2())
+			i = legs_avx2(lat,lon,alt,n,s,r);
+#endif
+		//The rest: legs i..n-2, turns at i+1..n-2, waypoints i..n-1.
+		for(; i<n; ++i) {
+			if(!(fabs(lat[i])<=90) || !(fabs(lon[i])<=180))
+				r.invalid.push_back(i);
+			if(i+1<n)
+				leg(lat,lon,alt,i,s,r);
+			if(i+2<n)
+				r.turns += turn(lat[i],lon[i],lat[i+1],lon[i+1],lat[i+2],lon[i+2],cos(lat[i+1]*(M_PI/180)));
+		}
+		r.time = s.speed>0?r.flight_distance/s.speed+s.turn_time*r.turns:0;
+		if(fence)
+			check_fence(lat,lon,n,*fence,r);
+		else if(!r.invalid.empty()) {
+			r.swapped = true;
+			for(size_t k=0; k<n && r.swapped; ++k)
+				r.swapped = fabs(lon[k])<=90 && fabs(lat[k])<=180;
+		}
+		(void)simd;
+		return move(r);
+	}
+
+	/**
+	 * @brief check Checks a structure of arrays mission
+	 * @param p Mission
+	 * @param s Settings
+	 * @param fence Geofence, if not null
+	 * @return Report
+	 */
+	static const report check(const MAVLink::soa_autopath &p, const settings &s=settings(),
+							  const geofence *fence=nullptr) {
+		return check(p.lat.data(),p.lon.data(),p.alt.data(),p.size(),s,fence);
+	}
+
+	/**
+	 * @brief check Checks a mission (the coordinates are gathered into arrays first)
+	 * @param p Mission
+	 * @param s Settings
+	 * @param fence Geofence, if not null
+	 * @return Report
+	 */
+	static const report check(const VecWP &p, const settings &s=settings(), const geofence *fence=nullptr) {
+		vector<double> lat(p.size()), lon(p.size()), alt(p.size());
+		for(size_t i=0; i<p.size(); ++i) {
+			const coordinate &c = p[i].my_cmd.coord;
+			lat[i] = c.get_lat();
+			lon[i] = c.get_lon();
+			alt[i] = c.get_alt();
+		}
+		return check(lat.data(),lon.data(),alt.data(),p.size(),s,fence);
+	}
+
+	/**
+	 * @brief problems Describes what is wrong with a mission
+	 * @param r Report
+	 * @param s Settings used for the report
+	 * @return One line per problem (empty if the mission is fine)
+	 */
+	static const vector<string> problems(const report &r, const settings &s) {
+		vector<string> result;
+		auto list = [&](const vector<size_t> &v, const string &what, const string &first) {
+			if(!v.empty())
+				result.push_back(to_string(v.size())+" "+what+" (first: "+first+" "+to_string(v.front())+")");
+		};
+		if(r.swapped)
+			result.push_back("latitude and longitude look swapped");
+		list(r.invalid,"waypoints with latitude or longitude out of range","waypoint");
+		list(r.duplicates,"duplicated waypoints","leg");
+		list(r.zero_legs,"zero-length legs","leg");
+		list(r.outside,"waypoints outside the geofence","waypoint");
+		list(r.crossing,"legs crossing the geofence","leg");
+		if(s.max_leg>0 && r.max_leg>s.max_leg)
+			result.push_back("leg "+to_string(r.max_leg_index)+" is "+to_string(lround(r.max_leg))+" m (limit "
+							 +to_string(lround(s.max_leg))+" m)");
+		if(s.max_time>0 && r.time>s.max_time)
+			result.push_back("flight time "+to_string(lround(r.time))+" s (limit "+to_string(lround(s.max_time))+" s)");
+		return move(result);
+	}
+
+	/**
+	 * @brief parse_check Takes "-c" out of a list of arguments
+	 * @param args Arguments (e.g. the file names from Batchconvert::parse_args)
+	 * @return true if given
+	 */
+	static bool parse_check(vector<string> &args) {
+		size_t n = args.size();
+		args.erase(remove(args.begin(),args.end(),string("-c")),args.end());
+		return args.size()!=n;
+	}
+
+protected:
+	/**
+	 * @brief leg Measures leg i (scalar)
+	 * @param lat Latitudes
+	 * @param lon Longitudes
+	 * @param alt Altitudes
+	 * @param i Leg
+	 * @param s Settings
+	 * @param r Report to add to
+	 */
+	static void leg(const double *lat, const double *lon, const double *alt, size_t i, const settings &s, report &r) {
+		double h = haversine(lat[i],lon[i],lat[i+1],lon[i+1]), dz = alt[i+1]-alt[i];
+		double l = sqrt(h*h+dz*dz);
+		r.distance += h;
+		r.flight_distance += l;
+		if(h>r.max_leg) {
+			r.max_leg = h;
+			r.max_leg_index = i;
+		}
+		if(lat[i]==lat[i+1] && lon[i]==lon[i+1] && alt[i]==alt[i+1])
+			r.duplicates.push_back(i);
+		else if(l<s.zero_leg)
+			r.zero_legs.push_back(i);
+	}
+
+	/**
+	 * @brief turn (1-cos(turn))/2 at the middle of three waypoints, on the equirectangular plane
+	 * @param lat0 Latitude before
+	 * @param lon0 Longitude before
+	 * @param lat1 Latitude of the turn
+	 * @param lon1 Longitude of the turn
+	 * @param lat2 Latitude after
+	 * @param lon2 Longitude after
+	 * @param c Cosine of lat1
+	 * @return 0 (straight on or a zero-length leg) to 1 (reversal)
+	 */
+	static double turn(double lat0, double lon0, double lat1, double lon1, double lat2, double lon2, double c) {
+		double ax = (lon1-lon0)*c, ay = lat1-lat0, bx = (lon2-lon1)*c, by = lat2-lat1;
+		double n2 = (ax*ax+ay*ay)*(bx*bx+by*by);
+		return n2>0?(1-max(-1.0,min(1.0,(ax*bx+ay*by)/sqrt(n2))))/2:0;
+	}
+
+	/**
+	 * @brief check_fence Adds waypoints outside the fence, legs crossing it and the swap test to a report
+	 * @param lat Latitudes
+	 * @param lon Longitudes
+	 * @param n Number of waypoints
+	 * @param fence Geofence
+	 * @param r Report
+	 */
+	static void check_fence(const double *lat, const double *lon, size_t n, const geofence &fence, report &r) {
+		const localframe &f = fence.frame;
+		double px = 0, py = 0;
+		for(size_t i=0; i<n; ++i) {
+			double x = (lon[i]-f.lon0)*f.m_per_lon, y = (lat[i]-f.lat0)*f.m_per_lat;
+			if(!fence.inside(x,y))
+				r.outside.push_back(i);
+			if(i>0 && fence.crosses(px,py,x,y))
+				r.crossing.push_back(i-1);
+			px = x;
+			py = y;
+		}
+		if(2*r.outside.size()>n) {
+			size_t in = 0;
+			for(size_t i=0; i<n; ++i)
+				in += fence.inside((lat[i]-f.lon0)*f.m_per_lon,(lon[i]-f.lat0)*f.m_per_lat);
+			r.swapped = 2*in>n;
+		}
+	}
+
+#if UTM_HAVE_AVX2
+	/**
+	 * @brief legs_avx2 The pass over legs 0.. four at a time, as long as the
+	 * turn after the fourth leg is known
+	 * @param lat Latitudes
+	 * @param lon Longitudes
+	 * @param alt Altitudes
+	 * @param n Number of waypoints
+	 * @param s Settings
+	 * @param r Report to add to
+	 * @return First waypoint not done (its leg, the turn after it and itself)
+	 */
+	UTM_AVX2 static size_t legs_avx2(const double *lat, const double *lon, const double *alt, size_t n,
+									 const settings &s, report &r) {
+		using namespace UTM::avx2;
+		const v4 rad = set(M_PI/180), half = set(M_PI/360), zero = _mm256_setzero_pd(), one = set(1.0);
+		const v4 absmask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+		v4 distance = zero, flight = zero, turns = zero, longest = set(-1.0), longest_index = zero;
+		v4 index = _mm256_set_pd(3,2,1,0);
+		v4 previous = set(cos(n>0?lat[0]*(M_PI/180):0)); //lane 3: cos of the first latitude
+		size_t i = 0;
+		for(; i+6<=n; i+=4) {
+			v4 la = _mm256_loadu_pd(lat+i), lb = _mm256_loadu_pd(lat+i+1), lc = _mm256_loadu_pd(lat+i+2);
+			v4 oa = _mm256_loadu_pd(lon+i), ob = _mm256_loadu_pd(lon+i+1), oc = _mm256_loadu_pd(lon+i+2);
+			v4 za = _mm256_loadu_pd(alt+i), zb = _mm256_loadu_pd(alt+i+1);
+			v4 dlat = _mm256_sub_pd(lb,la), dlon = _mm256_sub_pd(ob,oa), dz = _mm256_sub_pd(zb,za);
+			//Haversine: a = sin^2(dlat/2)+cos(lat1)cos(lat2)sin^2(dlon/2), d = 2R atan(sqrt(a)/sqrt(1-a))
+			v4 sp, sl, ca, cb, unused;
+			sincos(_mm256_mul_pd(dlat,half),sp,unused);
+			sincos(_mm256_mul_pd(dlon,half),sl,unused);
+			sincos(_mm256_mul_pd(lb,rad),unused,cb);
+			//cos(lat1) of these legs is cos(lat2) of the legs one back
+			ca = _mm256_blend_pd(_mm256_permute4x64_pd(cb,_MM_SHUFFLE(2,1,0,3)),
+								 _mm256_permute4x64_pd(previous,_MM_SHUFFLE(2,1,0,3)),1);
+			previous = cb;
+			v4 a = _mm256_fmadd_pd(_mm256_mul_pd(ca,cb),_mm256_mul_pd(sl,sl),_mm256_mul_pd(sp,sp));
+			a = _mm256_min_pd(one,_mm256_max_pd(zero,a));
+			v4 h = _mm256_mul_pd(set(2*earth_radius),
+								 atan(_mm256_div_pd(_mm256_sqrt_pd(a),_mm256_sqrt_pd(_mm256_sub_pd(one,a)))));
+			v4 l = _mm256_sqrt_pd(_mm256_fmadd_pd(dz,dz,_mm256_mul_pd(h,h)));
+			distance = _mm256_add_pd(distance,h);
+			flight = _mm256_add_pd(flight,l);
+			v4 longer = _mm256_cmp_pd(h,longest,_CMP_GT_OQ);
+			longest = _mm256_blendv_pd(longest,h,longer);
+			longest_index = _mm256_blendv_pd(longest_index,index,longer);
+			index = _mm256_add_pd(index,set(4));
+
+			//Turn at the end of each leg, on the equirectangular plane of that waypoint.
+			v4 ax = _mm256_mul_pd(dlon,cb), ay = dlat;
+			v4 bx = _mm256_mul_pd(_mm256_sub_pd(oc,ob),cb), by = _mm256_sub_pd(lc,lb);
+			v4 n2 = _mm256_mul_pd(_mm256_fmadd_pd(ax,ax,_mm256_mul_pd(ay,ay)),_mm256_fmadd_pd(bx,bx,_mm256_mul_pd(by,by)));
+			v4 moving = _mm256_cmp_pd(n2,zero,_CMP_GT_OQ);
+			v4 c = _mm256_div_pd(_mm256_fmadd_pd(ax,bx,_mm256_mul_pd(ay,by)),_mm256_sqrt_pd(n2));
+			c = _mm256_min_pd(one,_mm256_max_pd(set(-1.0),c));
+			turns = _mm256_add_pd(turns,_mm256_and_pd(moving,_mm256_mul_pd(_mm256_sub_pd(one,c),set(0.5))));
+
+			//Rare cases are listed in scalar code.
+			v4 same = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(la,lb,_CMP_EQ_OQ),_mm256_cmp_pd(oa,ob,_CMP_EQ_OQ)),
+									_mm256_cmp_pd(za,zb,_CMP_EQ_OQ));
+			v4 tiny = _mm256_andnot_pd(same,_mm256_cmp_pd(l,set(s.zero_leg),_CMP_LT_OQ));
+			v4 bad = _mm256_or_pd(_mm256_cmp_pd(_mm256_and_pd(la,absmask),set(90),_CMP_NLE_UQ),
+								  _mm256_cmp_pd(_mm256_and_pd(oa,absmask),set(180),_CMP_NLE_UQ));
+			int m_same = _mm256_movemask_pd(same), m_tiny = _mm256_movemask_pd(tiny), m_bad = _mm256_movemask_pd(bad);
+			if(m_same|m_tiny|m_bad)
+				for(int k=0; k<4; ++k) {
+					if(m_bad&(1<<k))
+						r.invalid.push_back(i+k);
+					if(m_same&(1<<k))
+						r.duplicates.push_back(i+k);
+					if(m_tiny&(1<<k))
+						r.zero_legs.push_back(i+k);
+				}
+		}
+		double d[4], f[4], t[4], m[4], mi[4];
+		_mm256_storeu_pd(d,distance);
+		_mm256_storeu_pd(f,flight);
+		_mm256_storeu_pd(t,turns);
+		_mm256_storeu_pd(m,longest);
+		_mm256_storeu_pd(mi,longest_index);
+		for(int k=0; k<4; ++k) {
+			r.distance += d[k];
+			r.flight_distance += f[k];
+			r.turns += t[k];
+			if(m[k]>r.max_leg || (m[k]==r.max_leg && mi[k]<r.max_leg_index)) {
+				r.max_leg = m[k];
+				r.max_leg_index = static_cast<size_t>(mi[k]);
+			}
+		}
+		return i;
+	}
+#endif
+};
@@ -0,0 +1,477 @@
+/**
+ * @file missionindex.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "waypointgen.h"
+#include "localframe.h"
+#include "coverage.h"
+#include "missioncheck.h"
+
+/**
+  * Spatial index over the waypoints and legs of a mission.
+  *
+  * Questions like "which waypoints are within 50 m of this detection" or
+  * "which legs cross the no-fly zone" take a linear scan over the mission.
+  * Here the waypoints and the legs (leg i from waypoint i to waypoint i+1)
+  * are kept in two packed R-trees on the local tangent plane of the first
+  * waypoint (localframe), so a query only looks at the few boxes near it.
+  *
+  * The trees are bulk loaded with Sort-Tile-Recursive packing in O(n log n):
+  * the boxes are ordered by x into about sqrt(n/node_size) vertical slices,
+  * each slice ordered by y into leaves of node_size boxes (by halving with
+  * nth_element; the order inside a slice or leaf does not matter), and the
+  * levels above are packed in the same order. Nodes are stored level by
+  * level in flat arrays, without pointers. A leg longer than piece_factor
+  * times the mean leg is indexed in pieces, so that a long transit does not
+  * stretch every node it is packed in over the whole mission.
+  *
+  * Distances are metres on the plane, like Coverage and Partition:
+  * Missionindex index(path);
+  * vector<size_t> near = index.within(detection,50);
+  * vector<size_t> legs = index.legs_in(no_fly_zone);
+  */
+
+/**
+ * @brief The Missionindex class Packed R-trees over the waypoints and legs of a mission
+ */
+class Missionindex {
+public:
+	/** @brief node_size Children per node */
+	static constexpr size_t node_size = 16;
+	/** @brief piece_factor Legs are indexed in pieces of at most this times the mean leg length */
+	static constexpr double piece_factor = 8;
+
+	/** @brief point A point on the local tangent plane */
+	typedef Coverage::point point;
+
+	/**
+	 * @brief The box struct An axis aligned rectangle on the plane
+	 */
+	struct box {
+		/**
+		 * @brief x0 West
+		 * @brief y0 South
+		 * @brief x1 East
+		 * @brief y1 North
+		 */
+		double x0, y0, x1, y1;
+
+		/**
+		 * @brief distance2 Squared distance from a point to the box (0 inside)
+		 * @param x East (m)
+		 * @param y North (m)
+		 * @return Squared distance (m^2)
+		 */
+		double distance2(double x, double y) const {
+			double dx = max(0.0,max(x0-x,x-x1)), dy = max(0.0,max(y0-y,y-y1));
+			return dx*dx+dy*dy;
+		}
+
+		/**
+		 * @brief overlaps Do two boxes overlap (touching counts)?
+		 * @param b Box
+		 * @return true if they overlap
+		 */
+		bool overlaps(const box &b) const {
+			return x0<=b.x1 && b.x0<=x1 && y0<=b.y1 && b.y0<=y1;
+		}
+	};
+
+	/** @brief frame Local frame of the first waypoint */
+	localframe frame;
+	/** @brief points Waypoints on the plane */
+	vector<point> points;
+
+	/**
+	 * @brief Missionindex ctor Builds the trees
+	 * @param coords Waypoint coordinates (at least one)
+	 */
+	Missionindex(const VecCoord &coords) :frame(coords.front()),points(coords.size()) {
+		for(size_t i=0; i<coords.size(); ++i)
+			frame.to_local(coords[i],points[i].x,points[i].y);
+		build();
+	}
+
+	/**
+	 * @brief Missionindex ctor Builds the trees
+	 * @param wps Waypoints (at least one), e.g. an autopath
+	 */
+	Missionindex(const VecWP &wps) :frame(wps.front().my_cmd.coord),points(wps.size()) {
+		for(size_t i=0; i<wps.size(); ++i)
+			frame.to_local(wps[i].my_cmd.coord,points[i].x,points[i].y);
+		build();
+	}
+
+	/**
+	 * @brief size
+	 * @return Number of waypoints
+	 */
+	size_t size() const { return points.size(); }
+
+	/**
+	 * @brief nearest Waypoint nearest to a coordinate
+	 * @param c Coordinate
+	 * @param distance Output: Its distance (m), if not null
+	 * @return Waypoint index (the lowest of equally near ones)
+	 */
+	size_t nearest(const coordinate &c, double *distance=nullptr) const {
+		point p = local(c);
+		return waypoint_tree.nearest(p.x,p.y,[&](size_t i) {
+			return (points[i].x-p.x)*(points[i].x-p.x)+(points[i].y-p.y)*(points[i].y-p.y);
+		},distance);
+	}
+
+	/**
+	 * @brief nearest_leg Leg nearest to a coordinate
+	 * @param c Coordinate
+	 * @param distance Output: Its distance (m), if not null
+	 * @return Leg index (the lowest of equally near ones), size() if there are no legs
+	 */
+	size_t nearest_leg(const coordinate &c, double *distance=nullptr) const {
+		if(points.size()<2) {
+			if(distance)
+				*distance = numeric_limits<double>::infinity();
+			return size();
+		}
+		point p = local(c);
+		size_t k = leg_tree.nearest(p.x,p.y,[&](size_t j) {
+			return segment_distance2(p,points[leg_of[j]],points[leg_of[j]+1]);
+		},distance);
+		return leg_of[k];
+	}
+
+	/**
+	 * @brief within Waypoints within a distance of a coordinate
+	 * @param c Coordinate
+	 * @param radius Distance (m)
+	 * @return Waypoint indices, ascending
+	 */
+	const vector<size_t> within(const coordinate &c, double radius) const {
+		point p = local(c);
+		vector<size_t> result;
+		waypoint_tree.search(box{p.x-radius,p.y-radius,p.x+radius,p.y+radius},[&](size_t i) {
+			if(hypot(points[i].x-p.x,points[i].y-p.y)<=radius)
+				result.push_back(i);
+		});
+		sort(result.begin(),result.end());
+		return move(result);
+	}
+
+	/**
+	 * @brief legs_within Legs passing within a distance of a coordinate
+	 * @param c Coordinate
+	 * @param radius Distance (m)
+	 * @return Leg indices, ascending
+	 */
+	const vector<size_t> legs_within(const coordinate &c, double radius) const {
+		point p = local(c);
+		vector<size_t> result;
+		leg_tree.search(box{p.x-radius,p.y-radius,p.x+radius,p.y+radius},[&](size_t j) {
+			size_t i = leg_of[j];
+			if(segment_distance2(p,points[i],points[i+1])<=radius*radius)
+				result.push_back(i);
+		});
+		unique_sort(result);
+		return move(result);
+	}
+
+	/**
+	 * @brief crossing Legs intersecting a segment (touching counts)
+	 * @param a Segment start
+	 * @param b Segment end
+	 * @return Leg indices, ascending
+	 */
+	const vector<size_t> crossing(const coordinate &a, const coordinate &b) const {
+		point p = local(a), q = local(b);
+		vector<size_t> result;
+		leg_tree.search(box{min(p.x,q.x),min(p.y,q.y),max(p.x,q.x),max(p.y,q.y)},[&](size_t j) {
+			size_t i = leg_of[j];
+			if(intersects(p,q,points[i],points[i+1]))
+				result.push_back(i);
+		});
+		unique_sort(result);
+		return move(result);
+	}
+
+	/**
+	 * @brief legs_in Legs entering a polygon, e.g. a no-fly zone: a waypoint
+	 * inside, or crossing the outline (Missioncheck::geofence tests)
+	 * @param polygon Polygon (at least 3 vertices)
+	 * @return Leg indices, ascending
+	 */
+	const vector<size_t> legs_in(const VecCoord &polygon) const {
+		const Missioncheck::geofence zone(polygon);
+		box b{numeric_limits<double>::max(),numeric_limits<double>::max(),-numeric_limits<double>::max(),
+			  -numeric_limits<double>::max()};
+		for(const coordinate &c:polygon) {
+			point p = local(c);
+			b = box{min(b.x0,p.x),min(b.y0,p.y),max(b.x1,p.x),max(b.y1,p.y)};
+		}
+		//From this plane to the plane of the zone (the same coordinates)
+		auto to_zone = [&](const point &p) {
+			point q;
+			zone.frame.to_local(frame.to_coordinate(p.x,p.y,0),q.x,q.y);
+			return q;
+		};
+		vector<size_t> result;
+		leg_tree.search(b,[&](size_t j) {
+			size_t i = leg_of[j];
+			if(!result.empty() && result.back()==i) //the next piece of the same leg
+				return;
+			point p = to_zone(points[i]), q = to_zone(points[i+1]);
+			if(zone.inside(p.x,p.y) || zone.inside(q.x,q.y) || zone.crosses(p.x,p.y,q.x,q.y))
+				result.push_back(i);
+		});
+		unique_sort(result);
+		return move(result);
+	}
+
+	/**
+	 * @brief intersects Do two segments intersect (touching counts)?
+	 * @param a First segment start
+	 * @param b First segment end
+	 * @param c Second segment start
+	 * @param d Second segment end
+	 * @return true if they intersect
+	 */
+	static bool intersects(const point &a, const point &b, const point &c, const point &d) {
+		auto orient = [](const point &p, const point &q, const point &r) {
+			double o = (q.x-p.x)*(r.y-p.y)-(q.y-p.y)*(r.x-p.x);
+			return (o>0)-(o<0);
+		};
+		auto on = [](const point &p, const point &q, const point &r) { //r on the box of p-q
+			return min(p.x,q.x)<=r.x && r.x<=max(p.x,q.x) && min(p.y,q.y)<=r.y && r.y<=max(p.y,q.y);
+		};
+		int o1 = orient(a,b,c), o2 = orient(a,b,d), o3 = orient(c,d,a), o4 = orient(c,d,b);
+		if(o1!=o2 && o3!=o4)
+			return true;
+		return (o1==0 && on(a,b,c)) || (o2==0 && on(a,b,d)) || (o3==0 && on(c,d,a)) || (o4==0 && on(c,d,b));
+	}
+
+	/**
+	 * @brief segment_distance2 Squared distance from a point to a segment
+	 * @param p Point
+	 * @param a Segment start
+	 * @param b Segment end
+	 * @return Squared distance (m^2)
+	 */
+	static double segment_distance2(const point &p, const point &a, const point &b) {
+		double dx = b.x-a.x, dy = b.y-a.y, len2 = dx*dx+dy*dy;
+		double t = len2>0?max(0.0,min(1.0,((p.x-a.x)*dx+(p.y-a.y)*dy)/len2)):0;
+		double ex = a.x+t*dx-p.x, ey = a.y+t*dy-p.y;
+		return ex*ex+ey*ey;
+	}
+
+protected:
+	/**
+	 * @brief The tree struct A packed R-tree over numbered boxes
+	 */
+	struct tree {
+		/** @brief boxes Items in packing order, then the nodes of every level up to the root */
+		vector<box> boxes;
+		/** @brief ids Item number of the first boxes */
+		vector<size_t> ids;
+		/** @brief levels Index of the first box of every level (leaves: 0), and boxes.size() */
+		vector<size_t> levels;
+
+		/**
+		 * @brief tree ctor Sort-Tile-Recursive bulk load
+		 * @param items Item boxes
+		 */
+		tree(const vector<box> &items=vector<box>()) {
+			size_t n = items.size();
+			//Sorted on copies of the centres, not through the item numbers.
+			struct centre { double x, y; size_t id; };
+			vector<centre> c(n);
+			for(size_t i=0; i<n; ++i)
+				c[i] = centre{items[i].x0+items[i].x1,items[i].y0+items[i].y1,i};
+			size_t leaves = (n+node_size-1)/node_size;
+			size_t slice = node_size*static_cast<size_t>(ceil(sqrt(static_cast<double>(leaves))));
+			groups(c.begin(),c.end(),slice,[](const centre &a, const centre &b) { return a.x<b.x; });
+			for(size_t s=0; s<n; s+=slice)
+				groups(c.begin()+s,c.begin()+min(n,s+slice),node_size,[](const centre &a, const centre &b) { return a.y<b.y; });
+			ids.resize(n);
+			boxes.reserve(n+n/(node_size-1)+2);
+			for(size_t i=0; i<n; ++i) {
+				ids[i] = c[i].id;
+				boxes.push_back(items[ids[i]]);
+			}
+			levels.push_back(0);
+			for(size_t first=0, last=n; last-first>1; first=last, last=boxes.size()) {
+				for(size_t k=first; k<last; k+=node_size) {
+					box b = boxes[k];
+					for(size_t j=k+1; j<min(last,k+node_size); ++j)
+						b = box{min(b.x0,boxes[j].x0),min(b.y0,boxes[j].y0),max(b.x1,boxes[j].x1),max(b.y1,boxes[j].y1)};
+					boxes.push_back(b);
+				}
+				levels.push_back(last);
+			}
+			levels.push_back(boxes.size());
+		}
+
+		/**
+		 * @brief groups Orders a range into consecutive groups, every element of a
+		 * group before every element of the next (like sort, but the groups are not
+		 * sorted inside: nth_element halves, O(n log(n/size)))
+		 * @param first Start of the range
+		 * @param last End of the range
+		 * @param size Group size
+		 * @param less Order
+		 */
+		template<class I, class L>
+		static void groups(I first, I last, size_t size, L less) {
+			size_t n = last-first;
+			if(n<=size)
+				return;
+			I mid = first+(n/size+1)/2*size;
+			nth_element(first,mid,last,less);
+			groups(first,mid,size,less);
+			groups(mid,last,size,less);
+		}
+
+		/**
+		 * @brief children The boxes below a node
+		 * @param level Level of the node (leaves: 1)
+		 * @param k Box index of the node
+		 * @return First and one past the last child
+		 */
+		pair<size_t,size_t> children(size_t level, size_t k) const {
+			size_t first = levels[level-1]+(k-levels[level])*node_size;
+			return make_pair(first,min(levels[level],first+node_size));
+		}
+
+		/**
+		 * @brief search Calls f(item) for every item whose box overlaps a query box
+		 * @param q Query box
+		 * @param f Function of the item number
+		 */
+		template<class F>
+		void search(const box &q, F f) const {
+			if(boxes.empty())
+				return;
+			vector<pair<size_t,size_t>> stack{make_pair(levels.size()-2,boxes.size()-1)}; //level, box
+			while(!stack.empty()) {
+				size_t level = stack.back().first, k = stack.back().second;
+				stack.pop_back();
+				if(!boxes[k].overlaps(q))
+					continue;
+				if(level==0) {
+					f(ids[k]);
+					continue;
+				}
+				pair<size_t,size_t> c = children(level,k);
+				for(size_t j=c.first; j<c.second; ++j)
+					stack.emplace_back(level-1,j);
+			}
+		}
+
+		/**
+		 * @brief nearest Best first search for the nearest item
+		 * @param x East (m)
+		 * @param y North (m)
+		 * @param distance2 Squared distance to an item (about at least the distance to its box)
+		 * @param distance Output: Distance to the nearest item (m), if not null
+		 * @return Item number (the lowest of equally near ones; the tree must not be empty)
+		 */
+		template<class F>
+		size_t nearest(double x, double y, F distance2, double *distance) const {
+			//The box distance and the item distance are different expressions, so an item may come out a
+			//rounding error nearer than its box. After the first item the search goes on through every node
+			//within slack of the best distance, and keeps the lowest of the nearest items it meets.
+			const double slack = 1e-9;
+			typedef tuple<double,size_t,size_t> entry; //distance2, level, box index
+			priority_queue<entry,vector<entry>,greater<entry>> queue;
+			auto push = [&](size_t level, size_t k) {
+				queue.emplace(level==0?distance2(ids[k]):boxes[k].distance2(x,y),level,k);
+			};
+			push(levels.size()-2,boxes.size()-1);
+			double best2 = numeric_limits<double>::infinity();
+			size_t best = 0;
+			while(!queue.empty() && get<0>(queue.top())<=best2*(1+slack)+slack) {
+				entry e = queue.top();
+				queue.pop();
+				size_t level = get<1>(e);
+				if(level==0) {
+					size_t id = ids[get<2>(e)];
+					double d2 = get<0>(e);
+					if(d2<best2 || (d2==best2 && id<best)) {
+						best2 = d2;
+						best = id;
+					}
+					continue;
+				}
+				pair<size_t,size_t> c = children(level,get<2>(e));
+				for(size_t j=c.first; j<c.second; ++j)
+					push(level-1,j);
+			}
+			if(distance)
+				*distance = sqrt(best2);
+			return best;
+		}
+	};
+
+	/** @brief waypoint_tree Tree over the waypoints */
+	tree waypoint_tree;
+	/** @brief leg_tree Tree over the pieces of the legs */
+	tree leg_tree;
+	/** @brief leg_of Leg of every piece */
+	vector<size_t> leg_of;
+
+	/**
+	 * @brief unique_sort Sorts and removes repeats (a leg found through several pieces)
+	 * @param v Leg indices
+	 */
+	static void unique_sort(vector<size_t> &v) {
+		sort(v.begin(),v.end());
+		v.erase(unique(v.begin(),v.end()),v.end());
+	}
+
+	/**
+	 * @brief local A coordinate on the plane
+	 * @param c Coordinate
+	 * @return Point
+	 */
+	point local(const coordinate &c) const {
+		point p;
+		frame.to_local(c,p.x,p.y);
+		return p;
+	}
+
+	/**
+	 * @brief build Bulk loads both trees from points
+	 */
+	void build() {
+		vector<box> b(points.size());
+		for(size_t i=0; i<points.size(); ++i)
+			b[i] = box{points[i].x,points[i].y,points[i].x,points[i].y};
+		waypoint_tree = tree(b);
+		double total = 0;
+		for(size_t i=0; i+1<points.size(); ++i)
+			total += hypot(points[i+1].x-points[i].x,points[i+1].y-points[i].y);
+		double piece = points.size()>1?piece_factor*total/(points.size()-1):0;
+		b.clear();
+		leg_of.clear();
+		for(size_t i=0; i+1<points.size(); ++i) {
+			const point &p = points[i], &q = points[i+1];
+			size_t k = piece>0?max<size_t>(1,static_cast<size_t>(ceil(hypot(q.x-p.x,q.y-p.y)/piece))):1;
+			for(size_t j=0; j<k; ++j) {
+				double t0 = static_cast<double>(j)/k, t1 = static_cast<double>(j+1)/k;
+				double xa = p.x+t0*(q.x-p.x), ya = p.y+t0*(q.y-p.y);
+				double xb = j+1<k?p.x+t1*(q.x-p.x):q.x, yb = j+1<k?p.y+t1*(q.y-p.y):q.y;
+				b.push_back(box{min(xa,xb),min(ya,yb),max(xa,xb),max(ya,yb)});
+				leg_of.push_back(i);
+			}
+		}
+		leg_tree = tree(b);
+	}
+};
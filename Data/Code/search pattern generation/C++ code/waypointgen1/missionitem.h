@@ -0,0 +1,317 @@
+/**
+ * @file missionitem.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "waypointgen.h"
+#include "coordstream.h"
+
+/**
+  * Binary MAVLink v2 MISSION_ITEM_INT (message 73) encoding of waypoints.
+  *
+  * Instead of the QGC WPL text file, every waypoint is packed into one
+  * MAVLink v2 frame, ready to be sent during a mission upload:
+  * STX (0xFD), payload length, incompat flags, compat flags, packet sequence,
+  * system id, component id, message id (3 bytes), payload, CRC (2 bytes).
+  * All fields are little endian. The payload is in MAVLink wire order
+  * (largest fields first), with the trailing zero bytes removed as MAVLink v2
+  * senders do. The CRC is CRC-16/MCRF4XX ("X.25" in MAVLink) over everything
+  * but the STX, followed by the CRC_EXTRA of the message (38).
+  *
+  * Latitude and longitude are sent as degrees*1e7 (int32), the altitude and
+  * the four parameters as float, so a decoded waypoint is within 0.5e-7
+  * degrees of the encoded one. The item sequence number is the waypoint
+  * index, like the index column of the text file; it is 16 bits, so a
+  * mission has at most 65536 waypoints.
+  *
+  * vector<uint8_t> buf;
+  * Missionitem::encode(Patterngen::spiral(start,end,30),buf);
+  * VecWP back = Missionitem::decode(buf.data(),buf.size());
+  */
+
+/**
+ * @brief The Missionitem class MAVLink v2 MISSION_ITEM_INT encoding function wrapper
+ */
+class Missionitem {
+public:
+	/** @brief stx Start of a MAVLink v2 frame */
+	static constexpr uint8_t stx = 0xFD;
+	/** @brief msgid MISSION_ITEM_INT */
+	static constexpr uint32_t msgid = 73;
+	/** @brief crc_extra CRC_EXTRA of MISSION_ITEM_INT (from its field names and types) */
+	static constexpr uint8_t crc_extra = 38;
+	/** @brief payload_len Payload length, mission_type extension included */
+	static constexpr size_t payload_len = 38;
+	/** @brief header_len Frame bytes before the payload */
+	static constexpr size_t header_len = 10;
+	/** @brief max_frame Longest frame (unsigned) */
+	static constexpr size_t max_frame = header_len+payload_len+2;
+	/** @brief signature_len Bytes after the CRC of a signed frame */
+	static constexpr size_t signature_len = 13;
+
+	/**
+	 * @brief The link struct Sender and receiver of the frames
+	 */
+	struct link {
+		/**
+		 * @brief sysid System id of the sender
+		 * @brief compid Component id of the sender
+		 */
+		uint8_t sysid, compid;
+		/**
+		 * @brief target_system System id of the aircraft
+		 * @brief target_component Component id of the autopilot
+		 */
+		uint8_t target_system, target_component;
+		/** @brief mission_type MAV_MISSION_TYPE (0: mission) */
+		uint8_t mission_type;
+		/**
+		 * @brief link ctor A ground station (255, MAV_COMP_ID_MISSIONPLANNER 190)
+		 * sending a mission to system 1, component 1
+		 */
+		link() :sysid(255),compid(190),target_system(1),target_component(1),mission_type(0) { }
+	};
+
+	/**
+	 * @brief crc_accumulate Adds a byte to a CRC-16/MCRF4XX
+	 * @param b Byte
+	 * @param crc CRC so far
+	 * @return New CRC
+	 */
+	static uint16_t crc_accumulate(uint8_t b, uint16_t crc) {
+		uint8_t t = b^static_cast<uint8_t>(crc&0xFF);
+		t ^= static_cast<uint8_t>(t<<4);
+		return static_cast<uint16_t>((crc>>8)^(t<<8)^(t<<3)^(t>>4));
+	}
+
+	/**
+	 * @brief The crc_table struct crc_accumulate of every byte on a zero CRC,
+	 * so that crc_x25 does one lookup per byte
+	 */
+	struct crc_table {
+		/** @brief t Table */
+		uint16_t t[256];
+		/** @brief crc_table ctor Fills the table */
+		crc_table() {
+			for(int b=0; b<256; ++b)
+				t[b] = crc_accumulate(static_cast<uint8_t>(b),0);
+		}
+	};
+
+	/**
+	 * @brief crc_x25 CRC-16/MCRF4XX of a buffer
+	 * @param p Data
+	 * @param n Length
+	 * @param crc Initial value (a CRC so far)
+	 * @return CRC
+	 */
+	static uint16_t crc_x25(const uint8_t *p, size_t n, uint16_t crc=0xFFFF) {
+		static const crc_table table;
+		for(size_t i=0; i<n; ++i)
+			crc = static_cast<uint16_t>((crc>>8)^table.t[(crc^p[i])&0xFF]);
+		return crc;
+	}
+
+	/**
+	 * @brief encode Packs a waypoint into a frame
+	 * @param w Waypoint
+	 * @param packet_seq Packet sequence number (wraps at 256)
+	 * @param out Output with room for max_frame bytes
+	 * @param l Sender and receiver
+	 * @return Frame length
+	 */
+	static size_t encode(const waypoint &w, uint8_t packet_seq, uint8_t *out, const link &l=link()) {
+		if(w.index>0xFFFF)
+			throw(out_of_range("Waypoint index "+to_string(w.index)+" does not fit MISSION_ITEM_INT (16 bits)."));
+		const command &c = w.my_cmd;
+		uint8_t *p = out+header_len;
+		put_float(p,c.p1);
+		put_float(p+4,c.p2);
+		put_float(p+8,c.p3);
+		put_float(p+12,c.p4);
+		put_u32(p+16,static_cast<uint32_t>(static_cast<int32_t>(lround(c.coord.get_lat()*1e7))));
+		put_u32(p+20,static_cast<uint32_t>(static_cast<int32_t>(lround(c.coord.get_lon()*1e7))));
+		put_float(p+24,c.coord.get_alt());
+		put_u16(p+28,static_cast<uint16_t>(w.index));
+		put_u16(p+30,static_cast<uint16_t>(c.cmd));
+		p[32] = l.target_system;
+		p[33] = l.target_component;
+		p[34] = static_cast<uint8_t>(w.coord_frame);
+		p[35] = static_cast<uint8_t>(w.current_wp);
+		p[36] = static_cast<uint8_t>(w.autocontinue);
+		p[37] = l.mission_type;
+		size_t len = payload_len;
+		while(len>1 && p[len-1]==0) //MAVLink v2 payload truncation
+			--len;
+		out[0] = stx;
+		out[1] = static_cast<uint8_t>(len);
+		out[2] = 0; //incompat flags: not signed
+		out[3] = 0; //compat flags
+		out[4] = packet_seq;
+		out[5] = l.sysid;
+		out[6] = l.compid;
+		out[7] = static_cast<uint8_t>(msgid);
+		out[8] = static_cast<uint8_t>(msgid>>8);
+		out[9] = static_cast<uint8_t>(msgid>>16);
+		uint16_t crc = crc_accumulate(crc_extra,crc_x25(out+1,header_len-1+len));
+		put_u16(out+header_len+len,crc);
+		return header_len+len+2;
+	}
+
+	/**
+	 * @brief encode Packs waypoints into consecutive frames
+	 * @param wps Waypoints
+	 * @param buf Buffer, replaced by the frames
+	 * @param l Sender and receiver
+	 * @param packet_seq Packet sequence number of the first frame
+	 */
+	static void encode(const VecWP &wps, vector<uint8_t> &buf, const link &l=link(), uint8_t packet_seq=0) {
+		buf.resize(wps.size()*max_frame);
+		size_t pos = 0;
+		for(const waypoint &w:wps)
+			pos += encode(w,packet_seq++,buf.data()+pos,l);
+		buf.resize(pos);
+	}
+
+	/**
+	 * @brief The status enum Result of decoding one frame
+	 */
+	enum status {
+		ok,         //a MISSION_ITEM_INT was decoded
+		incomplete, //the buffer ends inside the frame
+		bad_crc,    //CRC mismatch (corrupt frame)
+		other       //another message (skipped, CRC not checked)
+	};
+
+	/**
+	 * @brief decode Unpacks the frame at p
+	 * @param p Start of a frame (0xFD)
+	 * @param n Bytes available
+	 * @param w Output: Waypoint (status ok)
+	 * @param used Output: Frame length, signature included (all but incomplete)
+	 * @param l Output: Sender, receiver and mission type (status ok), if not null
+	 * @return Status
+	 */
+	static status decode(const uint8_t *p, size_t n, waypoint &w, size_t &used, link *l=nullptr) {
+		if(n<header_len)
+			return incomplete;
+		size_t len = p[1];
+		used = header_len+len+2+((p[2]&0x01)?signature_len:0);
+		if(n<used)
+			return incomplete;
+		uint32_t id = p[7]|(p[8]<<8)|(static_cast<uint32_t>(p[9])<<16);
+		if(id!=msgid || len>payload_len)
+			return other;
+		uint16_t crc = crc_accumulate(crc_extra,crc_x25(p+1,header_len-1+len));
+		if(crc!=get_u16(p+header_len+len))
+			return bad_crc;
+		uint8_t q[payload_len] = {}; //truncated zeros
+		memcpy(q,p+header_len,len);
+		w = waypoint(get_u16(q+28),q[35],q[34],get_u16(q+30),
+					 get_float(q),get_float(q+4),get_float(q+8),get_float(q+12),
+					 static_cast<int32_t>(get_u32(q+16))/1e7,static_cast<int32_t>(get_u32(q+20))/1e7,
+					 get_float(q+24),q[36]);
+		if(l) {
+			l->sysid = p[5];
+			l->compid = p[6];
+			l->target_system = q[32];
+			l->target_component = q[33];
+			l->mission_type = q[37];
+		}
+		return ok;
+	}
+
+	/**
+	 * @brief decode Unpacks all MISSION_ITEM_INT frames of a buffer.
+	 * Bytes before a 0xFD and frames of other messages are skipped.
+	 * @param p Frames
+	 * @param n Length
+	 * @return Waypoints
+	 */
+	static const VecWP decode(const uint8_t *p, size_t n) {
+		VecWP result;
+		result.reserve(n/(max_frame-8));
+		waypoint w(0,0,0,0,0,0,0,0,0,0,0);
+		for(size_t pos=0; pos<n; ) {
+			if(p[pos]!=stx) {
+				++pos;
+				continue;
+			}
+			size_t used;
+			status s = decode(p+pos,n-pos,w,used);
+			if(s==incomplete)
+				throw(parse_error("MAVLink buffer",pos,"a complete frame"));
+			if(s==bad_crc)
+				throw(parse_error("MAVLink buffer",pos,"a frame with a valid CRC"));
+			if(s==ok)
+				result.push_back(w);
+			pos += used;
+		}
+		return move(result);
+	}
+
+protected:
+	/**
+	 * @brief put_u16 Stores a little endian uint16
+	 * @param p Output
+	 * @param v Value
+	 */
+	static void put_u16(uint8_t *p, uint16_t v) {
+		p[0] = static_cast<uint8_t>(v);
+		p[1] = static_cast<uint8_t>(v>>8);
+	}
+	/**
+	 * @brief put_u32 Stores a little endian uint32
+	 * @param p Output
+	 * @param v Value
+	 */
+	static void put_u32(uint8_t *p, uint32_t v) {
+		p[0] = static_cast<uint8_t>(v);
+		p[1] = static_cast<uint8_t>(v>>8);
+		p[2] = static_cast<uint8_t>(v>>16);
+		p[3] = static_cast<uint8_t>(v>>24);
+	}
+	/**
+	 * @brief put_float Stores a little endian IEEE 754 float
+	 * @param p Output
+	 * @param v Value (rounded to float)
+	 */
+	static void put_float(uint8_t *p, double v) {
+		float f = static_cast<float>(v);
+		uint32_t u;
+		memcpy(&u,&f,4);
+		put_u32(p,u);
+	}
+	/**
+	 * @brief get_u16 Loads a little endian uint16
+	 * @param p Input
+	 * @return Value
+	 */
+	static uint16_t get_u16(const uint8_t *p) {
+		return static_cast<uint16_t>(p[0]|(p[1]<<8));
+	}
+	/**
+	 * @brief get_u32 Loads a little endian uint32
+	 * @param p Input
+	 * @return Value
+	 */
+	static uint32_t get_u32(const uint8_t *p) {
+		return p[0]|(p[1]<<8)|(p[2]<<16)|(static_cast<uint32_t>(p[3])<<24);
+	}
+	/**
+	 * @brief get_float Loads a little endian IEEE 754 float
+	 * @param p Input
+	 * @return Value
+	 */
+	static float get_float(const uint8_t *p) {
+		uint32_t u = get_u32(p);
+		float f;
+		memcpy(&f,&u,4);
+		return f;
+	}
+};
@@ -0,0 +1,34 @@
+/**
+ * @file parallel.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "waypointgen.h"
+
+/**
+ * @brief parallel_for Calls f(0) ... f(n-1), taking the next index from a
+ * shared counter on each thread (the calling thread is one of them)
+ * @param n Number of calls
+ * @param threads Number of threads (0: one per hardware thread)
+ * @param f Function
+ */
+template<class F>
+void parallel_for(size_t n, size_t threads, F f) {
+	if(threads==0)
+		threads = max<size_t>(1,thread::hardware_concurrency());
+	atomic<size_t> next(0);
+	auto work = [&]() {
+		for(size_t k; (k=next++)<n; )
+			f(k);
+	};
+	vector<thread> pool;
+	for(size_t t=1; t<min(threads,n); ++t)
+		pool.emplace_back(work);
+	work();
+	for(thread &t:pool)
+		t.join();
+}
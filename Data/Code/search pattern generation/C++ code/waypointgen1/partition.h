@@ -0,0 +1,266 @@
+/**
+ * @file partition.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "waypointgen.h"
+#include "parallel.h"
+#include "coverage.h"
+#include "localframe.h"
+
+/**
+  * One search polygon shared by several aircraft.
+  *
+  * The polygon is cut into one strip per aircraft with lines parallel to the
+  * lawnmower tracks (Coverage::best_angle of the whole area), so every track
+  * stays whole and the strips together are covered like the whole polygon.
+  * Strips are given to the aircraft in the order of their home coordinates
+  * across the tracks, so no two transits cross.
+  *
+  * The strips are balanced by flight distance rather than by area alone: an
+  * aircraft flies about area/spacing metres of tracks plus the transit from
+  * its home to its strip and back. Starting from equal areas, every strip is
+  * planned and its area is moved towards the mean flight distance, a few
+  * rounds over.
+  *
+  * The cuts (by bisection on the clipped area), the strips and the lawnmower
+  * of each strip are computed concurrently:
+  * VecCoord homes = {coordinate(55.4753,10.3236,40),coordinate(55.4760,10.3330,40)};
+  * vector<autopath> p = Partition::plan(area,homes,20,50,0);
+  * Partition::save(p,"bay"); //bay_1.txt, bay_2.txt
+  */
+
+/**
+ * @brief The Partition class Multi-aircraft coverage planning function wrapper
+ */
+class Partition {
+public:
+	/** @brief balance_rounds Rounds of moving area towards equal flight distances */
+	static constexpr int balance_rounds = 4;
+
+	/**
+	 * @brief The report struct Summary of one aircraft's mission
+	 */
+	struct report {
+		/** @brief coverage Lawnmower of the strip */
+		Coverage::report coverage;
+		/** @brief transit Distance from home to the first track and from the last track back (m) */
+		double transit;
+	};
+
+	/**
+	 * @brief strips Cuts a ring into strips of given areas across a direction
+	 * @param r Ring
+	 * @param angle Direction of the cuts (degrees counterclockwise from east)
+	 * @param areas Area of each strip, in order across the direction (m^2, any scale)
+	 * @param threads Number of threads (0: one per hardware thread)
+	 * @return Strips, possibly with zero-width edges along the cuts
+	 */
+	static const vector<Coverage::ring> strips(const Coverage::ring &r, double angle, const vector<double> &areas,
+											   size_t threads=1) {
+		if(areas.empty())
+			throw(invalid_argument("At least one strip area is needed."));
+		double c = cos(angle*(M_PI/180)), s = sin(angle*(M_PI/180));
+		double lo = numeric_limits<double>::max(), hi = -lo;
+		for(const Coverage::point &p:r) {
+			lo = min(lo,across(p,c,s));
+			hi = max(hi,across(p,c,s));
+		}
+		size_t n = areas.size();
+		double total = Coverage::area(r), sum = accumulate(areas.begin(),areas.end(),0.0);
+		vector<double> cuts(n+1);
+		cuts[0] = lo;
+		cuts[n] = hi;
+		parallel_for(n-1,threads,[&](size_t k) {
+			double target = total*accumulate(areas.begin(),areas.begin()+k+1,0.0)/sum;
+			double a = lo, b = hi;
+			while(b-a>1e-3) { //mm
+				double m = (a+b)/2;
+				(area_below(r,c,s,m)<target?a:b) = m;
+			}
+			cuts[k+1] = (a+b)/2;
+		});
+		vector<Coverage::ring> result(n);
+		parallel_for(n,threads,[&](size_t k) { result[k] = clip(r,c,s,cuts[k],cuts[k+1]); });
+		return move(result);
+	}
+
+	/**
+	 * @brief plan Coverage missions of one polygon for several aircraft
+	 * @param polygon Search polygon
+	 * @param homes Home coordinate of each aircraft (first waypoint of its mission)
+	 * @param spacing Track spacing (m)
+	 * @param alt Altitude of the tracks
+	 * @param threads Number of threads (0: one per hardware thread)
+	 * @param reports Output: One summary per aircraft, if not null
+	 * @return One autopath per aircraft, in the order of homes
+	 */
+	static const vector<autopath> plan(const VecCoord &polygon, const VecCoord &homes, double spacing, double alt,
+									   size_t threads=1, vector<report> *reports=nullptr) {
+		size_t n = homes.size();
+		if(n==0)
+			throw(invalid_argument("At least one home coordinate is needed."));
+		localframe f(polygon.front());
+		Coverage::ring r = Coverage::to_local(polygon,f);
+		double angle = Coverage::best_angle(r,spacing);
+		double c = cos(angle*(M_PI/180)), s = sin(angle*(M_PI/180));
+
+		//Homes in order across the tracks: strip k goes to home order[k].
+		vector<Coverage::point> home(n);
+		for(size_t i=0; i<n; ++i)
+			f.to_local(homes[i],home[i].x,home[i].y);
+		vector<size_t> order(n);
+		iota(order.begin(),order.end(),0);
+		stable_sort(order.begin(),order.end(),[&](size_t a, size_t b) {
+			return across(home[a],c,s)<across(home[b],c,s);
+		});
+
+		double total = Coverage::area(r);
+		vector<double> areas(n,total/n), flight(n);
+		vector<vector<Coverage::point>> paths(n);
+		vector<report> reps(n);
+		for(int round=0; ; ++round) {
+			vector<Coverage::ring> parts = strips(r,angle,areas,threads);
+			parallel_for(n,threads,[&](size_t k) {
+				const Coverage::point &p = home[order[k]];
+				Coverage::report rep{angle,0,0,0,0};
+				paths[k].clear();
+				if(Coverage::area(parts[k])>0)
+					paths[k] = Coverage::sweep(parts[k],spacing,angle,p,&rep);
+				double transit = 0;
+				if(!paths[k].empty())
+					transit = hypot(paths[k].front().x-p.x,paths[k].front().y-p.y)
+							+hypot(paths[k].back().x-p.x,paths[k].back().y-p.y);
+				reps[k] = report{rep,transit};
+				flight[k] = rep.length+transit;
+			});
+			if(round==balance_rounds)
+				break;
+			//Area from the longer flights to the shorter ones, at spacing m^2 per metre of track.
+			double each = accumulate(flight.begin(),flight.end(),0.0)/n;
+			for(size_t k=0; k<n; ++k)
+				areas[k] = max(total*1e-3/n,areas[k]+(each-flight[k])*spacing);
+		}
+
+		vector<autopath> result(n,autopath(VecCoord{homes.front()}));
+		parallel_for(n,threads,[&](size_t k) {
+			size_t i = order[k];
+			VecCoord coords{homes[i]};
+			coords.reserve(paths[k].size()+1);
+			for(const Coverage::point &p:paths[k])
+				coords.push_back(f.to_coordinate(p.x,p.y,alt));
+			result[i] = autopath(coords);
+		});
+		if(reports) {
+			reports->resize(n);
+			for(size_t k=0; k<n; ++k)
+				(*reports)[order[k]] = reps[k];
+		}
+		return move(result);
+	}
+
+	/**
+	 * @brief save Saves missions as waypoint text files basename_1.txt, basename_2.txt, ...
+	 * @param missions Missions
+	 * @param basename File name without number and extension
+	 */
+	static void save(const vector<autopath> &missions, const string &basename) {
+		for(size_t i=0; i<missions.size(); ++i)
+			missions[i].save(basename+"_"+to_string(i+1)+".txt");
+	}
+
+protected:
+	/**
+	 * @brief across Position of a point across the tracks
+	 * @param p Point
+	 * @param c Cosine of the track direction
+	 * @param s Sine of the track direction
+	 * @return Position (m)
+	 */
+	static double across(const Coverage::point &p, double c, double s) {
+		return -p.x*s+p.y*c;
+	}
+
+	/**
+	 * @brief clip The part of a ring between two lines along the tracks
+	 * (Sutherland-Hodgman against each line; a concave ring cut in several
+	 * pieces stays one ring, joined by zero-width edges along the line)
+	 * @param r Ring
+	 * @param c Cosine of the track direction
+	 * @param s Sine of the track direction
+	 * @param lo Lower line (position across the tracks)
+	 * @param hi Upper line
+	 * @return Clipped ring (empty if nothing is left)
+	 */
+	static const Coverage::ring clip(const Coverage::ring &r, double c, double s, double lo, double hi) {
+		Coverage::ring a = half(r,c,s,lo,1);
+		return half(a,c,s,hi,-1);
+	}
+
+	/**
+	 * @brief half The part of a ring on one side of a line along the tracks
+	 * @param r Ring
+	 * @param c Cosine of the track direction
+	 * @param s Sine of the track direction
+	 * @param line Position of the line across the tracks
+	 * @param side 1: keep above the line, -1: keep below
+	 * @return Clipped ring
+	 */
+	static const Coverage::ring half(const Coverage::ring &r, double c, double s, double line, int side) {
+		Coverage::ring out;
+		if(r.empty())
+			return move(out);
+		out.reserve(r.size()+4);
+		for(size_t i=0, j=r.size()-1; i<r.size(); j=i++) {
+			double dj = side*(across(r[j],c,s)-line), di = side*(across(r[i],c,s)-line);
+			if((dj>=0)!=(di>=0)) {
+				double t = dj/(dj-di);
+				out.push_back(Coverage::point{r[j].x+t*(r[i].x-r[j].x),r[j].y+t*(r[i].y-r[j].y)});
+			}
+			if(di>=0)
+				out.push_back(r[i]);
+		}
+		return move(out);
+	}
+
+	/**
+	 * @brief area_below Area of the part of a ring below a line along the tracks,
+	 * like Coverage::area(half(r,c,s,line,-1)) without building the ring
+	 * @param r Ring
+	 * @param c Cosine of the track direction
+	 * @param s Sine of the track direction
+	 * @param line Position of the line across the tracks
+	 * @return Area (m^2)
+	 */
+	static double area_below(const Coverage::ring &r, double c, double s, double line) {
+		double a = 0;
+		bool first = true;
+		Coverage::point p0{0,0}, prev{0,0};
+		auto add = [&](const Coverage::point &q) {
+			if(first)
+				p0 = q;
+			else
+				a += prev.x*q.y-q.x*prev.y;
+			prev = q;
+			first = false;
+		};
+		for(size_t i=0, j=r.size()-1; i<r.size(); j=i++) {
+			double dj = line-across(r[j],c,s), di = line-across(r[i],c,s);
+			if((dj>=0)!=(di>=0)) {
+				double t = dj/(dj-di);
+				add(Coverage::point{r[j].x+t*(r[i].x-r[j].x),r[j].y+t*(r[i].y-r[j].y)});
+			}
+			if(di>=0)
+				add(r[i]);
+		}
+		if(!first)
+			a += prev.x*p0.y-p0.x*prev.y;
+		return fabs(a)/2;
+	}
+};
@@ -0,0 +1,233 @@
+/**
+ * @file pathsimplify.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "waypointgen.h"
+#include "parallel.h"
+#include "localframe.h"
+
+/**
+  * Waypoint reduction of a path before it becomes an autopath.
+  *
+  * spiral.m and zigzag.m sample at fixed angle steps, so a pattern has far more
+  * waypoints than its shape needs, and every one of them is a mission item.
+  * Douglas-Peucker keeps the first and last coordinate and, recursively, the
+  * coordinate farthest from the segment between two kept ones, as long as it
+  * is farther than the tolerance. Distances are in metres: latitude and
+  * longitude are projected on the local tangent plane of the first coordinate
+  * and the altitude is the third axis. Collinear waypoints (on straight legs)
+  * are removed by any tolerance above rounding noise, e.g. 0.01 m.
+  *
+  * Every removed coordinate is within the tolerance of the segment that
+  * replaces it:
+  * Pathsimplify::report r;
+  * autopath p(Pathsimplify::simplify(Patterngen::spiral_coordinates(start,end,30),2,&r));
+  * cout << r.before << " -> " << r.after << ", " << r.max_deviation << " m" << endl;
+  *
+  * A long path is cut into pieces of Pathsimplify::piece coordinates that are
+  * simplified independently, on several threads if asked to. The cut points are
+  * kept, so a path keeps at most one extra waypoint per piece, whatever the
+  * number of threads. Over a whole spiral, Douglas-Peucker is nearly quadratic
+  * (every split peels one coordinate off the outer loop); over pieces it stays
+  * linear in the length of the path.
+  */
+
+/**
+ * @brief The Pathsimplify class Douglas-Peucker function wrapper
+ */
+class Pathsimplify {
+public:
+	/** @brief piece Coordinates per independently simplified piece of a long path */
+	static constexpr size_t piece = 8192;
+
+	/**
+	 * @brief The report struct Result of a simplification
+	 */
+	struct report {
+		/**
+		 * @brief before Number of coordinates in
+		 * @brief after Number of coordinates out
+		 */
+		size_t before, after;
+		/** @brief max_deviation Largest distance of a removed coordinate to its segment (m) */
+		double max_deviation;
+	};
+
+	/**
+	 * @brief keep Douglas-Peucker
+	 * @param c Path
+	 * @param tolerance Largest allowed deviation (m)
+	 * @param threads Number of threads (0: one per hardware thread)
+	 * @return Ascending indices of the coordinates to keep, first and last included
+	 */
+	static const vector<size_t> keep(const VecCoord &c, double tolerance, size_t threads=1) {
+		size_t n = c.size();
+		if(n<3) {
+			vector<size_t> all(n);
+			for(size_t i=0; i<n; ++i)
+				all[i] = i;
+			return move(all);
+		}
+		plane p(c);
+		vector<char> kept(n,0);
+		double tol2 = tolerance*tolerance;
+		size_t pieces = (n-1+piece-1)/piece;
+		for(size_t k=0; k<pieces; ++k)
+			kept[k*piece] = 1;
+		kept[n-1] = 1;
+		parallel_for(pieces,threads,[&](size_t k) { run(p,k*piece,min(n-1,(k+1)*piece),tol2,kept); });
+		vector<size_t> result;
+		for(size_t i=0; i<n; ++i)
+			if(kept[i])
+				result.push_back(i);
+		return move(result);
+	}
+
+	/**
+	 * @brief simplify Removes the coordinates within the tolerance of the path
+	 * @param c Path
+	 * @param tolerance Largest allowed deviation (m)
+	 * @param r Output: Counts and measured deviation, if not null
+	 * @param threads Number of threads (0: one per hardware thread)
+	 * @return Simplified path
+	 */
+	static const VecCoord simplify(const VecCoord &c, double tolerance, report *r=nullptr, size_t threads=1) {
+		vector<size_t> k = keep(c,tolerance,threads);
+		VecCoord result;
+		result.reserve(k.size());
+		for(size_t i:k)
+			result.push_back(c[i]);
+		if(r) {
+			r->before = c.size();
+			r->after = result.size();
+			r->max_deviation = deviation(c,k);
+		}
+		return move(result);
+	}
+
+	/**
+	 * @brief deviation Measures a simplification: the distance of every removed
+	 * coordinate to the segment between the kept coordinates around it
+	 * @param c Path
+	 * @param kept Ascending indices of kept coordinates, first and last included
+	 * @return Largest distance (m)
+	 */
+	static double deviation(const VecCoord &c, const vector<size_t> &kept) {
+		if(c.empty())
+			return 0;
+		plane p(c);
+		double worst = 0;
+		for(size_t k=0; k+1<kept.size(); ++k)
+			for(size_t i=kept[k]+1; i<kept[k+1]; ++i)
+				worst = max(worst,p.distance2(kept[k],kept[k+1],i));
+		return sqrt(worst);
+	}
+
+	/**
+	 * @brief parse_tolerance Takes "-s METRES" / "-sMETRES" out of a list of arguments
+	 * @param args Arguments (e.g. the file names from Batchconvert::parse_args)
+	 * @return Tolerance (m), 0 if not given
+	 */
+	static double parse_tolerance(vector<string> &args) {
+		double tolerance = 0;
+		vector<string> rest;
+		for(size_t i=0; i<args.size(); ++i) {
+			if(args[i].compare(0,2,"-s")!=0) {
+				rest.push_back(args[i]);
+				continue;
+			}
+			string s = args[i].size()>2?args[i].substr(2):(i+1<args.size()?args[++i]:string());
+			char *end = nullptr;
+			tolerance = strtod(s.c_str(),&end);
+			if(s.empty() || *end!='\0' || !(tolerance>=0))
+				throw(invalid_argument("Expected a tolerance in metres after -s, got \""+s+"\"."));
+		}
+		args.swap(rest);
+		return tolerance;
+	}
+
+protected:
+	/**
+	 * @brief The plane struct A path on the local tangent plane of its first coordinate
+	 */
+	struct plane {
+		/**
+		 * @brief x East (m)
+		 * @brief y North (m)
+		 * @brief z Altitude (m)
+		 */
+		vector<double> x, y, z;
+
+		/**
+		 * @brief plane ctor Projects a path
+		 * @param c Path (not empty)
+		 */
+		plane(const VecCoord &c) :x(c.size()),y(c.size()),z(c.size()) {
+			localframe f(c.front());
+			for(size_t i=0; i<c.size(); ++i) {
+				f.to_local(c[i],x[i],y[i]);
+				z[i] = c[i].get_alt();
+			}
+		}
+
+		/**
+		 * @brief distance2 Squared distance of a point to a segment
+		 * @param a Segment start
+		 * @param b Segment end
+		 * @param i Point
+		 * @return Squared distance (m^2)
+		 */
+		double distance2(size_t a, size_t b, size_t i) const {
+			double dx = x[b]-x[a], dy = y[b]-y[a], dz = z[b]-z[a];
+			double len2 = dx*dx+dy*dy+dz*dz;
+			double px = x[i]-x[a], py = y[i]-y[a], pz = z[i]-z[a];
+			double dot = px*dx+py*dy+pz*dz;
+			if(dot>0 && len2>0) {
+				double t = min(1.0,dot/len2);
+				px -= t*dx;
+				py -= t*dy;
+				pz -= t*dz;
+			}
+			return px*px+py*py+pz*pz;
+		}
+	};
+
+	/**
+	 * @brief run Douglas-Peucker between two kept coordinates, with a stack
+	 * instead of recursion (a spiral can split thousands of levels deep)
+	 * @param p Path
+	 * @param first Kept coordinate
+	 * @param last Kept coordinate
+	 * @param tol2 Squared tolerance
+	 * @param kept Output: Set to 1 for the kept coordinates between first and last
+	 */
+	static void run(const plane &p, size_t first, size_t last, double tol2, vector<char> &kept) {
+		vector<pair<size_t,size_t>> stack{{first,last}};
+		while(!stack.empty()) {
+			size_t a = stack.back().first, b = stack.back().second;
+			stack.pop_back();
+			double worst = -1;
+			size_t split = a;
+			for(size_t i=a+1; i<b; ++i) {
+				double d2 = p.distance2(a,b,i);
+				if(d2>worst) {
+					worst = d2;
+					split = i;
+				}
+			}
+			if(worst<=tol2)
+				continue;
+			kept[split] = 1;
+			stack.emplace_back(split,b);
+			stack.emplace_back(a,split);
+		}
+	}
+};
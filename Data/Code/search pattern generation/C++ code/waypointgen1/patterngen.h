@@ -0,0 +1,205 @@
+/**
+ * @file patterngen.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "waypointgen.h"
+#include "utm.h"
+#include "utmbatch.h"
+
+/**
+  * Search pattern generation, ported from spiral.m, zigzag.m and sector.m.
+  *
+  * Every pattern is defined by a start and an end coordinate, just like
+  * the two first waypoints read by importtwocoords in the MATLAB scripts.
+  * The pattern is built in a local frame where the start coordinate is the
+  * origin and the end coordinate lies on the x-axis, then rotated and moved
+  * back into the UTM zone of the start coordinate.
+  * All waypoints get the altitude of the start coordinate.
+  *
+  * The generated coordinates are the same as the ones in the csv files made
+  * by the MATLAB scripts, so no csv/MATLAB round-trip is needed anymore:
+  * MAVLink::autopath p = Patterngen::spiral(start,end,30);
+  * p.save("spiral1_30m.txt");
+  */
+
+/**
+ * @brief The Patterngen class Search pattern generation function wrapper
+ */
+class Patterngen {
+protected:
+	/**
+	 * @brief The frame struct Local pattern frame: origin and rotation in UTM
+	 */
+	struct frame {
+		/** @brief origin Start coordinate in UTM */
+		UTM::utmcoord origin;
+		/**
+		 * @brief cosr cos of rotation from local frame to UTM
+		 * @brief sinr sin of rotation from local frame to UTM
+		 */
+		double cosr, sinr;
+		/** @brief length Distance from start to end (m) */
+		double length;
+		/** @brief alt Altitude of all waypoints */
+		double alt;
+
+		/**
+		 * @brief frame ctor
+		 * @param start Start coordinate (origin)
+		 * @param end End coordinate (on local x-axis)
+		 */
+		frame(const coordinate &start, const coordinate &end)
+			:origin(UTM::deg2utm(start.get_lat(),start.get_lon())),
+			  alt(start.get_alt())
+		{
+			UTM::utmcoord e = UTM::deg2utm(end.get_lat(),end.get_lon());
+			double dx = e.x-origin.x;
+			double dy = e.y-origin.y;
+			length = std::sqrt(dx*dx+dy*dy);
+			//Same as rotdiff in the MATLAB scripts. Note that the sine is
+			//always positive there, so the rotation is in [0;pi].
+			cosr = length>0?dx/length:1;
+			sinr = std::sqrt(std::fabs(cosr*cosr-1));
+		}
+
+		/**
+		 * @brief to_coordinates Converts points in the local frame to lat/lon
+		 * @param x Local x (m), overwritten with UTM easting
+		 * @param y Local y (m), overwritten with UTM northing
+		 * @return Coordinates
+		 */
+		VecCoord to_coordinates(vector<double> &x, vector<double> &y) const {
+			for(size_t i=0; i<x.size(); ++i) {
+				double ux = origin.x+cosr*x[i]-sinr*y[i];
+				double uy = origin.y+sinr*x[i]+cosr*y[i];
+				x[i] = ux;
+				y[i] = uy;
+			}
+			return UTM::utm2deg(x,y,origin.zone,origin.north(),alt);
+		}
+	};
+
+public:
+	/**
+	 * @brief spiral_coordinates Archimedean spiral (spiral.m)
+	 * @param start Centre of the spiral
+	 * @param end Defines the direction of the first leg and the number of turns
+	 * @param spacing Spacing parameter (m), turns = |end-start|/spacing
+	 * @param inwards Fly from the outside towards the centre
+	 * @return Coordinates
+	 */
+	static const VecCoord spiral_coordinates(const coordinate &start, const coordinate &end,
+											 double spacing, bool inwards=false) {
+		frame f(start,end);
+		double turns = f.length/spacing;
+		//th=0:pi/10:2*pi*turns
+		size_t n = static_cast<size_t>(std::floor(20*turns+1e-10))+1;
+		vector<double> x(n), y(n);
+		for(size_t i=0; i<n; ++i) {
+			double th = i*(M_PI/10);
+			x[i] = turns*th*std::cos(th);
+			y[i] = turns*th*std::sin(th);
+		}
+		VecCoord result = f.to_coordinates(x,y);
+		if(inwards)
+			reverse(result.begin(),result.end());
+		return move(result);
+	}
+
+	/**
+	 * @brief zigzag_coordinates Zigzag sweep from start to end (zigzag.m)
+	 * @param start Start coordinate
+	 * @param end End coordinate
+	 * @param density_m Distance between neighbouring turn points along the sweep (m)
+	 * @param angle_degrees Opening angle of the zigzag (degrees)
+	 * @return Coordinates, ending with the end coordinate
+	 */
+	static const VecCoord zigzag_coordinates(const coordinate &start, const coordinate &end,
+											 double density_m, double angle_degrees) {
+		frame f(start,end);
+		double angle1rad = (angle_degrees/2)*M_PI/180;
+		double cangle = std::cos(angle1rad);
+		double sangle = std::sin(angle1rad);
+		double bigsteplength = density_m/cangle;
+		size_t tot2steplength = static_cast<size_t>(std::floor(f.length/density_m));
+		//cflatstep and ccflatstep: bigsteplength along the x-axis rotated by -/+ angle1
+		double cx = bigsteplength*cangle, cy = -bigsteplength*sangle;
+		double ccx = bigsteplength*cangle, ccy = bigsteplength*sangle;
+		vector<double> x(1,0), y(1,0);
+		x.reserve(tot2steplength+2);
+		y.reserve(tot2steplength+2);
+		//MATLAB indices i and i+1 become vector indices i-1 and i.
+		for(size_t i=2; i<=tot2steplength; i+=2) {
+			double k = static_cast<double>(i-1);
+			//cflatstep first if mod(i,4)==2, else ccflatstep (its mirror image)
+			double sy = (i%4==2)?1:-1;
+			x.push_back(k*cx); y.push_back(sy*k*cy);
+			x.push_back(k*ccx); y.push_back(sy*k*ccy);
+		}
+		VecCoord result = f.to_coordinates(x,y);
+		result.emplace_back(end.get_lat(),end.get_lon(),f.alt);
+		return move(result);
+	}
+
+	/**
+	 * @brief sector_coordinates Sector search with 30 degree rotations (sector.m)
+	 * @param start Centre of the sector search
+	 * @param end End of the first leg, defines the radius
+	 * @return 19 coordinates: six triangles through the centre
+	 */
+	static const VecCoord sector_coordinates(const coordinate &start, const coordinate &end) {
+		frame f(start,end);
+		//Clockwise rotations of the first leg, in degrees. -1 is the centre.
+		static const int rotations[19] = {
+			-1, 0, 60, -1, 120, 180, -1, 240, 300, -1,
+			30, 90, -1, 150, 210, -1, 270, 330, -1 };
+		vector<double> x, y;
+		for(int r:rotations) {
+			double th = -r*M_PI/180;
+			x.push_back(r<0?0:f.length*std::cos(th));
+			y.push_back(r<0?0:f.length*std::sin(th));
+		}
+		VecCoord result = f.to_coordinates(x,y);
+		return move(result);
+	}
+
+	/**
+	 * @brief spiral Generates spiral autopath
+	 * @param start Centre of the spiral
+	 * @param end Defines the direction of the first leg and the number of turns
+	 * @param spacing Spacing parameter (m)
+	 * @param inwards Fly from the outside towards the centre
+	 * @return autopath
+	 */
+	static const autopath spiral(const coordinate &start, const coordinate &end,
+								 double spacing, bool inwards=false) {
+		return move(autopath(spiral_coordinates(start,end,spacing,inwards)));
+	}
+
+	/**
+	 * @brief zigzag Generates zigzag autopath
+	 * @param start Start coordinate
+	 * @param end End coordinate
+	 * @param density_m Distance between turn points (m)
+	 * @param angle_degrees Opening angle (degrees)
+	 * @return autopath
+	 */
+	static const autopath zigzag(const coordinate &start, const coordinate &end,
+								 double density_m, double angle_degrees) {
+		return move(autopath(zigzag_coordinates(start,end,density_m,angle_degrees)));
+	}
+
+	/**
+	 * @brief sector Generates sector search autopath
+	 * @param start Centre of the sector search
+	 * @param end End of the first leg
+	 * @return autopath
+	 */
+	static const autopath sector(const coordinate &start, const coordinate &end) {
+		return move(autopath(sector_coordinates(start,end)));
+	}
+};
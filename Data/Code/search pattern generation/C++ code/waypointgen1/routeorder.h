@@ -0,0 +1,445 @@
+/**
+ * @file routeorder.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <numeric>
+#include <vector>
+#include "waypointgen.h"
+#include "localframe.h"
+#include "utm.h"
+
+/**
+  * Visiting order of points of interest (a travelling salesman heuristic).
+  *
+  * Detections and reported sightings arrive in no useful order, and autopath
+  * flies them in the order given. Here the first coordinate (home or the
+  * current position) stays first and the others are reordered for a short
+  * open route:
+  * Routeorder::report r;
+  * autopath p(Routeorder::reorder(points,&r));
+  *
+  * The seed is the nearest-neighbour route, which is then improved by 2-opt
+  * (reversing a stretch of the route) and Or-opt (moving 1-3 consecutive
+  * points elsewhere, possibly reversed) until no move shortens it. Moves are
+  * only tried towards the nearest neighbours of a point, found on a uniform
+  * grid on the local tangent plane, and only for points next to a recent
+  * change (don't-look bits), so 10000 points take well under a second.
+  *
+  * Lengths are straight lines between earth-centred (ECEF, WGS84) positions,
+  * altitude included. Over the legs of a mission this differs from the
+  * ellipsoidal distance by less than a millimetre per 10 km.
+  */
+
+/**
+ * @brief The Routeorder class Route optimization function wrapper
+ */
+class Routeorder {
+public:
+	/** @brief neighbours Candidate neighbours per point */
+	static constexpr size_t neighbours = 10;
+
+	/**
+	 * @brief The report struct Route lengths
+	 */
+	struct report {
+		/**
+		 * @brief input Length in the given order (m)
+		 * @brief nearest_neighbour Length of the nearest-neighbour seed (m)
+		 * @brief optimized Length after 2-opt and Or-opt (m)
+		 */
+		double input, nearest_neighbour, optimized;
+	};
+
+	/**
+	 * @brief order Short visiting order
+	 * @param points Points, the first one being the start
+	 * @param r Output: Lengths, if not null
+	 * @return Permutation of the indices of points, starting with 0
+	 */
+	static const vector<size_t> order(const VecCoord &points, report *r=nullptr) {
+		size_t n = points.size();
+		vector<double> xyz = ecef(points);
+		vector<size_t> t(n);
+		iota(t.begin(),t.end(),0);
+		if(r)
+			r->input = length(xyz,t);
+		if(n>3) {
+			vector<double> x(n), y(n);
+			localframe f(points.front());
+			for(size_t i=0; i<n; ++i)
+				f.to_local(points[i],x[i],y[i]);
+			grid g(x,y);
+			vector<vector<size_t>> near = g.neighbours(x,y,neighbours);
+			t = nearest_neighbour(g,x,y);
+			if(r)
+				r->nearest_neighbour = length(xyz,t);
+			improve(t,xyz,near);
+		}
+		else if(r)
+			r->nearest_neighbour = r->input;
+		if(r)
+			r->optimized = length(xyz,t);
+		return move(t);
+	}
+
+	/**
+	 * @brief reorder Points in a short visiting order
+	 * @param points Points, the first one being the start
+	 * @param r Output: Lengths, if not null
+	 * @return Reordered points
+	 */
+	static const VecCoord reorder(const VecCoord &points, report *r=nullptr) {
+		VecCoord result;
+		result.reserve(points.size());
+		for(size_t i:order(points,r))
+			result.push_back(points[i]);
+		return move(result);
+	}
+
+	/**
+	 * @brief length Length of a path
+	 * @param path Path
+	 * @return Sum of the straight lines between ECEF positions (m)
+	 */
+	static double length(const VecCoord &path) {
+		vector<size_t> t(path.size());
+		iota(t.begin(),t.end(),0);
+		return length(ecef(path),t);
+	}
+
+protected:
+	/**
+	 * @brief ecef Earth-centred, earth-fixed positions (WGS84)
+	 * @param points Points
+	 * @return x, y, z of every point (m)
+	 */
+	static const vector<double> ecef(const VecCoord &points) {
+		vector<double> xyz(3*points.size());
+		for(size_t i=0; i<points.size(); ++i) {
+			double lat = points[i].get_lat()*(M_PI/180), lon = points[i].get_lon()*(M_PI/180);
+			double h = points[i].get_alt(), s = sin(lat);
+			double N = UTM::sa/sqrt(1-UTM::e2*s*s);
+			xyz[3*i] = (N+h)*cos(lat)*cos(lon);
+			xyz[3*i+1] = (N+h)*cos(lat)*sin(lon);
+			xyz[3*i+2] = (N*(1-UTM::e2)+h)*s;
+		}
+		return move(xyz);
+	}
+
+	/**
+	 * @brief dist Distance between two points
+	 * @param xyz ECEF positions
+	 * @param a Point
+	 * @param b Point
+	 * @return Distance (m)
+	 */
+	static double dist(const vector<double> &xyz, size_t a, size_t b) {
+		double dx = xyz[3*a]-xyz[3*b], dy = xyz[3*a+1]-xyz[3*b+1], dz = xyz[3*a+2]-xyz[3*b+2];
+		return sqrt(dx*dx+dy*dy+dz*dz);
+	}
+
+	/**
+	 * @brief length Length of a route
+	 * @param xyz ECEF positions
+	 * @param t Route
+	 * @return Length (m)
+	 */
+	static double length(const vector<double> &xyz, const vector<size_t> &t) {
+		double l = 0;
+		for(size_t i=1; i<t.size(); ++i)
+			l += dist(xyz,t[i-1],t[i]);
+		return l;
+	}
+
+	/**
+	 * @brief The grid struct Points bucketed in square cells of the local tangent plane
+	 */
+	struct grid {
+		/**
+		 * @brief x0 West edge
+		 * @brief y0 South edge
+		 * @brief cell Cell size (m)
+		 */
+		double x0, y0, cell;
+		/**
+		 * @brief nx Columns
+		 * @brief ny Rows
+		 */
+		long nx, ny;
+		/** @brief cells Points of every cell (row major) */
+		vector<vector<size_t>> cells;
+
+		/**
+		 * @brief grid ctor About two points per cell
+		 * @param x East (m)
+		 * @param y North (m)
+		 */
+		grid(const vector<double> &x, const vector<double> &y) {
+			double x1 = *max_element(x.begin(),x.end()), y1 = *max_element(y.begin(),y.end());
+			x0 = *min_element(x.begin(),x.end());
+			y0 = *min_element(y.begin(),y.end());
+			cell = max(1e-3,sqrt(max(1.0,(x1-x0)*(y1-y0))*2/x.size()));
+			cell = max(cell,max(x1-x0,y1-y0)/4096); //a long, thin cloud: at most 4096 cells a side
+			nx = static_cast<long>((x1-x0)/cell)+1;
+			ny = static_cast<long>((y1-y0)/cell)+1;
+			cells.resize(nx*ny);
+			for(size_t i=0; i<x.size(); ++i)
+				cells[index(x[i],y[i])].push_back(i);
+		}
+
+		/**
+		 * @brief column Column of a position
+		 * @param x East (m)
+		 * @return Column
+		 */
+		long column(double x) const { return min(nx-1,max(0L,static_cast<long>((x-x0)/cell))); }
+		/**
+		 * @brief row Row of a position
+		 * @param y North (m)
+		 * @return Row
+		 */
+		long row(double y) const { return min(ny-1,max(0L,static_cast<long>((y-y0)/cell))); }
+		/**
+		 * @brief index Cell of a position
+		 * @param x East (m)
+		 * @param y North (m)
+		 * @return Cell index
+		 */
+		size_t index(double x, double y) const { return row(y)*nx+column(x); }
+
+		/**
+		 * @brief beyond Whether the rings from r on can hold nothing nearer:
+		 * a point in ring r is at least (r-1) cells away
+		 * @param r Ring
+		 * @param d2 Squared distance found so far
+		 * @return true if the search can stop
+		 */
+		bool beyond(long r, double d2) const {
+			return r>=1 && d2<=((r-1)*cell)*((r-1)*cell);
+		}
+
+		/**
+		 * @brief for_ring Calls f(cell index) for the cells at Chebyshev distance r from a cell
+		 * @param cx Column
+		 * @param cy Row
+		 * @param r Ring
+		 * @param f Function
+		 * @return false if the ring is entirely outside the grid
+		 */
+		template<class F>
+		bool for_ring(long cx, long cy, long r, F f) const {
+			if(cx-r<0 && cy-r<0 && cx+r>=nx && cy+r>=ny)
+				return false;
+			for(long j=max(0L,cy-r); j<=min(ny-1,cy+r); ++j) {
+				if(j==cy-r || j==cy+r) {
+					for(long i=max(0L,cx-r); i<=min(nx-1,cx+r); ++i)
+						f(j*nx+i);
+					continue;
+				}
+				if(cx-r>=0)
+					f(j*nx+cx-r);
+				if(cx+r<nx)
+					f(j*nx+cx+r);
+			}
+			return true;
+		}
+
+		/**
+		 * @brief neighbours The k nearest points of every point
+		 * @param x East (m)
+		 * @param y North (m)
+		 * @param k Number of neighbours
+		 * @return k (or fewer) neighbours per point, nearest first
+		 */
+		const vector<vector<size_t>> neighbours(const vector<double> &x, const vector<double> &y, size_t k) const {
+			vector<vector<size_t>> result(x.size());
+			vector<pair<double,size_t>> found;
+			for(size_t p=0; p<x.size(); ++p) {
+				found.clear();
+				long cx = column(x[p]), cy = row(y[p]);
+				for(long r=0; ; ++r) {
+					if(found.size()>=k) {
+						nth_element(found.begin(),found.begin()+k-1,found.end());
+						if(beyond(r,found[k-1].first))
+							break;
+					}
+					if(!for_ring(cx,cy,r,[&](size_t c) {
+						for(size_t q:cells[c])
+							if(q!=p)
+								found.emplace_back((x[q]-x[p])*(x[q]-x[p])+(y[q]-y[p])*(y[q]-y[p]),q);
+					}))
+						break;
+				}
+				size_t m = min(k,found.size());
+				partial_sort(found.begin(),found.begin()+m,found.end());
+				for(size_t i=0; i<m; ++i)
+					result[p].push_back(found[i].second);
+			}
+			return move(result);
+		}
+	};
+
+	/**
+	 * @brief nearest_neighbour Route always flying to the nearest unvisited point
+	 * @param g Grid of the points (emptied)
+	 * @param x East (m)
+	 * @param y North (m)
+	 * @return Route from point 0
+	 */
+	static const vector<size_t> nearest_neighbour(grid &g, const vector<double> &x, const vector<double> &y) {
+		size_t n = x.size();
+		auto take = [&](size_t p) {
+			vector<size_t> &c = g.cells[g.index(x[p],y[p])];
+			c.erase(find(c.begin(),c.end(),p));
+		};
+		vector<size_t> t{0};
+		take(0);
+		while(t.size()<n) {
+			size_t p = t.back(), best = p;
+			double nearest = INFINITY;
+			long cx = g.column(x[p]), cy = g.row(y[p]);
+			for(long r=0; ; ++r) {
+				if(best!=p && g.beyond(r,nearest))
+					break;
+				if(!g.for_ring(cx,cy,r,[&](size_t c) {
+					for(size_t q:g.cells[c]) {
+						double d = (x[q]-x[p])*(x[q]-x[p])+(y[q]-y[p])*(y[q]-y[p]);
+						if(d<nearest) {
+							nearest = d;
+							best = q;
+						}
+					}
+				}))
+					break;
+			}
+			take(best);
+			t.push_back(best);
+		}
+		return move(t);
+	}
+
+	/**
+	 * @brief improve 2-opt and Or-opt over the neighbour lists until no move shortens the route
+	 * @param t Route (t[0] stays first)
+	 * @param xyz ECEF positions
+	 * @param near Neighbours of every point
+	 */
+	static void improve(vector<size_t> &t, const vector<double> &xyz, const vector<vector<size_t>> &near) {
+		size_t n = t.size();
+		vector<size_t> pos(n);
+		for(size_t i=0; i<n; ++i)
+			pos[t[i]] = i;
+		auto d = [&](size_t a, size_t b) { return dist(xyz,a,b); };
+		//Edge from position i to i+1, 0 past the end (an open route)
+		auto edge = [&](size_t i) { return i+1<n?d(t[i],t[i+1]):0.0; };
+		auto fix = [&](size_t from, size_t to) {
+			for(size_t i=from; i<=to; ++i)
+				pos[t[i]] = i;
+		};
+		deque<size_t> queue(t.begin(),t.end());
+		vector<char> queued(n,1);
+		auto wake = [&](size_t i) {
+			if(i<n && !queued[t[i]]) {
+				queued[t[i]] = 1;
+				queue.push_back(t[i]);
+			}
+		};
+		const double eps = 1e-7;
+		while(!queue.empty()) {
+			size_t a = queue.front();
+			queue.pop_front();
+			queued[a] = 0;
+			bool improved = false;
+
+			//2-opt: new edge (a,c), reversing t[i+1..j].
+			for(size_t c:near[a]) {
+				size_t p = min(pos[a],pos[c]), q = max(pos[a],pos[c]);
+				if(q<p+2)
+					continue;
+				double add = d(t[p],t[q]);
+				//i=p, j=q: remove (t[p],t[p+1]) and (t[q],t[q+1]), add (t[p],t[q]) and (t[p+1],t[q+1])
+				double g1 = edge(p)+edge(q)-add-(q+1<n?d(t[p+1],t[q+1]):0.0);
+				//i=p-1, j=q-1: remove (t[p-1],t[p]) and (t[q-1],t[q]), add (t[p-1],t[q-1]) and (t[p],t[q])
+				double g2 = p>0?edge(p-1)+edge(q-1)-add-d(t[p-1],t[q-1]):-1;
+				if(max(g1,g2)<=eps)
+					continue;
+				size_t i = g1>=g2?p:p-1, j = g1>=g2?q:q-1;
+				reverse(t.begin()+i+1,t.begin()+j+1);
+				fix(i+1,j);
+				wake(i);
+				wake(i+1);
+				wake(j);
+				wake(j+1);
+				improved = true;
+				break;
+			}
+			if(improved)
+				continue;
+
+			//Or-opt: move a segment of 1-3 points starting or ending at a next to a neighbour.
+			for(size_t len=1; len<=3 && !improved; ++len) {
+				for(int end=0; end<2 && !improved; ++end) {
+					if(pos[a]<(end?len:1))
+						continue;
+					size_t i = end?pos[a]-len+1:pos[a]; //segment t[i..i+len-1]
+					if(i<1 || i+len>n)
+						continue;
+					size_t first = t[i], last = t[i+len-1];
+					double removed = edge(i-1)+edge(i+len-1)-(i+len<n?d(t[i-1],t[i+len]):0.0);
+					if(removed<=eps)
+						continue;
+					for(size_t c:near[a]) {
+						size_t k = pos[c];
+						//Insert between t[k] and t[k+1], or between t[k-1] and t[k].
+						for(int side=0; side<2 && !improved; ++side) {
+							if(side==1 && k==0)
+								continue;
+							size_t x = side?k-1:k;
+							if(x+1>=i && x<=i+len-1)
+								continue; //touches the segment
+							double base = x+1<n?d(t[x],t[x+1]):0.0;
+							double fwd = d(t[x],first)+(x+1<n?d(last,t[x+1]):0.0)-base;
+							double rev = d(t[x],last)+(x+1<n?d(first,t[x+1]):0.0)-base;
+							if(removed-min(fwd,rev)<=eps)
+								continue;
+							bool reversed = rev<fwd;
+							size_t lo, hi;
+							if(x>i) {
+								rotate(t.begin()+i,t.begin()+i+len,t.begin()+x+1);
+								if(reversed)
+									reverse(t.begin()+x+1-len,t.begin()+x+1);
+								lo = i;
+								hi = x;
+							}
+							else {
+								rotate(t.begin()+x+1,t.begin()+i,t.begin()+i+len);
+								if(reversed)
+									reverse(t.begin()+x+1,t.begin()+x+1+len);
+								lo = x+1;
+								hi = i+len-1;
+							}
+							fix(lo,hi);
+							wake(lo>0?lo-1:0);
+							wake(lo);
+							wake(hi);
+							wake(hi+1);
+							wake(x);
+							wake(i);
+							improved = true;
+						}
+						if(improved)
+							break;
+					}
+				}
+			}
+			if(improved) {
+				queued[a] = 1;
+				queue.push_back(a);
+			}
+		}
+	}
+};
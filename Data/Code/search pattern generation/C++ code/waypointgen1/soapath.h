@@ -0,0 +1,181 @@
+/**
+ * @file soapath.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "waypointgen.h"
+#include "wplwriter.h"
+
+namespace MAVLink {
+/**
+ * @brief The soa_autopath struct autopath stored as a structure of arrays.
+ *
+ * A MAVLink::waypoint is 96 bytes: three size_t flags, a size_t command id
+ * and a tuple based coordinate. Here every field lives in its own contiguous
+ * array, with narrow integers for index, command, frame and flags, which is
+ * 64 bytes per waypoint. Transforms that only touch lat/lon/alt stream
+ * through 24 bytes per waypoint, and the arrays can be vectorized.
+ *
+ * Construction from coordinates and save() give the same waypoints and the
+ * same file as autopath.
+ */
+struct soa_autopath {
+	/** @brief flag_current current_wp bit in flags */
+	static constexpr uint8_t flag_current = 1;
+	/** @brief flag_autocontinue autocontinue bit in flags */
+	static constexpr uint8_t flag_autocontinue = 2;
+
+	/**
+	 * @brief lat Latitudes
+	 * @brief lon Longitudes
+	 * @brief alt Altitudes
+	 */
+	vector<double> lat, lon, alt;
+	/**
+	 * @brief p1 Param 1
+	 * @brief p2 Param 2
+	 * @brief p3 Param 3
+	 * @brief p4 Param 4
+	 */
+	vector<double> p1, p2, p3, p4;
+	/** @brief index Index */
+	vector<uint32_t> index;
+	/** @brief cmd CMD_ID */
+	vector<uint16_t> cmd;
+	/** @brief coord_frame Coordinate frame */
+	vector<uint8_t> coord_frame;
+	/** @brief flags flag_current | flag_autocontinue */
+	vector<uint8_t> flags;
+
+	/** @brief soa_autopath ctor Empty path */
+	soa_autopath() { }
+
+	/**
+	 * @brief soa_autopath ctor Same waypoints as autopath(coords)
+	 * @param coords Coordinates
+	 */
+	soa_autopath(const vector<coordinate> &coords) {
+		size_t n = coords.size();
+		reserve(n);
+		for(size_t i=0; i<n; ++i) {
+			lat.push_back(coords[i].get_lat());
+			lon.push_back(coords[i].get_lon());
+			alt.push_back(coords[i].get_alt());
+		}
+		p1.assign(n,0); p2.assign(n,0); p3.assign(n,0); p4.assign(n,0);
+		index.resize(n);
+		for(size_t i=0; i<n; ++i)
+			index[i] = static_cast<uint32_t>(i);
+		cmd.assign(n,16);
+		coord_frame.assign(n,0);
+		flags.assign(n,flag_autocontinue);
+		if(n>0)
+			flags.front() |= flag_current;
+	}
+
+	/**
+	 * @brief soa_autopath ctor Converts waypoints
+	 * @param wps Waypoints
+	 */
+	explicit soa_autopath(const VecWP &wps) {
+		reserve(wps.size());
+		for(const waypoint &w:wps)
+			push_back(w);
+	}
+
+	/**
+	 * @brief reserve Reserves room in all arrays
+	 * @param n Number of waypoints
+	 */
+	void reserve(size_t n) {
+		lat.reserve(n); lon.reserve(n); alt.reserve(n);
+		p1.reserve(n); p2.reserve(n); p3.reserve(n); p4.reserve(n);
+		index.reserve(n); cmd.reserve(n); coord_frame.reserve(n); flags.reserve(n);
+	}
+
+	/**
+	 * @brief size
+	 * @return Number of waypoints
+	 */
+	size_t size() const { return lat.size(); }
+
+	/**
+	 * @brief push_back Appends a waypoint, throws out_of_range if its index,
+	 * command or frame does not fit the narrow arrays
+	 * @param w Waypoint
+	 */
+	void push_back(const waypoint &w) {
+		const command &c = w.my_cmd;
+		if(w.index>UINT32_MAX || c.cmd>UINT16_MAX || w.coord_frame>UINT8_MAX)
+			throw(out_of_range("Waypoint "+to_string(w.index)+" (command "+to_string(c.cmd)+", frame "
+							   +to_string(w.coord_frame)+") does not fit soa_autopath."));
+		lat.push_back(c.coord.get_lat());
+		lon.push_back(c.coord.get_lon());
+		alt.push_back(c.coord.get_alt());
+		p1.push_back(c.p1); p2.push_back(c.p2); p3.push_back(c.p3); p4.push_back(c.p4);
+		index.push_back(static_cast<uint32_t>(w.index));
+		cmd.push_back(static_cast<uint16_t>(c.cmd));
+		coord_frame.push_back(static_cast<uint8_t>(w.coord_frame));
+		flags.push_back((w.current_wp?flag_current:0)|(w.autocontinue?flag_autocontinue:0));
+	}
+
+	/**
+	 * @brief operator[] Waypoint i
+	 * @param i Index into the arrays
+	 * @return Waypoint (a copy)
+	 */
+	waypoint operator[](size_t i) const {
+		return waypoint(index[i],(flags[i]&flag_current)?1:0,coord_frame[i],
+						cmd[i],p1[i],p2[i],p3[i],p4[i],lat[i],lon[i],alt[i],
+						(flags[i]&flag_autocontinue)?1:0);
+	}
+
+	/**
+	 * @brief to_waypoints Converts to a vector of waypoints
+	 * @return Waypoints
+	 */
+	const VecWP to_waypoints() const {
+		VecWP result;
+		result.reserve(size());
+		for(size_t i=0; i<size(); ++i)
+			result.push_back((*this)[i]);
+		return move(result);
+	}
+
+	/**
+	 * @brief format Formats as waypoint file, like autopath::save writes it
+	 * @param buf Buffer, replaced by the file contents
+	 */
+	void format(string &buf) const {
+		Wplwriter::format_rows(size(),buf,[this](char *&p, size_t i) {
+			Wplwriter::put_uint(p,index[i]); *p++ = '\t';
+			Wplwriter::put_uint(p,(flags[i]&flag_current)?1:0); *p++ = '\t';
+			Wplwriter::put_uint(p,coord_frame[i]); *p++ = '\t';
+			Wplwriter::put_uint(p,cmd[i]); *p++ = '\t';
+			Wplwriter::put_fixed(p,p1[i]); *p++ = '\t';
+			Wplwriter::put_fixed(p,p2[i]); *p++ = '\t';
+			Wplwriter::put_fixed(p,p3[i]); *p++ = '\t';
+			Wplwriter::put_fixed(p,p4[i]); *p++ = '\t';
+			Wplwriter::put_fixed(p,lat[i]); *p++ = '\t';
+			Wplwriter::put_fixed(p,lon[i]); *p++ = '\t';
+			Wplwriter::put_fixed(p,alt[i]); *p++ = '\t';
+			Wplwriter::put_uint(p,(flags[i]&flag_autocontinue)?1:0);
+			*p++ = '\r'; *p++ = '\n';
+		});
+	}
+
+	/**
+	 * @brief save Saves as waypoint text file
+	 * @param filename Filename (.txt)
+	 */
+	void save(const string &filename) const {
+		string buf;
+		format(buf);
+		Wplwriter::write_file(filename,buf);
+	}
+};
+} //namespace MAVLink
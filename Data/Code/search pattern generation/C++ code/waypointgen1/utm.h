@@ -0,0 +1,140 @@
+/**
+ * @file utm.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <cmath>
+#include "waypointgen.h"
+
+/**
+  * WGS84 lat/lon <-> UTM conversion.
+  * This is a direct port of deg2utm.m and utm2deg.m in ../../utm2lonlat
+  * (Erwin Nindl, Rafael Palacios), using the exact same series, so that
+  * search patterns generated in C++ land on the same coordinates as the
+  * ones generated in MATLAB.
+  */
+
+namespace UTM {
+/** @brief sa Semi-major axis (WGS84) */
+const double sa = 6378137.000000;
+/** @brief sb Semi-minor axis (WGS84) */
+const double sb = 6356752.314245;
+/** @brief e2 First eccentricity squared */
+const double e2 = ((sa*sa)-(sb*sb))/(sa*sa);
+/** @brief e2cuadrada Second eccentricity squared */
+const double e2cuadrada = ((sa*sa)-(sb*sb))/(sb*sb);
+/** @brief c Polar radius of curvature */
+const double c = (sa*sa)/sb;
+
+/**
+ * @brief The utmcoord struct Easting, northing and zone of a point.
+ */
+struct utmcoord {
+	/**
+	 * @brief x Easting
+	 * @brief y Northing
+	 */
+	double x, y;
+	/** @brief zone Zone number (1-60) */
+	int zone;
+	/** @brief letter Latitude band letter ('C'-'X') */
+	char letter;
+
+	/**
+	 * @brief north Is the point on the northern hemisphere?
+	 * @return letter>'M'
+	 */
+	bool north() const { return letter>'M'; }
+};
+
+/**
+ * @brief band_letter Latitude band letter, as in deg2utm.m
+ * @param lat Latitude
+ * @return 'C'-'X'
+ */
+inline char band_letter(double lat) {
+	static const char letters[] = "CDEFGHJKLMNPQRSTUVWX";
+	if(lat<-72) return 'C';
+	if(lat>=72) return 'X';
+	return letters[static_cast<int>(std::floor((lat+80.0)/8.0))];
+}
+
+/**
+ * @brief meridian_arc Bm in deg2utm.m/utm2deg.m
+ * @param lat Latitude (rad)
+ * @param cos2lat cos(lat)^2
+ * @return Scaled meridian arc length
+ */
+inline double meridian_arc(double lat, double cos2lat) {
+	const double alfa = (3.0/4.0)*e2cuadrada;
+	const double beta = (5.0/3.0)*alfa*alfa;
+	const double gama = (35.0/27.0)*alfa*alfa*alfa;
+	double a1 = std::sin(2*lat);
+	double a2 = a1*cos2lat;
+	double j2 = lat+(a1/2);
+	double j4 = ((3*j2)+a2)/4;
+	double j6 = ((5*j4)+(a2*cos2lat))/3;
+	return 0.9996*c*(lat-alfa*j2+beta*j4-gama*j6);
+}
+
+/**
+ * @brief deg2utm Converts latitude/longitude to UTM
+ * @param Lat Latitude (degrees)
+ * @param Lon Longitude (degrees)
+ * @param zone Zone to project into, or 0 for the zone of (Lat,Lon)
+ * @return UTM coordinate
+ */
+inline utmcoord deg2utm(double Lat, double Lon, int zone=0) {
+	double lat = Lat*(M_PI/180);
+	double lon = Lon*(M_PI/180);
+	int Huso = zone>0?zone:static_cast<int>((Lon/6)+31); //fix() truncates towards zero
+	double S = (Huso*6)-183;
+	double deltaS = lon-(S*(M_PI/180));
+	double coslat = std::cos(lat);
+	double cos2lat = coslat*coslat;
+	double a = coslat*std::sin(deltaS);
+	double epsilon = 0.5*std::log((1+a)/(1-a));
+	double nu = std::atan(std::tan(lat)/std::cos(deltaS))-lat;
+	double v = (c/std::sqrt(1+(e2cuadrada*cos2lat)))*0.9996;
+	double ta = (e2cuadrada/2)*epsilon*epsilon*cos2lat;
+	double Bm = meridian_arc(lat,cos2lat);
+	utmcoord u;
+	u.x = epsilon*v*(1+(ta/3))+500000;
+	u.y = nu*v*(1+ta)+Bm;
+	if(u.y<0)
+		u.y = 9999999+u.y;
+	u.zone = Huso;
+	u.letter = band_letter(Lat);
+	return u;
+}
+
+/**
+ * @brief utm2deg Converts UTM to latitude/longitude
+ * @param u UTM coordinate
+ * @param alt Altitude of the resulting coordinate
+ * @return Coordinate
+ */
+inline MAVLink::coordinate utm2deg(const utmcoord &u, double alt=0) {
+	double X = u.x-500000;
+	double Y = u.north()?u.y:u.y-10000000;
+	double S = (u.zone*6)-183;
+	double lat = Y/(6366197.724*0.9996);
+	double coslat = std::cos(lat);
+	double cos2lat = coslat*coslat;
+	double v = (c/std::sqrt(1+(e2cuadrada*cos2lat)))*0.9996;
+	double a = X/v;
+	double Bm = meridian_arc(lat,cos2lat);
+	double b = (Y-Bm)/v;
+	double Epsi = ((e2cuadrada*a*a)/2)*cos2lat;
+	double Eps = a*(1-(Epsi/3));
+	double nab = (b*(1-Epsi))+lat;
+	double senoheps = (std::exp(Eps)-std::exp(-Eps))/2;
+	double Delt = std::atan(senoheps/(std::cos(nab)));
+	double TaO = std::atan(std::cos(Delt)*std::tan(nab));
+	double longitude = (Delt*(180/M_PI))+S;
+	double latitude = (lat+(1+e2cuadrada*cos2lat-(3.0/2.0)
+							*e2cuadrada*std::sin(lat)*coslat*(TaO-lat))
+					   *(TaO-lat))*(180/M_PI);
+	return MAVLink::coordinate(latitude,longitude,alt);
+}
+} //namespace UTM
@@ -0,0 +1,420 @@
+/**
+ * @file utmbatch.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "waypointgen.h"
+#include "utm.h"
+
+/**
+  * Batched WGS84 lat/lon <-> UTM conversion.
+  *
+  * Same series as utm.h (deg2utm.m/utm2deg.m), evaluated on arrays.
+  * On x86 with GCC/Clang, four points at a time are converted with AVX2/FMA
+  * if the CPU supports it (checked at run time, no compiler flags needed).
+  * The transcendental functions are vectorized versions of the Cephes
+  * double precision sin/cos/atan/log/exp, so results agree with the scalar
+  * code to well below a millimetre. Everywhere else the scalar code is used.
+  */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTM_HAVE_AVX2 1
+#include <immintrin.h>
+#define UTM_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define UTM_HAVE_AVX2 0
+#endif
+
+namespace UTM {
+/**
+ * @brief zone_of UTM zone number of a longitude, as in deg2utm.m
+ * @param lon Longitude (degrees)
+ * @return Zone number
+ */
+inline int zone_of(double lon) {
+	return static_cast<int>((lon/6)+31);
+}
+
+#if UTM_HAVE_AVX2
+namespace avx2 {
+/** @brief v4 Four doubles */
+typedef __m256d v4;
+
+UTM_AVX2 inline v4 set(double a) { return _mm256_set1_pd(a); }
+UTM_AVX2 inline v4 select(v4 mask, v4 a, v4 b) { return _mm256_blendv_pd(b,a,mask); }
+
+/**
+ * @brief poly Horner evaluation c[0]*x^(N-1)+...+c[N-1]
+ * @param x Argument
+ * @param c Coefficients, highest degree first
+ * @return Polynomial value
+ */
+template<int N>
+UTM_AVX2 inline v4 poly(v4 x, const double (&c)[N]) {
+	v4 y = set(c[0]);
+	for(int i=1; i<N; ++i)
+		y = _mm256_fmadd_pd(y,x,set(c[i]));
+	return y;
+}
+
+/**
+ * @brief sincos sin and cos (Cephes sin.c polynomials, |x| < 1e6)
+ * @param x Argument (rad)
+ * @param s sin(x)
+ * @param c cos(x)
+ */
+UTM_AVX2 inline void sincos(v4 x, v4 &s, v4 &c) {
+	static const double sincof[] = {
+		1.58962301576546568060E-10, -2.50507477628578072866E-8,
+		2.75573136213857245213E-6, -1.98412698295895385996E-4,
+		8.33333333332211858878E-3, -1.66666666666666307295E-1 };
+	static const double coscof[] = {
+		-1.13585365213876817300E-11, 2.08757008419747316778E-9,
+		-2.75573141792967388112E-7, 2.48015872888517045348E-5,
+		-1.38888888888730564116E-3, 4.16666666666665929218E-2 };
+	//Reduce to r in [-pi/4;pi/4], x = q*pi/2 + r
+	v4 q = _mm256_round_pd(_mm256_mul_pd(x,set(2/M_PI)),_MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+	v4 r = _mm256_fnmadd_pd(q,set(1.57079625129699707031E0),x);
+	r = _mm256_fnmadd_pd(q,set(7.54978941586159635335E-8),r);
+	r = _mm256_fnmadd_pd(q,set(5.39030285815811905290E-15),r);
+	v4 zz = _mm256_mul_pd(r,r);
+	v4 sr = _mm256_fmadd_pd(_mm256_mul_pd(r,zz),poly(zz,sincof),r);
+	v4 cr = _mm256_fmadd_pd(_mm256_mul_pd(zz,zz),poly(zz,coscof),
+							_mm256_fnmadd_pd(set(0.5),zz,set(1.0)));
+	__m256i qi = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(q));
+	v4 odd = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(qi,_mm256_set1_epi64x(1)),
+													_mm256_set1_epi64x(1)));
+	v4 sneg = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(qi,_mm256_set1_epi64x(2)),62));
+	v4 cneg = _mm256_castsi256_pd(_mm256_slli_epi64(
+		_mm256_and_si256(_mm256_add_epi64(qi,_mm256_set1_epi64x(1)),_mm256_set1_epi64x(2)),62));
+	s = _mm256_xor_pd(select(odd,cr,sr),sneg);
+	c = _mm256_xor_pd(select(odd,sr,cr),cneg);
+}
+
+/**
+ * @brief atan arctangent (Cephes atan.c)
+ * @param x Argument
+ * @return atan(x)
+ */
+UTM_AVX2 inline v4 atan(v4 x) {
+	static const double P[] = {
+		-8.750608600031904122785E-1, -1.615753718733365076637E1,
+		-7.500855792314704667340E1, -1.228866684490136173410E2,
+		-6.485021904942025371773E1 };
+	static const double Q[] = { 1.0,
+		2.485846490142306297962E1, 1.650270098316988542046E2,
+		4.328810604912902668951E2, 4.853903996359136964868E2,
+		1.945506571482613964425E2 };
+	const v4 signbit = set(-0.0);
+	v4 sign = _mm256_and_pd(x,signbit);
+	v4 ax = _mm256_andnot_pd(signbit,x);
+	v4 big = _mm256_cmp_pd(ax,set(2.41421356237309504880),_CMP_GT_OQ);
+	v4 mid = _mm256_andnot_pd(big,_mm256_cmp_pd(ax,set(0.66),_CMP_GT_OQ));
+	v4 xr = select(big,_mm256_div_pd(set(-1.0),ax),
+				   select(mid,_mm256_div_pd(_mm256_sub_pd(ax,set(1.0)),_mm256_add_pd(ax,set(1.0))),ax));
+	v4 y0 = select(big,set(M_PI_2),select(mid,set(M_PI_4),_mm256_setzero_pd()));
+	v4 more = select(big,set(6.123233995736765886130E-17),
+					 select(mid,set(0.5*6.123233995736765886130E-17),_mm256_setzero_pd()));
+	v4 z = _mm256_mul_pd(xr,xr);
+	z = _mm256_div_pd(_mm256_mul_pd(z,poly(z,P)),poly(z,Q));
+	z = _mm256_add_pd(_mm256_fmadd_pd(xr,z,xr),more);
+	return _mm256_or_pd(_mm256_add_pd(y0,z),sign);
+}
+
+/**
+ * @brief log natural logarithm (Cephes log.c, x > 0)
+ * @param x Argument
+ * @return log(x)
+ */
+UTM_AVX2 inline v4 log(v4 x) {
+	static const double P[] = {
+		1.01875663804580931796E-4, 4.97494994976747001425E-1,
+		4.70579119878881725854E0, 1.44989225341610930846E1,
+		1.79368678507819816313E1, 7.70838733755885391666E0 };
+	static const double Q[] = { 1.0,
+		1.12873587189167450590E1, 4.52279145837532221105E1,
+		8.29875266912776603211E1, 7.11544750618563894466E1,
+		2.31251620126765340583E1 };
+	//frexp: x = m*2^e, m in [0.5;1)
+	__m256i bits = _mm256_castpd_si256(x);
+	__m256i ebits = _mm256_srli_epi64(bits,52);
+	__m128i e32 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(ebits,_mm256_setr_epi32(0,2,4,6,0,2,4,6)));
+	v4 e = _mm256_sub_pd(_mm256_cvtepi32_pd(e32),set(1022));
+	v4 m = _mm256_castsi256_pd(_mm256_or_si256(
+		_mm256_and_si256(bits,_mm256_set1_epi64x(0x800fffffffffffffLL)),
+		_mm256_set1_epi64x(0x3fe0000000000000LL)));
+	v4 small = _mm256_cmp_pd(m,set(M_SQRT1_2),_CMP_LT_OQ);
+	e = _mm256_sub_pd(e,_mm256_and_pd(small,set(1.0)));
+	m = _mm256_sub_pd(_mm256_add_pd(m,_mm256_and_pd(small,m)),set(1.0));
+	v4 z = _mm256_mul_pd(m,m);
+	v4 y = _mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(m,z),poly(m,P)),poly(m,Q));
+	y = _mm256_fnmadd_pd(e,set(2.121944400546905827679e-4),y);
+	y = _mm256_fnmadd_pd(set(0.5),z,y);
+	return _mm256_fmadd_pd(e,set(0.693359375),_mm256_add_pd(m,y));
+}
+
+/**
+ * @brief exp exponential function (Cephes exp.c, |x| < 700)
+ * @param x Argument
+ * @return exp(x)
+ */
+UTM_AVX2 inline v4 exp(v4 x) {
+	static const double P[] = {
+		1.26177193074810590878E-4, 3.02994407707441961300E-2,
+		9.99999999999999999910E-1 };
+	static const double Q[] = {
+		3.00198505138664455042E-6, 2.52448340349684104192E-3,
+		2.27265548208155028766E-1, 2.00000000000000000009E0 };
+	v4 n = _mm256_round_pd(_mm256_mul_pd(x,set(M_LOG2E)),_MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+	x = _mm256_fnmadd_pd(n,set(6.93145751953125E-1),x);
+	x = _mm256_fnmadd_pd(n,set(1.42860682030941723212E-6),x);
+	v4 xx = _mm256_mul_pd(x,x);
+	v4 px = _mm256_mul_pd(x,poly(xx,P));
+	x = _mm256_div_pd(px,_mm256_sub_pd(poly(xx,Q),px));
+	x = _mm256_fmadd_pd(set(2.0),x,set(1.0));
+	__m256i ni = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+	v4 scale = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(ni,_mm256_set1_epi64x(1023)),52));
+	return _mm256_mul_pd(x,scale);
+}
+
+/**
+ * @brief meridian_arc Bm, see UTM::meridian_arc
+ * @param lat Latitude (rad)
+ * @param sinlat sin(lat)
+ * @param coslat cos(lat)
+ * @param cos2lat cos(lat)^2
+ * @return Scaled meridian arc length
+ */
+UTM_AVX2 inline v4 meridian_arc(v4 lat, v4 sinlat, v4 coslat, v4 cos2lat) {
+	const double alfa = (3.0/4.0)*e2cuadrada;
+	const double beta = (5.0/3.0)*alfa*alfa;
+	const double gama = (35.0/27.0)*alfa*alfa*alfa;
+	v4 a1 = _mm256_mul_pd(set(2.0),_mm256_mul_pd(sinlat,coslat)); //sin(2*lat)
+	v4 a2 = _mm256_mul_pd(a1,cos2lat);
+	v4 j2 = _mm256_fmadd_pd(a1,set(0.5),lat);
+	v4 j4 = _mm256_mul_pd(_mm256_fmadd_pd(set(3.0),j2,a2),set(0.25));
+	v4 j6 = _mm256_div_pd(_mm256_fmadd_pd(set(5.0),j4,_mm256_mul_pd(a2,cos2lat)),set(3.0));
+	v4 s = _mm256_fnmadd_pd(set(alfa),j2,lat);
+	s = _mm256_fmadd_pd(set(beta),j4,s);
+	s = _mm256_fnmadd_pd(set(gama),j6,s);
+	return _mm256_mul_pd(set(0.9996*c),s);
+}
+
+/**
+ * @brief deg2utm 4 points, see UTM::deg2utm
+ * @param Lat Latitudes (degrees)
+ * @param Lon Longitudes (degrees)
+ * @param zone Zone numbers
+ * @param x Eastings
+ * @param y Northings
+ */
+UTM_AVX2 inline void deg2utm(v4 Lat, v4 Lon, v4 zone, v4 &x, v4 &y) {
+	v4 lat = _mm256_mul_pd(Lat,set(M_PI/180));
+	v4 lon = _mm256_mul_pd(Lon,set(M_PI/180));
+	v4 S = _mm256_fmsub_pd(zone,set(6.0),set(183.0));
+	v4 deltaS = _mm256_fnmadd_pd(S,set(M_PI/180),lon);
+	v4 sinlat, coslat, sindS, cosdS;
+	sincos(lat,sinlat,coslat);
+	sincos(deltaS,sindS,cosdS);
+	v4 cos2lat = _mm256_mul_pd(coslat,coslat);
+	v4 a = _mm256_mul_pd(coslat,sindS);
+	v4 epsilon = _mm256_mul_pd(set(0.5),log(_mm256_div_pd(_mm256_add_pd(set(1.0),a),_mm256_sub_pd(set(1.0),a))));
+	v4 nu = _mm256_sub_pd(atan(_mm256_div_pd(sinlat,_mm256_mul_pd(coslat,cosdS))),lat);
+	v4 v = _mm256_mul_pd(_mm256_div_pd(set(c),_mm256_sqrt_pd(_mm256_fmadd_pd(set(e2cuadrada),cos2lat,set(1.0)))),
+						 set(0.9996));
+	v4 ta = _mm256_mul_pd(_mm256_mul_pd(set(e2cuadrada/2),_mm256_mul_pd(epsilon,epsilon)),cos2lat);
+	v4 Bm = meridian_arc(lat,sinlat,coslat,cos2lat);
+	x = _mm256_fmadd_pd(_mm256_mul_pd(epsilon,v),_mm256_fmadd_pd(ta,set(1.0/3.0),set(1.0)),set(500000));
+	y = _mm256_fmadd_pd(_mm256_mul_pd(nu,v),_mm256_add_pd(set(1.0),ta),Bm);
+	y = select(_mm256_cmp_pd(y,_mm256_setzero_pd(),_CMP_LT_OQ),_mm256_add_pd(y,set(9999999)),y);
+}
+
+/**
+ * @brief utm2deg 4 points, see UTM::utm2deg
+ * @param xx Eastings
+ * @param Y Northings (minus 10000000 on the southern hemisphere)
+ * @param S Central meridian (degrees)
+ * @param Lat Latitudes (degrees)
+ * @param Lon Longitudes (degrees)
+ */
+UTM_AVX2 inline void utm2deg(v4 xx, v4 Y, v4 S, v4 &Lat, v4 &Lon) {
+	v4 X = _mm256_sub_pd(xx,set(500000));
+	v4 lat = _mm256_div_pd(Y,set(6366197.724*0.9996));
+	v4 sinlat, coslat;
+	sincos(lat,sinlat,coslat);
+	v4 cos2lat = _mm256_mul_pd(coslat,coslat);
+	v4 v = _mm256_mul_pd(_mm256_div_pd(set(c),_mm256_sqrt_pd(_mm256_fmadd_pd(set(e2cuadrada),cos2lat,set(1.0)))),
+						 set(0.9996));
+	v4 a = _mm256_div_pd(X,v);
+	v4 Bm = meridian_arc(lat,sinlat,coslat,cos2lat);
+	v4 b = _mm256_div_pd(_mm256_sub_pd(Y,Bm),v);
+	v4 Epsi = _mm256_mul_pd(_mm256_mul_pd(set(e2cuadrada/2),_mm256_mul_pd(a,a)),cos2lat);
+	v4 Eps = _mm256_mul_pd(a,_mm256_fnmadd_pd(Epsi,set(1.0/3.0),set(1.0)));
+	v4 nab = _mm256_fmadd_pd(b,_mm256_sub_pd(set(1.0),Epsi),lat);
+	v4 expE = exp(Eps);
+	v4 senoheps = _mm256_mul_pd(_mm256_sub_pd(expE,_mm256_div_pd(set(1.0),expE)),set(0.5));
+	v4 sinnab, cosnab;
+	sincos(nab,sinnab,cosnab);
+	v4 Delt = atan(_mm256_div_pd(senoheps,cosnab));
+	v4 sinD, cosD;
+	sincos(Delt,sinD,cosD);
+	v4 TaO = atan(_mm256_div_pd(_mm256_mul_pd(cosD,sinnab),cosnab));
+	Lon = _mm256_fmadd_pd(Delt,set(180/M_PI),S);
+	v4 d = _mm256_sub_pd(TaO,lat);
+	v4 k = _mm256_mul_pd(_mm256_mul_pd(set(1.5*e2cuadrada),_mm256_mul_pd(sinlat,coslat)),d);
+	v4 f = _mm256_sub_pd(_mm256_fmadd_pd(set(e2cuadrada),cos2lat,set(1.0)),k);
+	Lat = _mm256_mul_pd(_mm256_fmadd_pd(f,d,lat),set(180/M_PI));
+}
+
+/**
+ * @brief deg2utm_batch Array version, n a multiple of 4
+ */
+UTM_AVX2 inline void deg2utm_batch(const double *lat, const double *lon, size_t n,
+								   double *x, double *y, int zone) {
+	for(size_t i=0; i<n; i+=4) {
+		v4 Lon = _mm256_loadu_pd(lon+i);
+		v4 z = zone>0?set(zone):_mm256_round_pd(_mm256_add_pd(_mm256_div_pd(Lon,set(6)),set(31)),
+												_MM_FROUND_TO_ZERO|_MM_FROUND_NO_EXC);
+		v4 vx, vy;
+		deg2utm(_mm256_loadu_pd(lat+i),Lon,z,vx,vy);
+		_mm256_storeu_pd(x+i,vx);
+		_mm256_storeu_pd(y+i,vy);
+	}
+}
+
+/**
+ * @brief utm2deg_batch Array version, n a multiple of 4
+ */
+UTM_AVX2 inline void utm2deg_batch(const double *x, const double *y, size_t n,
+								   int zone, bool north, double *lat, double *lon) {
+	v4 S = set(zone*6-183);
+	v4 dy = set(north?0:-10000000.0);
+	for(size_t i=0; i<n; i+=4) {
+		v4 vlat, vlon;
+		utm2deg(_mm256_loadu_pd(x+i),_mm256_add_pd(_mm256_loadu_pd(y+i),dy),S,vlat,vlon);
+		_mm256_storeu_pd(lat+i,vlat);
+		_mm256_storeu_pd(lon+i,vlon);
+	}
+}
+} //namespace avx2
+
+/**
+ * @brief have_avx2 Can the AVX2 kernels run on this CPU?
+ * @return true if AVX2 and FMA are supported
+ */
+inline bool have_avx2() {
+	static const bool ok = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	return ok;
+}
+#else
+inline bool have_avx2() { return false; }
+#endif
+
+/**
+ * @brief deg2utm_batch Converts arrays of lat/lon to UTM
+ * @param lat Latitudes (degrees)
+ * @param lon Longitudes (degrees)
+ * @param n Number of points
+ * @param x Eastings (output)
+ * @param y Northings (output)
+ * @param zone Zone to use for all points, or 0 for the zone of each point (like deg2utm.m)
+ * @param simd Use the AVX2 kernel if the CPU supports it
+ */
+inline void deg2utm_batch(const double *lat, const double *lon, size_t n,
+						  double *x, double *y, int zone=0, bool simd=true) {
+	size_t done = 0;
+#if UTM_HAVE_AVX2
+	if(simd && have_avx2()) {
+		done = n&~size_t(3);
+		avx2::deg2utm_batch(lat,lon,done,x,y,zone);
+	}
+#endif
+	for(size_t i=done; i<n; ++i) {
+		utmcoord u = deg2utm(lat[i],lon[i],zone);
+		x[i] = u.x;
+		y[i] = u.y;
+	}
+	(void)simd;
+}
+
+/**
+ * @brief utm2deg_batch Converts arrays of UTM coordinates in one zone to lat/lon
+ * @param x Eastings
+ * @param y Northings
+ * @param n Number of points
+ * @param zone Zone number
+ * @param north Northern hemisphere?
+ * @param lat Latitudes (output, degrees)
+ * @param lon Longitudes (output, degrees)
+ * @param simd Use the AVX2 kernel if the CPU supports it
+ */
+inline void utm2deg_batch(const double *x, const double *y, size_t n, int zone, bool north,
+						  double *lat, double *lon, bool simd=true) {
+	size_t done = 0;
+#if UTM_HAVE_AVX2
+	if(simd && have_avx2()) {
+		done = n&~size_t(3);
+		avx2::utm2deg_batch(x,y,done,zone,north,lat,lon);
+	}
+#endif
+	utmcoord u;
+	u.zone = zone;
+	u.letter = north?'N':'M';
+	for(size_t i=done; i<n; ++i) {
+		u.x = x[i];
+		u.y = y[i];
+		MAVLink::coordinate c = utm2deg(u);
+		lat[i] = c.get_lat();
+		lon[i] = c.get_lon();
+	}
+	(void)simd;
+}
+
+/**
+ * @brief deg2utm Converts coordinates to UTM
+ * @param coords Coordinates
+ * @param zone Zone to use for all points, or 0 for the zone of each point
+ * @return UTM coordinates (band letters from the latitudes)
+ */
+inline vector<utmcoord> deg2utm(const MAVLink::VecCoord &coords, int zone=0) {
+	size_t n = coords.size();
+	vector<double> lat(n), lon(n), x(n), y(n);
+	for(size_t i=0; i<n; ++i) {
+		lat[i] = coords[i].get_lat();
+		lon[i] = coords[i].get_lon();
+	}
+	deg2utm_batch(lat.data(),lon.data(),n,x.data(),y.data(),zone);
+	vector<utmcoord> result(n);
+	for(size_t i=0; i<n; ++i) {
+		result[i].x = x[i];
+		result[i].y = y[i];
+		result[i].zone = zone>0?zone:zone_of(lon[i]);
+		result[i].letter = band_letter(lat[i]);
+	}
+	return result;
+}
+
+/**
+ * @brief utm2deg Converts UTM coordinates in one zone to coordinates
+ * @param x Eastings
+ * @param y Northings
+ * @param zone Zone number
+ * @param north Northern hemisphere?
+ * @param alt Altitude of all coordinates
+ * @return Coordinates
+ */
+inline MAVLink::VecCoord utm2deg(const vector<double> &x, const vector<double> &y,
+								 int zone, bool north, double alt=0) {
+	size_t n = x.size();
+	vector<double> lat(n), lon(n);
+	utm2deg_batch(x.data(),y.data(),n,zone,north,lat.data(),lon.data());
+	MAVLink::VecCoord result;
+	result.reserve(n);
+	for(size_t i=0; i<n; ++i)
+		result.emplace_back(lat[i],lon[i],alt);
+	return result;
+}
+} //namespace UTM
@@ -225,7 +225,7 @@ struct autopath : public vector<waypoint> {
 	 * @return out
 	 */
 	friend ostream& operator<<(ostream &out, const autopath &ap) {
-		for(auto wp:ap)
+		for(const auto &wp:ap)
 			//out << wp << endl;
 			out << wp << "\r\n"; //Apparantly, line ending format is extremely important.
 		return out;
@@ -326,9 +326,10 @@ public:
 		if(!csv.is_open())
 			throw(file_error(csvfile,true));
 		string line;
-		while(!csv.eof()) {
-			getline(csv,line);
-			vector<string> tokens = tokenize(line,",");
+		while(getline(csv,line)) {
+			vector<string> tokens = tokenize(line,", \r\t");
+			if(tokens.empty()) //blank line, eg. a trailing newline
+				continue;
 			result.emplace_back(
 						stod(tokens.at(0)),
 						stod(tokens.at(1)),
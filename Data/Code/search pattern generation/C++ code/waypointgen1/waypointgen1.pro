@@ -2,7 +2,8 @@ TEMPLATE = app
 CONFIG += console
 CONFIG -= app_bundle
 CONFIG -= qt
-CONFIG += c++11
+CONFIG += c++17
+CONFIG += thread
 
 SOURCES += main.cpp
 
@@ -10,5 +11,17 @@ include(deployment.pri)
 qtcAddDeployment()
 
 HEADERS += \
-    waypointgen.h
+    waypointgen.h \
+    mappedfile.h \
+    coordstream.h \
+    wplwriter.h \
+    batch.h \
+    parallel.h \
+    utm.h \
+    localframe.h \
+    pathsimplify.h \
+    coverage.h \
+    soapath.h \
+    utmbatch.h \
+    missioncheck.h
 
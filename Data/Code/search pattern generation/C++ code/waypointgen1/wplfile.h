@@ -0,0 +1,400 @@
+/**
+ * @file wplfile.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "waypointgen.h"
+#include "coordstream.h"
+#include "mappedfile.h"
+#include "wplwriter.h"
+
+#if defined(_WIN32)
+#include <filesystem>
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+  * Incremental QGC WPL 110 mission file.
+  *
+  * autopath::save and Wplwriter::save rewrite the whole file, and the
+  * waypoint indices are the ones given to the autopath ctor. A Wplfile is
+  * an open mission file that is updated in place:
+  * - append() writes only the new lines at the end of the file, indexed by
+  *   their position, so they always continue the indices in the file;
+  * - patch() overwrites one waypoint. Files written by Wplfile::save use
+  *   fixed-width records (each line padded with spaces before the CRLF to
+  *   record_width bytes; readers that trim the fields ignore them, and
+  *   unpad() gives the plain file back), so waypoint i is at a known offset
+  *   and is overwritten without moving the rest. In a file with plain lines
+  *   (autopath::save), or when the waypoint does not fit a record, the file
+  *   is rewritten instead.
+  *
+  * Crash safety: every rewrite goes to "<filename>.tmp", is flushed to disk
+  * and renamed over the file, so the file is always either the old or the new
+  * mission. In-place updates only ever add whole lines at the end or replace
+  * one record by another of the same size; a line cut short by a crash during
+  * append() is removed when the file is opened again. With durable set (the
+  * default) every update is flushed to disk (fdatasync) before returning.
+  *
+  * Wplfile f("mission.txt");
+  * f.save(Patterngen::spiral(start,end,30));
+  * f.append(waypoint(0,0,0,19,60,0,0,0,lat,lon,alt)); //index becomes f.size()-1
+  */
+
+/**
+ * @brief The Wplfile class An open waypoint file, updated in place
+ */
+class Wplfile {
+public:
+	/** @brief record_width Bytes per line in fixed-width files, CRLF included */
+	static constexpr size_t record_width = 192;
+
+	/**
+	 * @brief Wplfile ctor Opens a waypoint file, or creates an empty mission
+	 * @param filename Waypoint file (.txt)
+	 * @param durable Flush every update to disk before returning
+	 */
+	explicit Wplfile(const string &filename, bool durable=true)
+		:filename(filename),durable(durable)
+	{
+		if(!exists(filename)) {
+			rewrite(string(Wplwriter::header));
+			return;
+		}
+		mapped_file m(filename);
+		string_view text = m.view();
+		size_t header = Wplwriter::header.size();
+		if(text.substr(0,header)!=Wplwriter::header)
+			throw(parse_error(filename,0,"\"QGC WPL 110\" and CRLF"));
+		//A crash during append() can leave a partial last line: drop it.
+		size_t end = text.rfind('\n');
+		end = end==string_view::npos || end<header?header:end+1;
+		count = 0;
+		fixed = (end-header)%record_width==0;
+		for(size_t p=header; p<end; ) {
+			size_t eol = text.find('\n',p)+1;
+			fixed = fixed && eol-p==record_width;
+			p = eol;
+			++count;
+		}
+		bytes = end;
+		if(end!=text.size())
+			truncate_to(end);
+	}
+
+	/**
+	 * @brief save Replaces the mission (atomic). Fixed-width records,
+	 * or plain lines if a waypoint does not fit a record.
+	 * @param wps Waypoints, indexed by position
+	 */
+	void save(const VecWP &wps) {
+		string buf;
+		fixed = format_records(wps,0,buf);
+		if(fixed)
+			buf.insert(0,Wplwriter::header);
+		else
+			Wplwriter::format_rows(wps.size(),buf,[&](char *&p, size_t i) { format_indexed(p,wps[i],i); });
+		rewrite(buf);
+		count = wps.size();
+	}
+
+	/**
+	 * @brief append Appends waypoints at the end of the file
+	 * @param wps Waypoints, indexed from size()
+	 */
+	void append(const VecWP &wps) {
+		string buf;
+		if(!fixed || !format_records(wps,count,buf)) {
+			buf.clear();
+			Wplwriter::format_rows(wps.size(),buf,[&](char *&p, size_t i) { format_indexed(p,wps[i],count+i); });
+			buf.erase(0,Wplwriter::header.size());
+			fixed = fixed && buf.empty();
+		}
+		write_at(bytes,buf);
+		bytes += buf.size();
+		count += wps.size();
+	}
+
+	/**
+	 * @brief append Appends a waypoint at the end of the file
+	 * @param w Waypoint, indexed size()
+	 */
+	void append(const waypoint &w) {
+		append(VecWP{w});
+	}
+
+	/**
+	 * @brief patch Replaces waypoint i
+	 * @param i Index (< size())
+	 * @param w Waypoint, indexed i
+	 */
+	void patch(size_t i, const waypoint &w) {
+		if(i>=count)
+			throw(out_of_range("Waypoint "+to_string(i)+" is not in \""+filename+"\"."));
+		char line[Wplwriter::max_line];
+		char *p = line;
+		format_indexed(p,w,i);
+		size_t len = p-line;
+		if(fixed && len<=record_width) {
+			write_at(Wplwriter::header.size()+i*record_width,pad(line,len));
+			return;
+		}
+		//Plain lines: splice the new line in and rewrite the file.
+		string text;
+		{
+			mapped_file m(filename);
+			text = string(m.view().substr(0,bytes));
+		}
+		size_t b = Wplwriter::header.size();
+		for(size_t k=0; k<i; ++k)
+			b = text.find('\n',b)+1;
+		size_t e = text.find('\n',b)+1;
+		if(fixed) //the waypoint does not fit its record: drop the padding everywhere
+			text = unpad(text.replace(b,e-b,string(line,len)));
+		else
+			text.replace(b,e-b,string(line,len));
+		rewrite(text);
+		fixed = false;
+	}
+
+	/**
+	 * @brief size
+	 * @return Number of waypoints in the file
+	 */
+	size_t size() const { return count; }
+	/**
+	 * @brief fixed_width
+	 * @return Are all lines record_width long (patch() in place)?
+	 */
+	bool fixed_width() const { return fixed; }
+
+	/**
+	 * @brief unpad Removes the record padding of a fixed-width file
+	 * @param text File contents
+	 * @return The same file with plain lines, as Wplwriter writes it
+	 */
+	static string unpad(string_view text) {
+		string out;
+		out.reserve(text.size());
+		for(size_t p=0; p<text.size(); ) {
+			size_t eol = text.find('\n',p);
+			eol = eol==string_view::npos?text.size():eol+1;
+			size_t e = eol;
+			if(e-p>=2 && text[e-2]=='\r')
+				e -= 2;
+			size_t s = e;
+			while(s>p && text[s-1]==' ')
+				--s;
+			out.append(text.substr(p,s-p)).append(text.substr(e,eol-e));
+			p = eol;
+		}
+		return out;
+	}
+
+private:
+	/** @brief filename Waypoint file */
+	string filename;
+	/** @brief durable Flush every update to disk */
+	bool durable;
+	/** @brief count Number of waypoints in the file */
+	size_t count = 0;
+	/** @brief bytes File size */
+	size_t bytes = 0;
+	/** @brief fixed All lines are record_width long */
+	bool fixed = true;
+
+	/**
+	 * @brief format_indexed Formats a waypoint line with another index
+	 * @param p Output position with room for max_line characters, advanced
+	 * @param w Waypoint
+	 * @param index Index written
+	 */
+	static void format_indexed(char *&p, const waypoint &w, size_t index) {
+		if(w.index==index)
+			return Wplwriter::format_waypoint(p,w);
+		waypoint c(w);
+		c.index = index;
+		Wplwriter::format_waypoint(p,c);
+	}
+
+	/**
+	 * @brief pad Pads a line with spaces before its CRLF to record_width
+	 * @param line Line (with CRLF)
+	 * @param len Length of line (<= record_width)
+	 * @return Record
+	 */
+	static string pad(const char *line, size_t len) {
+		string r(line,len-2);
+		r.append(record_width-len,' ').append("\r\n");
+		return r;
+	}
+
+	/**
+	 * @brief format_records Formats waypoints as fixed-width records
+	 * @param wps Waypoints
+	 * @param first Index of the first one
+	 * @param buf Output, replaced
+	 * @return false if a waypoint does not fit a record
+	 */
+	static bool format_records(const VecWP &wps, size_t first, string &buf) {
+		buf.assign(wps.size()*record_width,' ');
+		char line[Wplwriter::max_line];
+		for(size_t i=0; i<wps.size(); ++i) {
+			char *p = line;
+			format_indexed(p,wps[i],first+i);
+			size_t len = p-line;
+			if(len>record_width)
+				return false;
+			char *r = &buf[i*record_width];
+			memcpy(r,line,len-2);
+			r[record_width-2] = '\r';
+			r[record_width-1] = '\n';
+		}
+		return true;
+	}
+
+	/**
+	 * @brief exists
+	 * @param filename Filename
+	 * @return Does the file exist?
+	 */
+	static bool exists(const string &filename) {
+		FILE *f = fopen(filename.c_str(),"rb");
+		if(f)
+			fclose(f);
+		return f!=nullptr;
+	}
+
+#if defined(_WIN32)
+	/**
+	 * @brief rewrite Replaces the file atomically (temporary file and rename)
+	 * @param text File contents
+	 */
+	void rewrite(string_view text) {
+		string tmp = filename+".tmp";
+		{
+			ofstream f(tmp,ios::binary|ios::trunc);
+			if(!f.is_open() || !f.write(text.data(),text.size()) || !f.flush())
+				throw(file_error(tmp,false));
+		}
+		error_code ec;
+		filesystem::rename(tmp,filename,ec); //MoveFileEx with MOVEFILE_REPLACE_EXISTING
+		if(ec)
+			throw(file_error(filename,false));
+		bytes = text.size();
+	}
+
+	/**
+	 * @brief write_at Writes data at an offset of the file
+	 * @param offset Byte offset (bytes for an append)
+	 * @param data Data
+	 */
+	void write_at(size_t offset, string_view data) {
+		fstream f(filename,ios::binary|ios::in|ios::out);
+		if(!f.is_open())
+			throw(file_error(filename,true));
+		f.seekp(offset,ios::beg);
+		if(!f.write(data.data(),data.size()) || !f.flush())
+			throw(file_error(filename,false));
+	}
+
+	/**
+	 * @brief truncate_to Cuts the file (a partial last line)
+	 * @param size New size
+	 */
+	void truncate_to(size_t size) {
+		error_code ec;
+		filesystem::resize_file(filename,size,ec);
+		if(ec)
+			throw(file_error(filename,false));
+	}
+#else
+	/**
+	 * @brief write_all Writes data at an offset, retrying short writes
+	 * @param fd File descriptor
+	 * @param offset Byte offset
+	 * @param data Data
+	 * @return false on error
+	 */
+	static bool write_all(int fd, off_t offset, string_view data) {
+		const char *p = data.data();
+		size_t left = data.size();
+		while(left>0) {
+			ssize_t n = pwrite(fd,p,left,offset);
+			if(n<0) {
+				if(errno==EINTR)
+					continue;
+				return false;
+			}
+			p += n;
+			left -= static_cast<size_t>(n);
+			offset += n;
+		}
+		return true;
+	}
+
+	/**
+	 * @brief rewrite Replaces the file atomically (temporary file, fsync and rename)
+	 * @param text File contents
+	 */
+	void rewrite(string_view text) {
+		string tmp = filename+".tmp";
+		int fd = open(tmp.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0666);
+		if(fd<0)
+			throw(file_error(tmp,false));
+		if(!write_all(fd,0,text) || (durable && fsync(fd)!=0)) {
+			close(fd);
+			unlink(tmp.c_str());
+			throw(file_error(tmp,false));
+		}
+		if(close(fd)!=0 || ::rename(tmp.c_str(),filename.c_str())!=0) {
+			unlink(tmp.c_str());
+			throw(file_error(filename,false));
+		}
+		if(durable) { //make the rename itself durable
+			size_t slash = filename.find_last_of('/');
+			string dir = slash==string::npos?".":filename.substr(0,slash+1);
+			int d = open(dir.c_str(),O_RDONLY);
+			if(d>=0) {
+				fsync(d);
+				close(d);
+			}
+		}
+		bytes = text.size();
+	}
+
+	/**
+	 * @brief write_at Writes data at an offset of the file
+	 * @param offset Byte offset (bytes for an append)
+	 * @param data Data
+	 */
+	void write_at(size_t offset, string_view data) {
+		int fd = open(filename.c_str(),O_WRONLY);
+		if(fd<0)
+			throw(file_error(filename,true));
+		bool ok = write_all(fd,static_cast<off_t>(offset),data);
+		ok = ok && (!durable || fdatasync(fd)==0);
+		if(close(fd)!=0 || !ok)
+			throw(file_error(filename,false));
+	}
+
+	/**
+	 * @brief truncate_to Cuts the file (a partial last line)
+	 * @param size New size
+	 */
+	void truncate_to(size_t size) {
+		if(::truncate(filename.c_str(),static_cast<off_t>(size))!=0)
+			throw(file_error(filename,false));
+	}
+#endif
+};
@@ -0,0 +1,168 @@
+/**
+ * @file wplwriter.h
+ * @author Mikael Westermann
+ */
+#pragma once
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "waypointgen.h"
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+  * Buffered QGC WPL 110 writer.
+  *
+  * Produces exactly the bytes that autopath::save writes on POSIX systems
+  * (fixed notation with 14 decimals, tab separated, CRLF line endings),
+  * but formats the whole file into one buffer with to_chars (locale
+  * independent) and writes it with a single call.
+  * Unlike an ofstream in text mode on Windows, no extra '\r' is added there.
+  */
+
+/**
+ * @brief The Wplwriter class Waypoint file serialization function wrapper
+ */
+class Wplwriter {
+public:
+	/** @brief header First line of a waypoint file */
+	static constexpr string_view header = "QGC WPL 110\r\n";
+	/** @brief max_fixed Longest fixed double: sign, 309 integer digits, point, 14 decimals */
+	static constexpr size_t max_fixed = 1+309+1+14;
+	/** @brief max_line Longest possible waypoint line (5 size_t, 7 fixed doubles) */
+	static constexpr size_t max_line = 5*21+7*(max_fixed+1)+2;
+	/** @brief typical_line Typical waypoint line length, used to size the buffer */
+	static constexpr size_t typical_line = 160;
+
+	/**
+	 * @brief put_uint Formats an unsigned integer
+	 * @param p Output position, advanced
+	 * @param v Value
+	 */
+	static void put_uint(char *&p, size_t v) {
+		p = to_chars(p,p+21,v).ptr;
+	}
+
+	/**
+	 * @brief put_fixed Formats a double like fixed << setprecision(14)
+	 * @param p Output position with room for max_fixed characters, advanced
+	 * @param v Value
+	 */
+	static void put_fixed(char *&p, double v) {
+		p = to_chars(p,p+max_fixed,v,chars_format::fixed,14).ptr;
+	}
+
+	/**
+	 * @brief format_waypoint Formats one waypoint line (with CRLF)
+	 * @param p Output position with room for max_line characters, advanced
+	 * @param w Waypoint
+	 */
+	static void format_waypoint(char *&p, const waypoint &w) {
+		const command &c = w.my_cmd;
+		put_uint(p,w.index); *p++ = '\t';
+		put_uint(p,w.current_wp); *p++ = '\t';
+		put_uint(p,w.coord_frame); *p++ = '\t';
+		put_uint(p,c.cmd); *p++ = '\t';
+		put_fixed(p,c.p1); *p++ = '\t';
+		put_fixed(p,c.p2); *p++ = '\t';
+		put_fixed(p,c.p3); *p++ = '\t';
+		put_fixed(p,c.p4); *p++ = '\t';
+		put_fixed(p,c.coord.get_lat()); *p++ = '\t';
+		put_fixed(p,c.coord.get_lon()); *p++ = '\t';
+		put_fixed(p,c.coord.get_alt()); *p++ = '\t';
+		put_uint(p,w.autocontinue);
+		*p++ = '\r'; *p++ = '\n';
+	}
+
+	/**
+	 * @brief format_rows Formats a waypoint file of n lines into buf
+	 * @param n Number of waypoints
+	 * @param buf Buffer, replaced by the file contents
+	 * @param row row(p,i) formats waypoint i at p (at most max_line characters)
+	 */
+	template<class Row>
+	static void format_rows(size_t n, string &buf, Row row) {
+		buf.resize(header.size()+n*typical_line+max_line);
+		memcpy(&buf[0],header.data(),header.size());
+		size_t pos = header.size();
+		for(size_t i=0; i<n; ++i) {
+			if(buf.size()-pos<max_line)
+				buf.resize(max(2*buf.size(),pos+max_line));
+			char *p = &buf[pos];
+			row(p,i);
+			pos = p-&buf[0];
+		}
+		buf.resize(pos);
+	}
+
+	/**
+	 * @brief format Formats a waypoint file into buf
+	 * @param wps Waypoints
+	 * @param buf Buffer, replaced by the file contents
+	 */
+	static void format(const VecWP &wps, string &buf) {
+		format_rows(wps.size(),buf,[&wps](char *&p, size_t i) { format_waypoint(p,wps[i]); });
+	}
+
+	/**
+	 * @brief format Formats a waypoint file
+	 * @param wps Waypoints
+	 * @return File contents
+	 */
+	static const string format(const VecWP &wps) {
+		string buf;
+		format(wps,buf);
+		return move(buf);
+	}
+
+	/**
+	 * @brief write_file Writes a buffer to a file (truncating it)
+	 * @param filename Filename
+	 * @param data File contents
+	 */
+	static void write_file(const string &filename, string_view data) {
+#if defined(_WIN32)
+		ofstream f(filename,ios::binary|ios::trunc);
+		if(!f.is_open() || !f.write(data.data(),data.size()))
+			throw(file_error(filename,false));
+#else
+		int fd = open(filename.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0666);
+		if(fd<0)
+			throw(file_error(filename,false));
+		const char *p = data.data();
+		size_t left = data.size();
+		while(left>0) { //One call, unless interrupted or the disk is full.
+			ssize_t n = write(fd,p,left);
+			if(n<0) {
+				if(errno==EINTR)
+					continue;
+				close(fd);
+				throw(file_error(filename,false));
+			}
+			p += n;
+			left -= static_cast<size_t>(n);
+		}
+		if(close(fd)!=0)
+			throw(file_error(filename,false));
+#endif
+	}
+
+	/**
+	 * @brief save Saves autopath as waypoint text file, like autopath::save
+	 * @param wps Waypoints
+	 * @param filename Filename (.txt)
+	 */
+	static void save(const VecWP &wps, const string &filename) {
+		string buf;
+		format(wps,buf);
+		write_file(filename,buf);
+	}
+};